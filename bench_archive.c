@@ -0,0 +1,464 @@
+#define _GNU_SOURCE  // pour getopt() et posix_fadvise()
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "lib_tar.h"
+
+/**
+ * Benchmark of the lookup and read functions on synthetic archives.
+ *
+ * Four archives are generated with the writer API, always with the same entries and contents for a given seed:
+ *   - tiny:  many small files spread over directories of 1000 entries,
+ *   - huge:  a few large files,
+ *   - deep:  chains of nested directories with a file at each level,
+ *   - links: files reached through symlinks, chains of symlinks and symlinks to directories.
+ *
+ * Each function is timed on each archive with a cold page cache (dropped before every sample) and a warm one. The
+ * latency percentiles and throughputs are printed and written as JSON, so that later versions of the library can be
+ * compared with this one.
+ *
+ * Usage: ./bench_archive [-n tiny_files] [-H huge_mib] [-k huge_files] [-r samples] [-s seed] [-d work_dir]
+ *                        [-o results.json]
+ */
+
+#define DIR_ENTRIES 1000
+#define TINY_MAX 512
+#define DEEP_CHAINS 16
+#define DEEP_DEPTH 64
+#define LINK_TARGETS 1000
+#define LINK_CHAIN 8
+#define CHUNK (64 * 1024)
+#define RANDOM_READ 4096
+#define LIST_MAX 2048
+
+struct config {
+    long tiny_files;
+    long huge_mib;
+    long huge_files;
+    long samples;
+    unsigned int seed;
+    const char *work_dir;
+    const char *output;
+};
+
+/* Chemins d'une archive générée, dans lesquels les mesures tirent leurs échantillons */
+struct paths {
+    char **files;
+    size_t n_files;
+    char **dirs;
+    size_t n_dirs;
+    char *largest;        // plus gros fichier, lu en entier par la lecture séquentielle
+    size_t largest_size;
+};
+
+struct sample_set {
+    double *latencies;    // en secondes
+    size_t n;
+    uint64_t bytes;
+    double elapsed;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Générateur congruentiel : les archives et les tirages sont identiques d'une exécution à l'autre
+static unsigned int rng_next(unsigned int *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static void fill(uint8_t *buf, size_t len, unsigned int *state) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rng_next(state);
+    }
+}
+
+static void paths_push(char ***array, size_t *n, const char *path) {
+    if ((*n & (*n - 1)) == 0) {
+        *array = realloc(*array, (*n ? *n * 2 : 1) * sizeof(char *));
+    }
+    (*array)[(*n)++] = strdup(path);
+}
+
+static void paths_free(struct paths *p) {
+    for (size_t i = 0; i < p->n_files; i++) {
+        free(p->files[i]);
+    }
+    for (size_t i = 0; i < p->n_dirs; i++) {
+        free(p->dirs[i]);
+    }
+    free(p->files);
+    free(p->dirs);
+    free(p->largest);
+    memset(p, 0, sizeof(*p));
+}
+
+static int add_dir(tar_writer_t *w, struct paths *p, const char *path) {
+    paths_push(&p->dirs, &p->n_dirs, path);
+    return tar_add_dir(w, path, 0755);
+}
+
+static int add_buffer(tar_writer_t *w, struct paths *p, const char *path, const uint8_t *data, size_t len) {
+    paths_push(&p->files, &p->n_files, path);
+    if (len >= p->largest_size) {
+        free(p->largest);
+        p->largest = strdup(path);
+        p->largest_size = len;
+    }
+    return tar_add_buffer(w, path, data, len, 0644);
+}
+
+static int generate_tiny(tar_writer_t *w, struct paths *p, const struct config *cfg, unsigned int *state) {
+    uint8_t data[TINY_MAX];
+    char path[64];
+    int ret = add_dir(w, p, "tiny/");
+    for (long i = 0; i < cfg->tiny_files && ret == 0; i++) {
+        if (i % DIR_ENTRIES == 0) {
+            snprintf(path, sizeof(path), "tiny/d%05ld/", i / DIR_ENTRIES);
+            ret = add_dir(w, p, path);
+        }
+        size_t len = rng_next(state) % sizeof(data);
+        fill(data, len, state);
+        snprintf(path, sizeof(path), "tiny/d%05ld/f%07ld", i / DIR_ENTRIES, i);
+        ret |= add_buffer(w, p, path, data, len);
+    }
+    return ret;
+}
+
+static int generate_huge(tar_writer_t *w, struct paths *p, const struct config *cfg, unsigned int *state) {
+    static uint8_t chunk[CHUNK];
+    char src[512], path[64];
+    int ret = add_dir(w, p, "huge/");
+
+    // Les gros fichiers passent par le disque pour être copiés par tar_add_file() comme des fichiers réels
+    snprintf(src, sizeof(src), "%s/huge.src", cfg->work_dir);
+    for (long i = 0; i < cfg->huge_files && ret == 0; i++) {
+        int fd = open(src, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            return -1;
+        }
+        for (long written = 0; written < cfg->huge_mib * 1024 * 1024; written += CHUNK) {
+            fill(chunk, 256, state);  // seul le début de chaque morceau change, pour générer vite
+            if (write(fd, chunk, CHUNK) != CHUNK) {
+                close(fd);
+                return -1;
+            }
+        }
+        close(fd);
+        snprintf(path, sizeof(path), "huge/blob%02ld", i);
+        paths_push(&p->files, &p->n_files, path);
+        free(p->largest);
+        p->largest = strdup(path);
+        p->largest_size = cfg->huge_mib * 1024 * 1024;
+        ret = tar_add_file(w, src, path);
+    }
+    unlink(src);
+    return ret;
+}
+
+static int generate_deep(tar_writer_t *w, struct paths *p, unsigned int *state) {
+    uint8_t data[256];
+    char path[DEEP_DEPTH * 5 + 32];
+    int ret = 0;
+    for (int chain = 0; chain < DEEP_CHAINS && ret == 0; chain++) {
+        size_t len = snprintf(path, sizeof(path), "deep%02d/", chain);
+        ret = add_dir(w, p, path);
+        for (int level = 0; level < DEEP_DEPTH && ret == 0; level++) {
+            len += snprintf(path + len, sizeof(path) - len, "l%02d/", level);
+            ret = add_dir(w, p, path);
+            fill(data, sizeof(data), state);
+            snprintf(path + len, sizeof(path) - len, "file");
+            ret |= add_buffer(w, p, path, data, sizeof(data));
+            path[len] = '\0';
+        }
+    }
+    return ret;
+}
+
+static int generate_links(tar_writer_t *w, struct paths *p, unsigned int *state) {
+    uint8_t data[1024];
+    char path[64], target[64];
+    int ret = add_dir(w, p, "links/");
+    ret |= add_dir(w, p, "links/real/");
+    for (int i = 0; i < LINK_TARGETS && ret == 0; i++) {
+        fill(data, sizeof(data), state);
+        snprintf(path, sizeof(path), "links/real/t%04d", i);
+        ret = add_buffer(w, p, path, data, sizeof(data));
+    }
+    // Chaînes de liens : c<i>_0 -> real/t<i>, c<i>_k -> c<i>_<k-1>
+    for (int i = 0; i < LINK_TARGETS && ret == 0; i++) {
+        for (int k = 0; k < LINK_CHAIN && ret == 0; k++) {
+            snprintf(path, sizeof(path), "links/c%04d_%d", i, k);
+            if (k == 0) {
+                snprintf(target, sizeof(target), "real/t%04d", i);
+            } else {
+                snprintf(target, sizeof(target), "c%04d_%d", i, k - 1);
+            }
+            ret = tar_add_symlink(w, path, target);
+            paths_push(&p->files, &p->n_files, path);
+        }
+    }
+    for (int i = 0; i < 100 && ret == 0; i++) {
+        snprintf(path, sizeof(path), "links/dir%02d", i);
+        ret = tar_add_symlink(w, path, "real");
+        snprintf(path, sizeof(path), "links/dir%02d/", i);
+        paths_push(&p->dirs, &p->n_dirs, path);
+    }
+    return ret;
+}
+
+/* Génère une archive, retourne un descripteur en lecture seule ou -1 */
+static int generate(const char *kind, const struct config *cfg, struct paths *p) {
+    char path[512];
+    unsigned int state = cfg->seed;
+    snprintf(path, sizeof(path), "%s/%s.tar", cfg->work_dir, kind);
+
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = out != -1 ? tar_writer_open(out) : NULL;
+    if (w == NULL) {
+        perror(path);
+        if (out != -1) {
+            close(out);
+        }
+        return -1;
+    }
+    int ret = strcmp(kind, "tiny") == 0 ? generate_tiny(w, p, cfg, &state)
+              : strcmp(kind, "huge") == 0 ? generate_huge(w, p, cfg, &state)
+              : strcmp(kind, "deep") == 0 ? generate_deep(w, p, &state)
+              : generate_links(w, p, &state);
+    ret |= tar_writer_close(w);
+    // Les pages écrites doivent être propres pour pouvoir être évincées avant les mesures à froid
+    fsync(out);
+    close(out);
+    if (ret != 0) {
+        perror(path);
+        return -1;
+    }
+    return open(path, O_RDONLY);
+}
+
+/* Charge toute l'archive dans le cache de pages avant les mesures à chaud */
+static void warm_up(int fd) {
+    static uint8_t buf[CHUNK];
+    off_t offset = 0;
+    ssize_t n;
+    while ((n = pread(fd, buf, sizeof(buf), offset)) > 0) {
+        offset += n;
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const struct sample_set *s, double p) {
+    size_t i = (size_t)(p * (s->n - 1) + 0.5);
+    return s->latencies[i];
+}
+
+enum op {
+    OP_CHECK_ARCHIVE,
+    OP_EXISTS,
+    OP_IS_DIR,
+    OP_LIST,
+    OP_READ_SEQUENTIAL,
+    OP_READ_RANDOM,
+    OP_NEGATIVE_LOOKUP,
+    OP_COUNT,
+};
+
+static const char *op_names[OP_COUNT] = {
+    "check_archive", "exists", "is_dir", "list", "read_file_sequential", "read_file_random", "negative_lookup",
+};
+
+/* Mesure une opération, une latence par échantillon (par morceau pour la lecture séquentielle) */
+static void run_op(int fd, enum op op, int cold, const struct paths *p, const struct config *cfg,
+                   struct sample_set *s) {
+    static uint8_t buf[CHUNK];
+    static char list_storage[LIST_MAX][256];
+    static char *entries[LIST_MAX];
+    unsigned int state = cfg->seed ^ (op * 7919);
+    size_t capacity = cfg->samples;
+
+    if (op == OP_READ_SEQUENTIAL) {
+        capacity = cfg->samples * (p->largest_size / CHUNK + 1);
+    }
+    s->latencies = malloc(capacity * sizeof(double));
+    s->n = 0;
+    s->bytes = 0;
+    s->elapsed = 0;
+    for (size_t i = 0; i < LIST_MAX; i++) {
+        entries[i] = list_storage[i];
+    }
+
+    for (long k = 0; k < cfg->samples; k++) {
+        if (cold) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        char *file = p->n_files > 0 ? p->files[rng_next(&state) % p->n_files] : NULL;
+        char *dir = p->n_dirs > 0 ? p->dirs[rng_next(&state) % p->n_dirs] : NULL;
+        char missing[300];
+        size_t len = sizeof(buf);
+        double start = now();
+
+        switch (op) {
+            case OP_CHECK_ARCHIVE:
+                check_archive(fd);
+                break;
+            case OP_EXISTS:
+                exists(fd, file);
+                break;
+            case OP_IS_DIR:
+                is_dir(fd, dir);
+                break;
+            case OP_LIST: {
+                size_t n = LIST_MAX;
+                list(fd, dir, entries, &n);
+                break;
+            }
+            case OP_READ_SEQUENTIAL: {
+                // Le plus gros fichier, lu par morceaux du début à la fin
+                size_t offset = 0;
+                ssize_t ret;
+                do {
+                    double chunk_start = now();
+                    len = sizeof(buf);
+                    ret = read_file(fd, p->largest, offset, buf, &len);
+                    s->latencies[s->n++] = now() - chunk_start;
+                    offset += len;
+                    s->bytes += len;
+                } while (ret > 0 && s->n < capacity);
+                break;
+            }
+            case OP_READ_RANDOM: {
+                len = RANDOM_READ;
+                read_file(fd, file, rng_next(&state) % 1024, buf, &len);
+                s->bytes += len;
+                break;
+            }
+            case OP_NEGATIVE_LOOKUP:
+                snprintf(missing, sizeof(missing), "%s.missing", file);
+                exists(fd, missing);
+                break;
+            default:
+                break;
+        }
+        double elapsed = now() - start;
+        s->elapsed += elapsed;
+        if (op != OP_READ_SEQUENTIAL) {
+            s->latencies[s->n++] = elapsed;
+        }
+    }
+    qsort(s->latencies, s->n, sizeof(double), compare_double);
+}
+
+static void report(FILE *json, int *first, const char *archive, enum op op, int cold, const struct sample_set *s) {
+    double mean = s->n > 0 ? s->elapsed / s->n : 0;
+    double mib_s = s->elapsed > 0 ? s->bytes / s->elapsed / (1024 * 1024) : 0;
+    printf("%-6s %-21s %-5s p50 %10.1f us  p90 %10.1f us  p99 %10.1f us  max %10.1f us",
+           archive, op_names[op], cold ? "froid" : "chaud", percentile(s, 0.5) * 1e6, percentile(s, 0.9) * 1e6,
+           percentile(s, 0.99) * 1e6, s->latencies[s->n - 1] * 1e6);
+    if (s->bytes > 0) {
+        printf("  %8.1f Mio/s", mib_s);
+    }
+    printf("\n");
+
+    fprintf(json,
+            "%s    {\"archive\": \"%s\", \"op\": \"%s\", \"cache\": \"%s\", \"samples\": %zu, "
+            "\"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+            "\"ops_per_s\": %.3f, \"bytes\": %llu, \"throughput_mib_s\": %.3f}",
+            *first ? "" : ",\n", archive, op_names[op], cold ? "cold" : "warm", s->n, mean * 1e6,
+            percentile(s, 0.5) * 1e6, percentile(s, 0.9) * 1e6, percentile(s, 0.99) * 1e6,
+            s->latencies[s->n - 1] * 1e6, s->elapsed > 0 ? s->n / s->elapsed : 0,
+            (unsigned long long)s->bytes, mib_s);
+    *first = 0;
+}
+
+int main(int argc, char **argv) {
+    struct config cfg = {
+        .tiny_files = 1000000,
+        .huge_mib = 256,
+        .huge_files = 4,
+        .samples = 30,
+        .seed = 42,
+        .work_dir = "/tmp/lib_tar_bench",
+        .output = "bench_results.json",
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:H:k:r:s:d:o:")) != -1) {
+        switch (opt) {
+            case 'n': cfg.tiny_files = atol(optarg); break;
+            case 'H': cfg.huge_mib = atol(optarg); break;
+            case 'k': cfg.huge_files = atol(optarg); break;
+            case 'r': cfg.samples = atol(optarg); break;
+            case 's': cfg.seed = atol(optarg); break;
+            case 'd': cfg.work_dir = optarg; break;
+            case 'o': cfg.output = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n tiny_files] [-H huge_mib] [-k huge_files] [-r samples] [-s seed] "
+                                "[-d work_dir] [-o results.json]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (cfg.samples < 1) {
+        cfg.samples = 1;
+    }
+    mkdir(cfg.work_dir, 0755);
+
+    FILE *json = fopen(cfg.output, "w");
+    if (json == NULL) {
+        perror(cfg.output);
+        return 1;
+    }
+    fprintf(json, "{\n  \"benchmark\": \"lib_tar\",\n  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(json, "  \"config\": {\"tiny_files\": %ld, \"huge_mib\": %ld, \"huge_files\": %ld, \"samples\": %ld, "
+                  "\"seed\": %u},\n  \"results\": [\n", cfg.tiny_files, cfg.huge_mib, cfg.huge_files, cfg.samples,
+            cfg.seed);
+
+    const char *archives[] = {"tiny", "huge", "deep", "links"};
+    int first = 1;
+    int status = 0;
+    for (size_t a = 0; a < sizeof(archives) / sizeof(archives[0]); a++) {
+        struct paths p = {0};
+        double start = now();
+        int fd = generate(archives[a], &cfg, &p);
+        if (fd == -1) {
+            status = 1;
+            paths_free(&p);
+            continue;
+        }
+        printf("Archive '%s' : %zu fichiers, %zu répertoires, générée en %.1f s\n", archives[a], p.n_files, p.n_dirs,
+               now() - start);
+
+        for (int cold = 1; cold >= 0; cold--) {
+            if (!cold) {
+                warm_up(fd);
+            }
+            for (enum op op = 0; op < OP_COUNT; op++) {
+                struct sample_set s;
+                run_op(fd, op, cold, &p, &cfg, &s);
+                report(json, &first, archives[a], op, cold, &s);
+                free(s.latencies);
+            }
+        }
+        close(fd);
+        paths_free(&p);
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.tar", cfg.work_dir, archives[a]);
+        unlink(path);
+    }
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+    rmdir(cfg.work_dir);
+    printf("Résultats écrits dans '%s'\n", cfg.output);
+    return status;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib_tar.h"
+
+/**
+ * Micro-benchmark of the header checksum implementations.
+ *
+ * Usage: ./bench_chksum [iterations]
+ */
+
+#define NB_HEADERS 1024
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Boucle historique de check_archive(), gardée comme point de comparaison
+static unsigned int legacy_chksum(const tar_header_t *header) {
+    unsigned int computed_chksum = 0;
+    const char *raw_header = (const char *)header;
+    for (size_t i = 0; i < sizeof(*header); i++) {
+        if (i >= 148 && i < 156) {
+            computed_chksum += ' ';
+        } else {
+            computed_chksum += (unsigned char)raw_header[i];
+        }
+    }
+    return computed_chksum;
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+    static tar_header_t headers[NB_HEADERS];
+
+    // En-têtes pseudo-aléatoires mais reproductibles
+    unsigned int seed = 42;
+    for (size_t i = 0; i < NB_HEADERS; i++) {
+        uint8_t *raw = (uint8_t *)&headers[i];
+        for (size_t j = 0; j < sizeof(tar_header_t); j++) {
+            seed = seed * 1103515245 + 12345;
+            raw[j] = seed >> 16;
+        }
+    }
+
+    unsigned long reference = 0;
+    double start = now();
+    for (long it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < NB_HEADERS; i++) {
+            reference += legacy_chksum(&headers[i]);
+        }
+    }
+    double legacy_ns = (now() - start) * 1e9 / ((double)iterations * NB_HEADERS);
+    printf("%-8s %7.2f ns/en-tête  %6.2f Go/s  x%.2f\n", "legacy", legacy_ns, sizeof(tar_header_t) / legacy_ns, 1.0);
+
+    tar_chksum_impl_t impls[] = {TAR_CHKSUM_SCALAR, TAR_CHKSUM_SSE2, TAR_CHKSUM_AVX2, TAR_CHKSUM_AVX512};
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (tar_chksum_select(impls[k]) == -1) {
+            printf("%-8s non supporté par ce processeur\n", k == 1 ? "sse2" : k == 2 ? "avx2" : "avx512");
+            continue;
+        }
+
+        unsigned long total = 0;
+        start = now();
+        for (long it = 0; it < iterations; it++) {
+            for (size_t i = 0; i < NB_HEADERS; i++) {
+                total += tar_header_chksum(&headers[i]);
+            }
+        }
+        double ns = (now() - start) * 1e9 / ((double)iterations * NB_HEADERS);
+        printf("%-8s %7.2f ns/en-tête  %6.2f Go/s  x%.2f%s\n", tar_chksum_impl_name(), ns,
+               sizeof(tar_header_t) / ns, legacy_ns / ns, total == reference ? "" : "  RÉSULTAT DIFFÉRENT");
+    }
+
+    tar_chksum_select(TAR_CHKSUM_AUTO);
+    printf("Implémentation choisie automatiquement : %s\n", tar_chksum_impl_name());
+    return 0;
+}
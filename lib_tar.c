@@ -1,478 +1,7722 @@
+#define _GNU_SOURCE  // pour splice()
 #include "lib_tar.h"
 #include "string.h"
 #include "stdio.h"
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#include <endian.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TAR_X86 1
+#endif
 
+#undef BLOCK_SIZE  // défini à 1024 par <linux/fs.h>, inclus par <linux/io_uring.h>
 #define BLOCK_SIZE 512
+#define MAX_LINK_HOPS 32
+#define RESOLVE_PATH_MAX 1024
 
-tar_header_t header;
-int skip_file_data(int tar_fd, unsigned long file_size) {
-    // Calculer le nombre de blocs nécessaires pour stocker les données du fichier
-    unsigned long num_blocks = (file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+/* Taille occupée dans l'archive par des données de file_size octets */
+static inline uint64_t padded_size(uint64_t file_size) {
+    return (file_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+}
+
+/* Reconstruit le chemin complet d'une entrée (prefix + "/" + name), out doit contenir au moins 257 octets */
+static size_t header_path(const tar_header_t *hdr, char *out) {
+    size_t len = 0;
+    size_t prefix_len = strnlen(hdr->prefix, sizeof(hdr->prefix));
 
-    if (lseek(tar_fd, num_blocks * BLOCK_SIZE, SEEK_CUR) == -1) {
-        perror("Error while skipping file data");
-        return -1; 
+    if (prefix_len > 0) {
+        memcpy(out, hdr->prefix, prefix_len);
+        out[prefix_len] = '/';
+        len = prefix_len + 1;
     }
+    size_t name_len = strnlen(hdr->name, sizeof(hdr->name));
+    memcpy(out + len, hdr->name, name_len);
+    len += name_len;
+    out[len] = '\0';
+    return len;
+}
 
-    return 0; 
+/* Longueur du chemin du répertoire parent, "dir/" pour "dir/c/" ou "dir/a", zéro pour une entrée à la racine */
+static size_t parent_len(const char *path, size_t len) {
+    if (len > 0 && path[len - 1] == '/') {
+        len--;
+    }
+    while (len > 0 && path[len - 1] != '/') {
+        len--;
+    }
+    return len;
 }
 
-/**
- * Checks whether the archive is valid.
- *
- * Each non-null header of a valid archive has:
- *  - a magic value of "ustar" and a null,
- *  - a version value of "00" and no null,
- *  - a correct checksum
- *
- * @param tar_fd A file descriptor pointing to the start of a file supposed to contain a tar archive.
- *
- * @return a zero or positive value if the archive is valid, representing the number of non-null headers in the archive,
- *         -1 if the archive contains a header with an invalid magic value,
- *         -2 if the archive contains a header with an invalid version value,
- *         -3 if the archive contains a header with an invalid checksum value
- */
-int check_archive(int tar_fd) {
-    tar_header_t header;
-    int num_headers = 0;  
-    
-    while (read(tar_fd, &header, sizeof(header)) == sizeof(header)) {
-        // Vérifiez si l'en-tête est vide (fin de l'archive)
-        if (header.name[0] == '\0') {
-            break;  
-        }
+/* Taille d'un tampon pouvant recevoir le chemin d'une entrée, terminateur compris */
+#define HEADER_PATH_MAX (sizeof(((tar_header_t *)0)->prefix) + 1 + sizeof(((tar_header_t *)0)->name) + 1)
 
-        // Vérification du champ "magic" 
-        if (strncmp(header.magic, TMAGIC, TMAGLEN) != 0) {
-            return -1;  
-        }
+/* Les archives GNU ont leur propre magic, "ustar  ", à cheval sur les champs magic et version */
+static inline int is_oldgnu(const tar_header_t *hdr) {
+    return memcmp(hdr->magic, OLDGNU_MAGIC, sizeof(hdr->magic) + sizeof(hdr->version)) == 0;
+}
 
-        // Vérification du champ "version"
-        if (strncmp(header.version, TVERSION, TVERSLEN) != 0) {
-            return -2; 
-        }
+/* Un fichier creux GNU se lit comme un fichier ordinaire */
+static inline int is_file_type(char type) {
+    return type == REGTYPE || type == AREGTYPE || type == GNUTYPE_SPARSE;
+}
 
-        // Vérification de la somme de contrôle
-        unsigned int stored_chksum = TAR_INT(header.chksum);  // Somme attendue
-        unsigned int computed_chksum = 0;
+/* Masque des octets non nuls de x : le bit de poids fort de chaque octet non nul est mis, sans propagation de retenue */
+static inline uint64_t nonzero_bytes(uint64_t x) {
+    return (((x & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | x) & 0x8080808080808080ULL;
+}
 
-        
-        char *raw_header = (char *)&header;
-        for (size_t i = 0; i < sizeof(header); i++) {
-            if (i >= 148 && i < 156) {
-                computed_chksum += ' ';  // Champ 'chksum' rempli d'espaces
-            } else {
-                computed_chksum += (unsigned char)raw_header[i];
-            }
-        }
+/* Rang du premier octet marqué d'un masque de nonzero_bytes(), 8 s'il n'y en a pas */
+static inline unsigned int first_marked(uint64_t mask) {
+    return mask ? __builtin_ctzll(mask) / 8 : 8;
+}
 
-        if (stored_chksum != computed_chksum) {
-            return -3;  
-        }
+/*
+ * Valeur des digits premiers chiffres octaux d'un mot de 8 octets, le premier chiffre dans l'octet de poids faible. Les
+ * chiffres sont alignés sur les octets de poids fort puis combinés deux à deux, quatre à quatre et huit à huit par
+ * multiplications et décalages, sans boucle ni branchement.
+ */
+static inline uint64_t octal_swar(uint64_t chunk, unsigned int digits) {
+    unsigned int shift = 8 * (8 - digits);
+    uint64_t v = chunk - 0x3030303030303030ULL;
+    v = shift < 64 ? v << shift : 0;
+    v = (v * 8 + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+    v = (v * 64 + (v >> 16)) & 0x0000ffff0000ffffULL;
+    return (v * 4096 + (v >> 32)) & 0xffffffffULL;
+}
 
-        
-        unsigned long file_size = strtol(header.size, NULL, 8);
+/*
+ * Nombre d'un champ numérique de 8 ou 12 octets, en octal précédé d'éventuels espaces et terminé par un caractère qui
+ * n'est pas un chiffre octal, ou, pour les grandes valeurs des archives GNU, en base 256.
+ */
+static inline uint64_t field_number(const char *field, size_t len) {
+    uint8_t buf[24] = {0};
+    uint64_t lo, hi;
 
-        // Sauter les blocs de données
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            return -4;  
-        }
-        
-        num_headers++;
+    memcpy(buf, field, len);
+    if (buf[0] & 0x80) {
+        // Base 256 : les 8 derniers octets en gros-boutiste, sans les bits de marque et de signe du premier octet
+        memcpy(&lo, buf + len - 8, 8);
+        lo = be64toh(lo);
+        return len == 8 ? lo & 0x3fffffffffffffffULL : lo;
     }
-
-    return num_headers; 
+    memcpy(&lo, buf, 8);
+    unsigned int lead = first_marked(nonzero_bytes(le64toh(lo) ^ 0x2020202020202020ULL));
+    memcpy(&lo, buf + lead, 8);
+    memcpy(&hi, buf + lead + 8, 8);
+    lo = le64toh(lo);
+    hi = le64toh(hi);
+    // Un octet est un chiffre octal si ses 5 bits de poids fort sont ceux de '0'
+    unsigned int n_lo = first_marked(nonzero_bytes((lo & 0xf8f8f8f8f8f8f8f8ULL) ^ 0x3030303030303030ULL));
+    unsigned int n_hi = first_marked(nonzero_bytes((hi & 0xf8f8f8f8f8f8f8f8ULL) ^ 0x3030303030303030ULL));
+    n_hi = n_lo == 8 ? n_hi : 0;
+    return octal_swar(lo, n_lo) << (3 * n_hi) | octal_swar(hi, n_hi);
 }
 
-/**
- * Checks whether an entry exists in the archive.
- *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive.
+/*
+ * Compteurs d'entrées-sorties.
  *
- * @return zero if no entry at the given path exists in the archive,
- *         any other value otherwise.
+ * Chaque thread compte dans sa propre structure, sans synchronisation, les appels système faits sur les archives, les
+ * en-têtes décodés et les sommes de contrôle calculées. Les fonctions publiques instrumentées relèvent ces compteurs à
+ * leur entrée et à leur sortie : la différence est l'activité de l'appel, ajoutée aux compteurs de l'index concerné
+ * et transmise au crochet de trace s'il y en a un.
  */
-int exists(int tar_fd, char *path) {
-    // Remettre le descripteur de fichier au début de l'archive
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        return -1;
-    }
+static __thread tar_stats_t thread_stats;
 
-    tar_header_t header; 
+/*
+ * Crochet de trace et son contexte, publiés ensemble : trace_seq est impair pendant que tar_stats_set_trace() les
+ * modifie, et un lecteur qui voit trace_seq changer pendant sa lecture recommence, pour ne jamais associer un crochet
+ * au contexte d'un autre.
+ */
+static tar_trace_hook_t trace_hook;
+static void *trace_ctx;
+static unsigned trace_seq;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
 
-    
-    while (read(tar_fd, &header, sizeof(header)) == sizeof(header)) {
-        // Vérifier si l'en-tête est vide (fin de l'archive)
-        if (header.name[0] == '\0') {
-            break; 
-        }
+static const char *const fn_names[TAR_FN_COUNT] = {
+    "check_archive", "exists", "is_dir", "is_file", "is_symlink", "list", "read_file", "tar_index_read_file",
+};
 
-        
-        if (strncmp(header.name, path, sizeof(header.name)) == 0) {
-            return 1; 
-        }
-        printf("%s\n", header.name);
+static inline ssize_t io_pread(int fd, void *buf, size_t len, off_t offset) {
+    ssize_t n = pread(fd, buf, len, offset);
+    thread_stats.io.read_calls++;
+    thread_stats.io.bytes_read += n > 0 ? n : 0;
+    return n;
+}
 
-        
-        unsigned long file_size = strtol(header.size, NULL, 8); 
-        
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            return -4;  
-        }
-        
-    }
+static inline ssize_t io_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+    ssize_t n = preadv(fd, iov, iovcnt, offset);
+    thread_stats.io.read_calls++;
+    thread_stats.io.bytes_read += n > 0 ? n : 0;
+    return n;
+}
 
-    // Aucune correspondance trouvée
-    return 0;
+static inline ssize_t io_read(int fd, void *buf, size_t len) {
+    ssize_t n = read(fd, buf, len);
+    thread_stats.io.read_calls++;
+    thread_stats.io.bytes_read += n > 0 ? n : 0;
+    return n;
 }
 
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
-/**
- * Checks whether an entry exists in the archive and is a directory.
- *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive.
- *
- * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
- *         any other value otherwise.
- */
-int is_dir(int tar_fd, char *path) {
-    
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        return -1;
-    }
+/* Relevé des compteurs du thread au début d'un appel public */
+struct probe {
+    tar_fn_t fn;
+    uint64_t start;
+    tar_io_stats_t io;
+};
 
-    while (read(tar_fd, &header, sizeof(header)) == sizeof(header)) {
-        
-        if (header.name[0] == '\0') {
-            break;
-        }
+static inline void probe_begin(struct probe *probe, tar_fn_t fn) {
+    probe->fn = fn;
+    probe->io = thread_stats.io;
+    probe->start = now_ns();
+}
 
-        
-        if (strncmp(header.name, path, sizeof(header.name)) == 0) {
-            
-            if (header.typeflag == DIRTYPE) {
-                return 1; 
-            } else {
-                return 0; 
-            }
-        }
+/* Clôt un appel public : compte sa durée, l'ajoute aux compteurs d'un handle s'il y en a un et le trace */
+static void probe_end(const struct probe *probe, const char *path, tar_stats_t *handle) {
+    uint64_t wall_ns = now_ns() - probe->start;
+    tar_io_stats_t delta = {
+        .read_calls = thread_stats.io.read_calls - probe->io.read_calls,
+        .bytes_read = thread_stats.io.bytes_read - probe->io.bytes_read,
+        .headers_decoded = thread_stats.io.headers_decoded - probe->io.headers_decoded,
+        .checksums = thread_stats.io.checksums - probe->io.checksums,
+    };
+    thread_stats.calls[probe->fn]++;
+    thread_stats.wall_ns[probe->fn] += wall_ns;
 
-       
-        unsigned long file_size = strtol(header.size, NULL, 8);
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            return -1;
-        }
+    if (handle != NULL) {
+        // Un handle peut être partagé entre threads
+        __atomic_fetch_add(&handle->io.read_calls, delta.read_calls, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&handle->io.bytes_read, delta.bytes_read, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&handle->io.headers_decoded, delta.headers_decoded, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&handle->io.checksums, delta.checksums, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&handle->calls[probe->fn], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&handle->wall_ns[probe->fn], wall_ns, __ATOMIC_RELAXED);
     }
 
-    return 0; 
+    tar_trace_hook_t hook;
+    void *ctx;
+    unsigned seq;
+    do {
+        do {
+            seq = __atomic_load_n(&trace_seq, __ATOMIC_ACQUIRE);
+        } while (seq & 1);
+        hook = __atomic_load_n(&trace_hook, __ATOMIC_RELAXED);
+        ctx = __atomic_load_n(&trace_ctx, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&trace_seq, __ATOMIC_RELAXED) != seq);
+    if (hook != NULL) {
+        hook(probe->fn, path, &delta, wall_ns, ctx);
+    }
 }
 
 /**
- * Checks whether an entry exists in the archive and is a file.
+ * Copies the counters of the calling thread: the system calls it made on archives and the work it did since it
+ * started or since its last tar_stats_reset(), and the number and duration of its calls to the instrumented
+ * functions. Work done by the threads the library starts itself (parallel validation, extraction, asynchronous reads)
+ * is counted in those threads and not reported.
  *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive.
+ * @param out An out argument, set to the counters of the calling thread.
+ */
+void tar_stats_snapshot(tar_stats_t *out) {
+    *out = thread_stats;
+}
+
+/**
+ * Sets the counters of the calling thread to zero.
+ */
+void tar_stats_reset(void) {
+    memset(&thread_stats, 0, sizeof(thread_stats));
+}
+
+/**
+ * Gives the name of an instrumented function, e.g. "exists" for TAR_FN_EXISTS.
  *
- * @return zero if no entry at the given path exists in the archive or the entry is not a file,
- *         any other value otherwise.
+ * @param fn A function of tar_fn_t.
+ *
+ * @return the name of the function, or NULL if fn is out of range.
  */
-int is_file(int tar_fd, char *path) {
-    
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        return -1;
-    }
+const char *tar_stats_fn_name(tar_fn_t fn) {
+    return fn >= 0 && fn < TAR_FN_COUNT ? fn_names[fn] : NULL;
+}
 
-    while (read(tar_fd, &header, sizeof(header)) == sizeof(header)) {
-        
-        if (header.name[0] == '\0') {
-            break;
-        }
+/**
+ * Installs a hook called at the end of every call to an instrumented function, in the calling thread, with the
+ * activity of that call. It is meant to export the counters to a metrics pipeline and must be fast: it runs on the
+ * lookup path. The hook and its context are replaced together: a call that ends in another thread meanwhile is
+ * traced either by the old pair or by the new one.
+ *
+ * @param hook The function to call, or NULL to remove the hook.
+ * @param ctx An opaque pointer given back to the hook.
+ */
+void tar_stats_set_trace(tar_trace_hook_t hook, void *ctx) {
+    pthread_mutex_lock(&trace_lock);
+    __atomic_store_n(&trace_seq, trace_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&trace_hook, hook, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace_ctx, ctx, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace_seq, trace_seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&trace_lock);
+}
 
-        
-        if (strncmp(header.name, path, sizeof(header.name)) == 0) {
-            
-            if (header.typeflag == REGTYPE || header.typeflag == AREGTYPE) {
-                return 1; 
-            } else {
-                return 0;
-            }
-        }
+/*
+ * Somme de contrôle des en-têtes.
+ *
+ * La somme est celle des 512 octets de l'en-tête, le champ chksum étant compté comme 8 espaces. Plutôt que de tester
+ * l'indice de chaque octet, on somme tout l'en-tête puis on remplace la contribution du champ chksum par 8 * ' '.
+ */
+#define CHKSUM_OFFSET 148
+#define CHKSUM_LEN 8
 
-        
-        unsigned long file_size = strtol(header.size, NULL, 8);
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            return -1;
-        }
+static unsigned int chksum_fixup(const uint8_t *raw, unsigned int sum) {
+    for (int i = 0; i < CHKSUM_LEN; i++) {
+        sum -= raw[CHKSUM_OFFSET + i];
     }
+    return sum + CHKSUM_LEN * ' ';
+}
 
-    return 0; 
+static unsigned int chksum_scalar(const uint8_t *raw) {
+    unsigned int sum = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        sum += raw[i];
+    }
+    return chksum_fixup(raw, sum);
 }
 
-/**
- * Checks whether an entry exists in the archive and is a symlink.
- *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive.
- * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
- *         any other value otherwise.
- */
-int is_symlink(int tar_fd, char *path) {
-    
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        return -1;
+#ifdef TAR_X86
+// _mm_sad_epu8 contre zéro additionne 8 octets consécutifs dans chaque moitié 64 bits du registre
+__attribute__((target("sse2")))
+static unsigned int chksum_sse2(const uint8_t *raw) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (size_t i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(raw + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
     }
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+    return chksum_fixup(raw, (unsigned int)_mm_cvtsi128_si32(acc));
+}
 
-    while (read(tar_fd, &header, sizeof(header)) == sizeof(header)) {
-        
-        if (header.name[0] == '\0') {
-            break;
-        }
+__attribute__((target("avx2")))
+static unsigned int chksum_avx2(const uint8_t *raw) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t i = 0; i < BLOCK_SIZE; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(raw + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, zero));
+    }
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    return chksum_fixup(raw, (unsigned int)_mm_cvtsi128_si32(sum));
+}
 
-        
-        if (strncmp(header.name, path, sizeof(header.name)) == 0) {
-           
-            if (header.typeflag == SYMTYPE || header.typeflag == LNKTYPE) {
-                return 1; 
-            } else {
-                return 0; 
-            }
-        }
+__attribute__((target("avx512f,avx512bw")))
+static unsigned int chksum_avx512(const uint8_t *raw) {
+    __m512i zero = _mm512_setzero_si512();
+    __m512i acc = _mm512_setzero_si512();
+    for (size_t i = 0; i < BLOCK_SIZE; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void *)(raw + i));
+        acc = _mm512_add_epi64(acc, _mm512_sad_epu8(v, zero));
+    }
+    return chksum_fixup(raw, (unsigned int)_mm512_reduce_add_epi64(acc));
+}
+#endif
 
-        
-        unsigned long file_size = strtol(header.size, NULL, 8);
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            return -1;
-        }
+// Lus sans verrou par tous les threads, changés à tout moment par tar_chksum_select()
+static unsigned int (*chksum_kernel)(const uint8_t *raw) = NULL;
+static tar_chksum_impl_t chksum_kernel_impl = TAR_CHKSUM_SCALAR;
+static pthread_once_t chksum_once = PTHREAD_ONCE_INIT;
+
+static int chksum_supported(tar_chksum_impl_t impl) {
+    switch (impl) {
+        case TAR_CHKSUM_SCALAR:
+            return 1;
+#ifdef TAR_X86
+        case TAR_CHKSUM_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case TAR_CHKSUM_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case TAR_CHKSUM_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+        default:
+            return 0;
     }
+}
 
-    return 0;
+static void chksum_set(tar_chksum_impl_t impl) {
+    unsigned int (*kernel)(const uint8_t *raw);
+    switch (impl) {
+#ifdef TAR_X86
+        case TAR_CHKSUM_SSE2:
+            kernel = chksum_sse2;
+            break;
+        case TAR_CHKSUM_AVX2:
+            kernel = chksum_avx2;
+            break;
+        case TAR_CHKSUM_AVX512:
+            kernel = chksum_avx512;
+            break;
+#endif
+        default:
+            impl = TAR_CHKSUM_SCALAR;
+            kernel = chksum_scalar;
+            break;
+    }
+    __atomic_store_n(&chksum_kernel_impl, impl, __ATOMIC_RELAXED);
+    __atomic_store_n(&chksum_kernel, kernel, __ATOMIC_RELAXED);
 }
 
+// Choisit la meilleure implémentation disponible sur le processeur courant
+static void chksum_init(void) {
+    tar_chksum_impl_t impl = TAR_CHKSUM_AVX512;
+    while (impl > TAR_CHKSUM_SCALAR && !chksum_supported(impl)) {
+        impl--;
+    }
+    chksum_set(impl);
+}
 
 /**
- * Lists the entries at a given path in the archive.
- * list() does not recurse into the directories listed at the given path.
- *
- * Example:
- *  dir/          list(..., "dir/", ...) lists "dir/a", "dir/b", "dir/c/" and "dir/e/"
- *   ├── a
- *   ├── b
- *   ├── c/
- *   │   └── d
- *   └── e/
+ * Selects the implementation used by tar_header_chksum(). It may be called while other threads compute checksums:
+ * they switch to the new implementation from their next header on.
  *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive. If the entry is a symlink, it must be resolved to its linked-to entry.
- * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
- * @param no_entries An in-out argument.
- *                   The caller set it to the number of entries in `entries`.
- *                   The callee set it to the number of entries listed.
+ * @param impl The implementation to use, TAR_CHKSUM_AUTO picks the fastest one supported by the CPU.
  *
- * @return zero if no directory at the given path exists in the archive,
- *         any other value otherwise.
+ * @return zero on success,
+ *         -1 if the implementation is not supported by the CPU, in which case the current one is kept.
  */
-
-int list(int tar_fd, char *path, char **entries, size_t *no_entries) {
-
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        
+int tar_chksum_select(tar_chksum_impl_t impl) {
+    pthread_once(&chksum_once, chksum_init);
+    if (impl == TAR_CHKSUM_AUTO) {
+        chksum_init();
         return 0;
     }
-        
-    if (is_dir(tar_fd, path) != 1 ){
-        
-        return 0;
+    if (!chksum_supported(impl)) {
+        return -1;
     }
+    chksum_set(impl);
+    return 0;
+}
 
+/**
+ * Gives the name of the implementation currently used by tar_header_chksum().
+ *
+ * @return "scalar", "sse2", "avx2" or "avx512".
+ */
+const char *tar_chksum_impl_name(void) {
+    static const char *names[] = {"auto", "scalar", "sse2", "avx2", "avx512"};
+    pthread_once(&chksum_once, chksum_init);
+    return names[__atomic_load_n(&chksum_kernel_impl, __ATOMIC_RELAXED)];
+}
 
+/**
+ * Computes the checksum of a header, the chksum field being counted as if it was filled with spaces.
+ *
+ * @param hdr The header to compute the checksum of.
+ *
+ * @return the checksum of the header.
+ */
+unsigned int tar_header_chksum(const tar_header_t *hdr) {
+    pthread_once(&chksum_once, chksum_init);
+    thread_stats.io.checksums++;
+    return __atomic_load_n(&chksum_kernel, __ATOMIC_RELAXED)((const uint8_t *)hdr);
+}
 
-    tar_header_t header2;
-
-    int countEntry = 0;
-    char *pathcpy = malloc(100 * sizeof(char));
-    
+/*
+ * Itérateur sur les en-têtes.
+ *
+ * L'archive est lue par morceaux alignés de chunk_size octets : tant que l'en-tête suivant (et donc les données des
+ * petits fichiers) se trouve dans le morceau courant, aucun appel système n'est nécessaire. Après le saut d'un gros
+ * fichier, seule une page est lue, pour ne pas lire inutilement le début des données qui suivent.
+ */
+#define ITER_ALIGN 4096
 
+struct tar_iter {
+    int tar_fd;
+    uint8_t *buf;
+    size_t chunk_size;
+    off_t buf_off;        // offset dans l'archive du premier octet de buf
+    size_t buf_len;
+    off_t next;           // offset du prochain en-tête
+    int long_jump;        // le dernier en-tête était suivi de données plus grandes qu'un morceau
+    int done;
+    int error;
+    char path[sizeof(((tar_header_t *)0)->prefix) + 1 + sizeof(((tar_header_t *)0)->name) + 1];
+    tar_header_t saved_header;   // copie d'une entrée retenue par scan_lookup() pendant la suite du parcours
+    char saved_path[sizeof(((tar_header_t *)0)->prefix) + 1 + sizeof(((tar_header_t *)0)->name) + 1];
+    uint8_t *member;      // en-têtes d'une entrée qui en a plusieurs (en-tête pax, blocs d'extension GNU)
+    size_t member_cap;
+};
 
-    while (read(tar_fd, &header2, BLOCK_SIZE) == BLOCK_SIZE){
+static int iter_init(tar_iter_t *it, int tar_fd, size_t chunk_size) {
+    if (chunk_size == 0) {
+        chunk_size = TAR_ITER_DEFAULT_CHUNK;
+    }
+    chunk_size = (chunk_size + ITER_ALIGN - 1) / ITER_ALIGN * ITER_ALIGN;
 
-        if (header2.name[0] == '\0'){
-            break;
-        }
+    memset(it, 0, sizeof(*it));
+    it->tar_fd = tar_fd;
+    it->chunk_size = chunk_size;
+    if (posix_memalign((void **)&it->buf, ITER_ALIGN, chunk_size) != 0) {
+        return -1;
+    }
+    return 0;
+}
 
-        if (strncmp(header2.name, path,strlen(path))==0){
-            const char *remainPath = header2.name + strlen(path);
-            if(strchr(remainPath, '/')==NULL || remainPath[strlen(remainPath)-1]=='/'){
-                
-                if (header2.typeflag == LNKTYPE || header2.typeflag == SYMTYPE){
-                    
-                    strcpy(pathcpy,header2.linkname);
+static void iter_destroy(tar_iter_t *it) {
+    free(it->buf);
+    free(it->member);
+}
 
+/* Repart du début de l'archive, en gardant le morceau déjà lu */
+static void iter_rewind(tar_iter_t *it) {
+    it->next = 0;
+    it->long_jump = 0;
+    it->done = 0;
+    it->error = 0;
+}
 
-                    if (exists(tar_fd, pathcpy) !=1){
-                        free(pathcpy);
-                        return 0;
-                    }
-                    
+/* Garantit que [offset, offset + len) est dans le tampon, retourne un pointeur sur offset ou NULL */
+static const uint8_t *iter_fetch(tar_iter_t *it, off_t offset, size_t len) {
+    if (offset >= it->buf_off && offset + (off_t)len <= it->buf_off + (off_t)it->buf_len) {
+        return it->buf + (offset - it->buf_off);
+    }
 
+    off_t start = offset / ITER_ALIGN * ITER_ALIGN;
+    size_t want = it->long_jump ? ITER_ALIGN : it->chunk_size;
+    if ((size_t)(offset - start) + len > want) {
+        want = it->chunk_size;
+    }
+    ssize_t n = io_pread(it->tar_fd, it->buf, want, start);
+    if (n < 0) {
+        it->buf_len = 0;
+        it->error = 1;
+        return NULL;
+    }
+    it->buf_off = start;
+    it->buf_len = n;
+    if (offset + (off_t)len > start + n) {
+        return NULL;
+    }
+    return it->buf + (offset - start);
+}
 
+/* Copie len octets de l'archive à partir de offset, depuis le tampon s'ils y sont déjà, sinon avec pread() */
+static ssize_t iter_pread(tar_iter_t *it, void *dest, size_t len, off_t offset) {
+    if (offset >= it->buf_off && offset + (off_t)len <= it->buf_off + (off_t)it->buf_len) {
+        memcpy(dest, it->buf + (offset - it->buf_off), len);
+        return len;
+    }
+    return io_pread(it->tar_fd, dest, len, offset);
+}
 
-                    return list(tar_fd, pathcpy,entries, no_entries);
-                }
-            
+/*
+ * En-têtes étendus et fichiers creux.
+ *
+ * Un en-tête pax (typeflag 'x') porte des enregistrements "<longueur> <clé>=<valeur>\n" qui s'appliquent à l'entrée
+ * suivante : on en retient le chemin, la taille et les informations de fichier creux au format pax 1.0. Un fichier
+ * creux GNU (typeflag 'S') décrit ses segments de données dans son en-tête, puis dans des blocs d'extension qui le
+ * suivent directement et ne sont pas comptés dans sa taille.
+ */
+#define PAX_MAX (1024 * 1024)            // au-delà, l'en-tête pax est traité comme une entrée ordinaire
+#define GNU_SPARSE_OFFSET 386            // 4 descripteurs (offset, taille) de 12 + 12 octets
+#define GNU_ISEXTENDED_OFFSET 482
+#define GNU_REALSIZE_OFFSET 483
+#define GNU_EXT_SPARSE 21                // descripteurs par bloc d'extension
+#define GNU_EXT_ISEXTENDED_OFFSET 504
 
-                
-                if(countEntry < *no_entries){
-                    strncpy(entries[countEntry],header2.name,100);
-                    countEntry++;
-                }
-                
-            }                
+struct pax_info {
+    const char *path;
+    size_t path_len;
+    const char *sparse_name;
+    size_t sparse_name_len;
+    uint64_t size;
+    uint64_t real_size;
+    int has_size;
+    int has_real_size;
+    int sparse_major;
+};
 
+static int parse_decimal(const char *str, size_t len, uint64_t *value) {
+    *value = 0;
+    if (len == 0 || len > 20) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] < '0' || str[i] > '9') {
+            return -1;
         }
-        unsigned long file_size = strtol(header2.size, NULL, 8);
-        
-        skip_file_data(tar_fd,file_size);
+        *value = *value * 10 + (str[i] - '0');
     }
-        
-        
-        
+    return 0;
+}
 
-    free(pathcpy);
+static inline int pax_key_is(const char *key, size_t key_len, const char *name) {
+    return key_len == strlen(name) && memcmp(key, name, key_len) == 0;
+}
 
-    *no_entries = countEntry;
-    return (countEntry > 0) ? 1 : 0;
+static void pax_parse(const char *data, size_t len, struct pax_info *info) {
+    size_t pos = 0;
 
-    
-    
-   
-}
+    memset(info, 0, sizeof(*info));
+    info->sparse_major = -1;
+    while (pos < len) {
+        // La longueur en tête d'enregistrement compte tout l'enregistrement, elle-même et le '\n' compris
+        size_t rec_len = 0;
+        size_t i = pos;
+        while (i < len && data[i] >= '0' && data[i] <= '9' && rec_len < len) {
+            rec_len = rec_len * 10 + (data[i++] - '0');
+        }
+        if (i >= len || data[i] != ' ' || rec_len <= i - pos + 1 || rec_len > len - pos
+            || data[pos + rec_len - 1] != '\n') {
+            break;
+        }
+        const char *key = data + i + 1;
+        const char *end = data + pos + rec_len - 1;
+        const char *eq = memchr(key, '=', end - key);
+        if (eq != NULL) {
+            size_t key_len = eq - key;
+            const char *value = eq + 1;
+            size_t value_len = end - value;
+            uint64_t number;
 
+            if (pax_key_is(key, key_len, "path")) {
+                info->path = value;
+                info->path_len = value_len;
+            } else if (pax_key_is(key, key_len, "GNU.sparse.name")) {
+                info->sparse_name = value;
+                info->sparse_name_len = value_len;
+            } else if (pax_key_is(key, key_len, "size") && parse_decimal(value, value_len, &number) == 0) {
+                info->size = number;
+                info->has_size = 1;
+            } else if (pax_key_is(key, key_len, "GNU.sparse.realsize")
+                       && parse_decimal(value, value_len, &number) == 0) {
+                info->real_size = number;
+                info->has_real_size = 1;
+            } else if (pax_key_is(key, key_len, "GNU.sparse.major")
+                       && parse_decimal(value, value_len, &number) == 0) {
+                info->sparse_major = number;
+            }
+        }
+        pos += rec_len;
+    }
+}
 
-/**
- * Reads a file at a given path in the archive.
- *
- * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
- * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it must be resolved to its linked-to entry.
- * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
- * @param dest A destination buffer to read the given file into.
- * @param len An in-out argument.
- *            The caller set it to the size of dest.
- *            The callee set it to the number of bytes written to dest.
- *
- * @return -1 if no entry at the given path exists in the archive or the entry is not a file,
- *         -2 if the offset is outside the file total length,
- *         zero if the file was read in its entirety into the destination buffer,
- *         a positive value if the file was partially read, representing the remaining bytes left to be read to reach
- *         the end of the file.
+/*
+ * En-tête pax qui précède l'entrée, pax_blocks blocs avant son en-tête en mémoire comme dans l'archive.
  *
+ * @return l'en-tête pax, NULL si l'entrée n'en a pas
  */
-ssize_t read_file(int tar_fd, char *path, size_t offset, uint8_t *dest, size_t *len) {
-
-
-
-    tar_header_t header2;
+static inline const tar_header_t *entry_pax_header(const tar_entry_t *entry) {
+    if (entry->pax_blocks == 0) {
+        return NULL;
+    }
+    return (const tar_header_t *)((const uint8_t *)entry->header - (size_t)entry->pax_blocks * BLOCK_SIZE);
+}
 
-    char *pathcpy = malloc(100*sizeof(char));
-    strcpy(pathcpy,path);
+/*
+ * Décode l'entrée dont le premier en-tête (éventuellement un en-tête pax) se trouve au début de buf, à l'offset offset
+ * de l'archive. path doit contenir au moins HEADER_PATH_MAX octets.
+ *
+ * @return 1 si l'entrée est décodée, *next recevant l'offset de l'en-tête suivant,
+ *         0 si buf ne contient pas tous les en-têtes de l'entrée, dont *need donne alors la taille minimale
+ */
+static int entry_decode(const uint8_t *buf, size_t have, uint64_t offset, char *path, tar_entry_t *entry,
+                        size_t *need, uint64_t *next) {
+    const tar_header_t *hdr = (const tar_header_t *)buf;
+    struct pax_info pax;
+    size_t pos = 0;
 
-    // Réinitialiser la position de lecture au début de l'archive
-    if (lseek(tar_fd, 0, SEEK_SET) == -1) {
-        perror("Erreur lors du repositionnement au début de l'archive");
-        free(pathcpy);
-        return -1;
+    *need = BLOCK_SIZE;
+    if (have < BLOCK_SIZE) {
+        return 0;
+    }
+    memset(&pax, 0, sizeof(pax));
+    pax.sparse_major = -1;
+    entry->pax_blocks = 0;
+    uint64_t pax_size = field_number(hdr->size, sizeof(hdr->size));
+    if (hdr->typeflag == XHDTYPE && hdr->name[0] != '\0' && pax_size <= PAX_MAX) {
+        pos = BLOCK_SIZE + padded_size(pax_size);
+        *need = pos + BLOCK_SIZE;
+        if (have < *need) {
+            return 0;
+        }
+        pax_parse((const char *)buf + BLOCK_SIZE, pax_size, &pax);
+        entry->pax_blocks = pos / BLOCK_SIZE;
+        hdr = (const tar_header_t *)(buf + pos);
     }
 
-
-    // Parcourir les entrées de l'archive
-    while (read(tar_fd, &header2, BLOCK_SIZE) == BLOCK_SIZE) {
-        if (header2.name[0] == '\0') {
-            break;  // Fin de l'archive
+    size_t end = pos + BLOCK_SIZE;
+    uint64_t stored = pax.has_size ? pax.size : field_number(hdr->size, sizeof(hdr->size));
+    entry->size = stored;
+    entry->sparse = TAR_SPARSE_NONE;
+    // Seuls les en-têtes au magic GNU portent une carte de fichier creux GNU
+    if (hdr->typeflag == GNUTYPE_SPARSE && hdr->name[0] != '\0' && is_oldgnu(hdr)) {
+        int extended = buf[pos + GNU_ISEXTENDED_OFFSET];
+        while (extended) {
+            *need = end + BLOCK_SIZE;
+            if (have < *need) {
+                return 0;
+            }
+            extended = buf[end + GNU_EXT_ISEXTENDED_OFFSET];
+            end += BLOCK_SIZE;
         }
+        entry->sparse = TAR_SPARSE_GNU;
+        entry->size = field_number((const char *)buf + pos + GNU_REALSIZE_OFFSET, 12);
+    } else if (pax.sparse_major == 1 && pax.has_real_size) {
+        entry->sparse = TAR_SPARSE_PAX;
+        entry->size = pax.real_size;
+    }
 
-        if (strncmp(header2.name, pathcpy, sizeof(header2.name)) == 0) {
-            // Gestion des symlinks
-            if (header2.typeflag == '2' || header2.typeflag == '1' ) {
+    // Un chemin pax trop long pour les tampons de chemins est ignoré
+    const char *pax_path = pax.sparse_name != NULL ? pax.sparse_name : pax.path;
+    size_t pax_path_len = pax.sparse_name != NULL ? pax.sparse_name_len : pax.path_len;
+    if (pax_path != NULL && pax_path_len > 0 && pax_path_len < HEADER_PATH_MAX && !memchr(pax_path, '\0', pax_path_len)) {
+        memcpy(path, pax_path, pax_path_len);
+        path[pax_path_len] = '\0';
+        entry->path_len = pax_path_len;
+    } else {
+        entry->path_len = header_path(hdr, path);
+    }
+    // En-tête pax, en-tête de l'entrée et blocs d'extension GNU
+    thread_stats.io.headers_decoded += (entry->pax_blocks != 0) + (end - pos) / BLOCK_SIZE;
+    entry->header = hdr;
+    entry->path = path;
+    entry->type = hdr->typeflag;
+    entry->mode = field_number(hdr->mode, sizeof(hdr->mode)) & 07777;
+    entry->mtime = field_number(hdr->mtime, sizeof(hdr->mtime));
+    entry->data_offset = offset + pos + BLOCK_SIZE;
+    *next = offset + end + padded_size(stored);
+    return 1;
+}
 
-                strcpy(pathcpy,header2.linkname);
+/* Lit d'un coup les en-têtes d'une entrée qui en a plusieurs, puis la décode */
+static int iter_next_member(tar_iter_t *it, tar_entry_t *entry) {
+    size_t need = BLOCK_SIZE;
+    uint64_t next;
 
-                return read_file(tar_fd, pathcpy, offset, dest, len);
+    for (;;) {
+        if (need > it->member_cap) {
+            uint8_t *member = realloc(it->member, need);
+            if (member == NULL) {
+                it->error = 1;
+                return -1;
             }
-
-            else{
-
-                if (is_file(tar_fd, pathcpy) != 1 || exists(tar_fd, pathcpy) != 1) {
-                    free(pathcpy);
-                    return -1; 
+            it->member = member;
+            it->member_cap = need;
+        }
+        ssize_t n = iter_pread(it, it->member, need, it->next);
+        if (n != (ssize_t)need) {
+            // Archive tronquée au milieu des en-têtes de l'entrée
+            it->error |= n == -1;
+            return -1;
+        }
+        if (entry_decode(it->member, need, it->next, it->path, entry, &need, &next) == 1) {
+            break;
+        }
+    }
+    if (entry->header->name[0] == '\0') {
+        return -1;
+    }
+    it->long_jump = next - entry->data_offset > it->chunk_size;
+    it->next = next;
+    return 1;
+}
+
+/*
+ * Carte d'un fichier creux : ses segments de données, triés, avec leur position dans l'archive. Elle est lue au
+ * moment de lire le fichier, avec le lecteur qui convient à l'accès à l'archive (descripteur, mapping, flux
+ * compressé). Les trous ne demandent aucune lecture.
+ */
+typedef ssize_t (*read_at_t)(void *src, void *dest, size_t len, uint64_t offset);
+
+struct sparse_seg {
+    uint64_t offset;      // position du segment dans le fichier
+    uint64_t size;
+    uint64_t data_off;    // position de ses données dans l'archive
+};
+
+struct sparse_map {
+    struct sparse_seg *segs;
+    size_t n;
+    size_t cap;
+};
+
+static int sparse_push(struct sparse_map *map, uint64_t offset, uint64_t size) {
+    if (map->n == map->cap) {
+        size_t cap = map->cap ? map->cap * 2 : 16;
+        struct sparse_seg *segs = realloc(map->segs, cap * sizeof(struct sparse_seg));
+        if (segs == NULL) {
+            return -1;
+        }
+        map->segs = segs;
+        map->cap = cap;
+    }
+    // Les segments doivent être triés et disjoints
+    if (map->n > 0 && offset < map->segs[map->n - 1].offset + map->segs[map->n - 1].size) {
+        return -1;
+    }
+    map->segs[map->n].offset = offset;
+    map->segs[map->n].size = size;
+    map->n++;
+    return 0;
+}
+
+/* Descripteurs (offset, taille) de 12 + 12 octets d'un en-tête GNU ou d'un bloc d'extension */
+static int sparse_push_gnu(struct sparse_map *map, const uint8_t *descs, int count) {
+    for (int i = 0; i < count && descs[i * 24] != '\0'; i++) {
+        const char *desc = (const char *)descs + i * 24;
+        if (sparse_push(map, field_number(desc, 12), field_number(desc + 12, 12)) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Carte pax 1.0 : nombre de segments puis offset et taille de chacun, en décimal, un par ligne */
+static int sparse_load_pax(read_at_t read_at, void *src, uint64_t map_off, struct sparse_map *map,
+                           uint64_t *data_off) {
+    uint8_t block[BLOCK_SIZE];
+    uint64_t values[2];
+    uint64_t count = 0;
+    uint64_t read_values = 0;
+    uint64_t number = 0;
+    int digits = 0;
+    uint64_t pos = map_off;
+
+    for (;;) {
+        if (read_at(src, block, BLOCK_SIZE, pos) != BLOCK_SIZE) {
+            return -1;
+        }
+        pos += BLOCK_SIZE;
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            if (block[i] >= '0' && block[i] <= '9' && digits < 20) {
+                number = number * 10 + (block[i] - '0');
+                digits++;
+                continue;
+            }
+            if (block[i] != '\n' || digits == 0) {
+                return -1;
+            }
+            if (read_values == 0) {
+                count = number;
+            } else {
+                values[(read_values - 1) % 2] = number;
+                if ((read_values - 1) % 2 == 1 && sparse_push(map, values[0], values[1]) == -1) {
+                    return -1;
+                }
+            }
+            read_values++;
+            number = 0;
+            digits = 0;
+            if (read_values == 1 + 2 * count) {
+                // Les données commencent au bloc qui suit la carte
+                *data_off = pos;
+                return 0;
+            }
+        }
+    }
+}
+
+static int sparse_load(read_at_t read_at, void *src, char kind, uint64_t map_off, struct sparse_map *map) {
+    uint8_t block[BLOCK_SIZE];
+    uint64_t data_off;
+
+    memset(map, 0, sizeof(*map));
+    if (kind == TAR_SPARSE_GNU) {
+        // map_off suit directement l'en-tête, qui porte les premiers descripteurs
+        if (read_at(src, block, BLOCK_SIZE, map_off - BLOCK_SIZE) != BLOCK_SIZE
+            || sparse_push_gnu(map, block + GNU_SPARSE_OFFSET, 4) == -1) {
+            goto fail;
+        }
+        int extended = block[GNU_ISEXTENDED_OFFSET];
+        data_off = map_off;
+        while (extended) {
+            if (read_at(src, block, BLOCK_SIZE, data_off) != BLOCK_SIZE
+                || sparse_push_gnu(map, block, GNU_EXT_SPARSE) == -1) {
+                goto fail;
+            }
+            extended = block[GNU_EXT_ISEXTENDED_OFFSET];
+            data_off += BLOCK_SIZE;
+        }
+    } else if (sparse_load_pax(read_at, src, map_off, map, &data_off) == -1) {
+        goto fail;
+    }
+
+    // Les segments sont stockés les uns à la suite des autres, sans bourrage
+    for (size_t i = 0; i < map->n; i++) {
+        map->segs[i].data_off = data_off;
+        data_off += map->segs[i].size;
+    }
+    return 0;
+
+fail:
+    free(map->segs);
+    map->segs = NULL;
+    return -1;
+}
+
+/* Indice du premier segment qui se termine après offset, map->n s'il n'y en a pas */
+static size_t sparse_find(const struct sparse_map *map, uint64_t offset) {
+    size_t lo = 0, hi = map->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (map->segs[mid].offset + map->segs[mid].size <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Lit len octets d'un fichier creux à partir de offset, les trous étant remplis de zéros sans lecture */
+static ssize_t sparse_read(const struct sparse_map *map, read_at_t read_at, void *src, uint8_t *dest, size_t len,
+                           uint64_t offset) {
+    size_t i = sparse_find(map, offset);
+    size_t done = 0;
+
+    while (done < len) {
+        uint64_t pos = offset + done;
+        size_t n = len - done;
+        if (i == map->n || map->segs[i].offset > pos) {
+            if (i < map->n && map->segs[i].offset - pos < n) {
+                n = map->segs[i].offset - pos;
+            }
+            memset(dest + done, 0, n);
+            done += n;
+            continue;
+        }
+        const struct sparse_seg *seg = &map->segs[i];
+        if (seg->offset + seg->size - pos < n) {
+            n = seg->offset + seg->size - pos;
+        }
+        ssize_t got = read_at(src, dest + done, n, seg->data_off + (pos - seg->offset));
+        if (got == -1) {
+            return -1;
+        }
+        done += got;
+        if ((size_t)got < n) {
+            break;  // Archive tronquée
+        }
+        i++;
+    }
+    return done;
+}
+
+/* Charge la carte d'un fichier creux, lit dans le fichier, puis libère la carte */
+static ssize_t sparse_pread(read_at_t read_at, void *src, char kind, uint64_t map_off, uint8_t *dest, size_t len,
+                            uint64_t offset) {
+    struct sparse_map map;
+    if (sparse_load(read_at, src, kind, map_off, &map) == -1) {
+        return -1;
+    }
+    ssize_t ret = sparse_read(&map, read_at, src, dest, len, offset);
+    free(map.segs);
+    return ret;
+}
+
+/* Lecteur sur un descripteur, qui ne s'arrête qu'à la fin du fichier */
+static ssize_t read_at_fd(void *src, void *dest, size_t len, uint64_t offset) {
+    int fd = *(int *)src;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = io_pread(fd, (uint8_t *)dest + done, len - done, offset + done);
+        if (n == -1) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+/* Lecteur passant par le tampon d'un itérateur */
+static ssize_t read_at_iter(void *src, void *dest, size_t len, uint64_t offset) {
+    return iter_pread(src, dest, len, offset);
+}
+
+/**
+ * Advances the iterator to the next entry, see tar_iter_next().
+ */
+static int iter_next(tar_iter_t *it, tar_entry_t *entry) {
+    if (it->done) {
+        return 0;
+    }
+    const tar_header_t *hdr = (const tar_header_t *)iter_fetch(it, it->next, BLOCK_SIZE);
+    if (hdr == NULL || hdr->name[0] == '\0') {
+        it->done = 1;
+        return it->error ? -1 : 0;
+    }
+    if (hdr->typeflag == XHDTYPE || hdr->typeflag == GNUTYPE_SPARSE) {
+        if (iter_next_member(it, entry) == -1) {
+            it->done = 1;
+            return it->error ? -1 : 0;
+        }
+        return 1;
+    }
+
+    thread_stats.io.headers_decoded++;
+    entry->header = hdr;
+    entry->pax_blocks = 0;
+    entry->sparse = TAR_SPARSE_NONE;
+    entry->path = it->path;
+    entry->path_len = header_path(hdr, it->path);
+    entry->type = hdr->typeflag;
+    entry->mode = field_number(hdr->mode, sizeof(hdr->mode)) & 07777;
+    entry->mtime = field_number(hdr->mtime, sizeof(hdr->mtime));
+    entry->size = field_number(hdr->size, sizeof(hdr->size));
+    entry->data_offset = it->next + BLOCK_SIZE;
+
+    uint64_t data_size = padded_size(entry->size);
+    it->long_jump = data_size > it->chunk_size;
+    it->next = entry->data_offset + data_size;
+    return 1;
+}
+
+/**
+ * Opens an iterator over the entries of an archive.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param chunk_size The size of the reads issued on the archive, zero selects TAR_ITER_DEFAULT_CHUNK.
+ *
+ * @return a newly allocated iterator to be released with tar_iter_close(),
+ *         NULL if memory could not be allocated.
+ */
+tar_iter_t *tar_iter_open(int tar_fd, size_t chunk_size) {
+    tar_iter_t *it = malloc(sizeof(tar_iter_t));
+    if (it == NULL) {
+        return NULL;
+    }
+    if (iter_init(it, tar_fd, chunk_size) == -1) {
+        free(it);
+        return NULL;
+    }
+    return it;
+}
+
+/**
+ * Advances the iterator to the next entry of the archive.
+ *
+ * @param it An iterator returned by tar_iter_open().
+ * @param entry An out argument, set to the decoded entry. Its pointers are valid until the next call.
+ *
+ * @return 1 if an entry was decoded,
+ *         zero at the end of the archive,
+ *         -1 if the archive could not be read.
+ */
+int tar_iter_next(tar_iter_t *it, tar_entry_t *entry) {
+    return iter_next(it, entry);
+}
+
+/**
+ * Releases an iterator opened by tar_iter_open().
+ *
+ * @param it The iterator to release, may be NULL.
+ */
+void tar_iter_close(tar_iter_t *it) {
+    if (it == NULL) {
+        return;
+    }
+    iter_destroy(it);
+    free(it);
+}
+
+/**
+ * Cherche l'entrée path en parcourant l'archive depuis le début.
+ *
+ * @return 1 si l'entrée a été trouvée (entry est alors rempli), 0 sinon, -1 en cas d'erreur de lecture
+ */
+static int find_header(tar_iter_t *it, const char *path, tar_entry_t *entry) {
+    int ret;
+
+    iter_rewind(it);
+    while ((ret = iter_next(it, entry)) == 1) {
+        if (strcmp(entry->path, path) == 0) {
+            return 1;
+        }
+    }
+    return ret;
+}
+
+/* Copie le nom du lien de l'en-tête, qui n'est pas terminé par un zéro s'il occupe les 100 octets */
+static void header_linkname(const tar_header_t *hdr, char *out) {
+    size_t len = strnlen(hdr->linkname, sizeof(hdr->linkname));
+    memcpy(out, hdr->linkname, len);
+    out[len] = '\0';
+}
+
+/**
+ * Normalise un chemin de l'archive : supprime les '/' initiaux et répétés ainsi que les composants ".", résout les
+ * ".." sans remonter au-dessus de la racine, et garde le '/' final qui désigne un répertoire.
+ *
+ * @return la longueur du chemin normalisé, -1 s'il ne tient pas dans out
+ */
+static ssize_t normalize_path(const char *in, size_t in_len, char *out, size_t out_size) {
+    size_t len = 0;
+    size_t i = 0;
+    int is_dir = in_len > 0 && in[in_len - 1] == '/';
+
+    while (i < in_len) {
+        while (i < in_len && in[i] == '/') {
+            i++;
+        }
+        size_t start = i;
+        while (i < in_len && in[i] != '/') {
+            i++;
+        }
+        size_t comp_len = i - start;
+        if (comp_len == 0) {
+            break;
+        }
+
+        // Chaque composant est suivi d'un '/' dans out, ".." retire le dernier composant
+        if (comp_len == 1 && in[start] == '.') {
+            is_dir = 1;
+        } else if (comp_len == 2 && in[start] == '.' && in[start + 1] == '.') {
+            if (len > 0) {
+                len--;
+                while (len > 0 && out[len - 1] != '/') {
+                    len--;
+                }
+            }
+            is_dir = 1;
+        } else {
+            if (len + comp_len + 1 >= out_size) {
+                return -1;
+            }
+            memcpy(out + len, in + start, comp_len);
+            len += comp_len;
+            out[len++] = '/';
+            is_dir = i < in_len;
+        }
+    }
+
+    if (len > 0 && !is_dir) {
+        len--;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * Calcule le chemin visé par un lien. La cible d'un lien symbolique est relative au répertoire du lien (sauf si elle
+ * est absolue), celle d'un lien physique est relative à la racine de l'archive.
+ *
+ * @return la longueur du chemin normalisé écrit dans out (RESOLVE_PATH_MAX octets), -1 s'il est trop long
+ */
+static ssize_t link_target(const char *link_path, size_t link_len, const char *linkname, char type, char *out) {
+    char tmp[RESOLVE_PATH_MAX];
+    size_t len = 0;
+    size_t name_len = strlen(linkname);
+
+    if (type == SYMTYPE && linkname[0] != '/') {
+        len = parent_len(link_path, link_len);
+        memcpy(tmp, link_path, len);
+    }
+    if (len + name_len >= sizeof(tmp)) {
+        return -1;
+    }
+    memcpy(tmp + len, linkname, name_len);
+    return normalize_path(tmp, len + name_len, out, RESOLVE_PATH_MAX);
+}
+
+/**
+ * Remplace dans path (de longueur len) le préfixe de longueur prefix_len, qui est un lien, par la cible de ce lien.
+ *
+ * @return la longueur du nouveau chemin normalisé écrit dans path, -1 s'il est trop long
+ */
+static ssize_t splice_link(char *path, size_t len, size_t prefix_len, const char *target, size_t target_len) {
+    char tmp[RESOLVE_PATH_MAX];
+    size_t rest_len = len - prefix_len;
+
+    if (target_len + rest_len >= sizeof(tmp)) {
+        return -1;
+    }
+    memcpy(tmp, target, target_len);
+    memcpy(tmp + target_len, path + prefix_len, rest_len);
+    return normalize_path(tmp, target_len + rest_len, path, RESOLVE_PATH_MAX);
+}
+
+static inline int is_link(char type) {
+    return type == SYMTYPE || type == LNKTYPE;
+}
+
+/* Vrai si a et b ne diffèrent que par un '/' final */
+static int same_but_slash(const char *a, size_t a_len, const char *b, size_t b_len) {
+    if (a_len == b_len + 1) {
+        return a[b_len] == '/' && memcmp(a, b, b_len) == 0;
+    }
+    if (b_len == a_len + 1) {
+        return b[a_len] == '/' && memcmp(a, b, a_len) == 0;
+    }
+    return 0;
+}
+
+/* Garde une copie de l'entrée courante, qui reste valide pendant la suite du parcours */
+static void iter_save(tar_iter_t *it, tar_entry_t *saved, const tar_entry_t *entry) {
+    memcpy(&it->saved_header, entry->header, sizeof(tar_header_t));
+    memcpy(it->saved_path, entry->path, entry->path_len + 1);
+    *saved = *entry;
+    saved->header = &it->saved_header;
+    saved->pax_blocks = 0;
+    saved->path = it->saved_path;
+}
+
+/**
+ * Cherche un chemin normalisé en un seul parcours de l'archive. Un répertoire est aussi trouvé sans son '/' final
+ * (et inversement). Si aucune entrée ne correspond, on retient le plus court préfixe du chemin qui est un lien.
+ *
+ * @return 1 si l'entrée a été trouvée,
+ *         2 si le préfixe de longueur *prefix_len du chemin est un lien, décrit par entry,
+ *         0 sinon, -1 en cas d'erreur de lecture
+ */
+static int scan_lookup(tar_iter_t *it, const char *path, size_t len, tar_entry_t *entry, size_t *prefix_len) {
+    tar_entry_t saved;
+    int alt_found = 0;
+    size_t best_prefix = 0;
+    int ret;
+
+    iter_rewind(it);
+    while ((ret = iter_next(it, entry)) == 1) {
+        if (entry->path_len == len && memcmp(entry->path, path, len) == 0) {
+            return 1;
+        }
+        if (alt_found) {
+            continue;
+        }
+        if (same_but_slash(entry->path, entry->path_len, path, len)) {
+            iter_save(it, &saved, entry);
+            alt_found = 1;
+        } else if (is_link(entry->type) && entry->path_len < len && path[entry->path_len] == '/'
+                   && memcmp(entry->path, path, entry->path_len) == 0
+                   && (best_prefix == 0 || entry->path_len < best_prefix)) {
+            iter_save(it, &saved, entry);
+            best_prefix = entry->path_len;
+        }
+    }
+    if (ret == -1) {
+        return -1;
+    }
+    if (alt_found || best_prefix > 0) {
+        *entry = saved;
+        *prefix_len = best_prefix;
+        return alt_found ? 1 : 2;
+    }
+    return 0;
+}
+
+/**
+ * Cherche l'entrée path en suivant les liens, y compris ceux qui apparaissent comme répertoires intermédiaires du
+ * chemin. Les cibles relatives et les ".." sont résolus, et une boucle de liens est détectée par la limite de
+ * MAX_LINK_HOPS sauts.
+ *
+ * @return 1 si une entrée qui n'est pas un lien a été trouvée, 0 sinon, -1 en cas d'erreur de lecture
+ */
+static int resolve_header(tar_iter_t *it, const char *path, tar_entry_t *entry) {
+    char cur[RESOLVE_PATH_MAX];
+    char target[RESOLVE_PATH_MAX];
+    char linkname[sizeof(entry->header->linkname) + 1];
+    ssize_t len = normalize_path(path, strlen(path), cur, sizeof(cur));
+
+    for (int hops = 0; len >= 0; hops++) {
+        size_t prefix_len = 0;
+        int ret = scan_lookup(it, cur, len, entry, &prefix_len);
+        if (ret <= 0) {
+            return ret;
+        }
+        if (ret == 1 && !is_link(entry->type)) {
+            return 1;
+        }
+        if (hops == MAX_LINK_HOPS) {
+            return 0;
+        }
+
+        header_linkname(entry->header, linkname);
+        ssize_t target_len = link_target(entry->path, entry->path_len, linkname, entry->type, target);
+        if (target_len < 0) {
+            return 0;
+        }
+        if (ret == 2) {
+            len = splice_link(cur, len, prefix_len, target, target_len);
+        } else {
+            memcpy(cur, target, target_len + 1);
+            len = target_len;
+        }
+    }
+    return 0;
+}
+
+/* Vérifie le magic, la version et la somme de contrôle d'un en-tête, retourne 0 ou le code de check_archive() */
+static int validate_header(const tar_header_t *header) {
+    // Vérification des champs "magic" et "version"
+    if (strncmp(header->magic, TMAGIC, TMAGLEN) != 0) {
+        return -1;
+    }
+    if (strncmp(header->version, TVERSION, TVERSLEN) != 0) {
+        return -2;
+    }
+
+    // Vérification de la somme de contrôle
+    unsigned int stored_chksum = field_number(header->chksum, sizeof(header->chksum));  // Somme attendue
+    unsigned int computed_chksum = tar_header_chksum(header);
+
+    if (stored_chksum != computed_chksum) {
+        return -3;
+    }
+    return 0;
+}
+
+/* Comme validate_header(), mais accepte aussi le magic GNU : le flux et l'extraction lisent les archives GNU */
+static int validate_member_header(const tar_header_t *header) {
+    if (is_oldgnu(header)) {
+        return field_number(header->chksum, sizeof(header->chksum)) == tar_header_chksum(header) ? 0 : -3;
+    }
+    return validate_header(header);
+}
+
+static int check_scan(int tar_fd) {
+    tar_iter_t it;
+    tar_entry_t entry;
+    int num_headers = 0;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -4;
+    }
+    while (iter_next(&it, &entry) == 1) {
+        // Un en-tête pax compte comme un en-tête à part entière
+        if (entry.pax_blocks != 0) {
+            int ret = validate_header(entry_pax_header(&entry));
+            if (ret != 0) {
+                iter_destroy(&it);
+                return ret;
+            }
+            num_headers++;
+        }
+        int ret = validate_header(entry.header);
+        if (ret != 0) {
+            iter_destroy(&it);
+            return ret;
+        }
+        num_headers++;
+    }
+
+    iter_destroy(&it);
+    return num_headers;
+}
+
+/**
+ * Checks whether the archive is valid, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a file supposed to contain a tar archive.
+ *
+ * @return the same values as check_archive().
+ */
+int check_archive_r(int tar_fd) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_CHECK_ARCHIVE);
+    int ret = check_scan(tar_fd);
+    probe_end(&probe, NULL, NULL);
+    return ret;
+}
+
+static int exists_scan(int tar_fd, const char *path) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -1;
+    }
+    int ret = find_header(&it, path, &entry) == 1;
+    iter_destroy(&it);
+    return ret;
+}
+
+/**
+ * Checks whether an entry exists in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int exists_r(int tar_fd, const char *path) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_EXISTS);
+    int ret = exists_scan(tar_fd, path);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+static int is_dir_scan(int tar_fd, const char *path) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -1;
+    }
+    int ret = find_header(&it, path, &entry) == 1 && entry.type == DIRTYPE;
+    iter_destroy(&it);
+    return ret;
+}
+
+/**
+ * Checks whether an entry exists in the archive and is a directory, without using nor modifying the file offset of
+ * tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int is_dir_r(int tar_fd, const char *path) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_IS_DIR);
+    int ret = is_dir_scan(tar_fd, path);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+static int is_file_scan(int tar_fd, const char *path) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -1;
+    }
+    int ret = find_header(&it, path, &entry) == 1 && is_file_type(entry.type);
+    iter_destroy(&it);
+    return ret;
+}
+
+/**
+ * Checks whether an entry exists in the archive and is a file, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a file,
+ *         any other value otherwise.
+ */
+int is_file_r(int tar_fd, const char *path) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_IS_FILE);
+    int ret = is_file_scan(tar_fd, path);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+static int is_symlink_scan(int tar_fd, const char *path) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -1;
+    }
+    int ret = find_header(&it, path, &entry) == 1 && (entry.type == SYMTYPE || entry.type == LNKTYPE);
+    iter_destroy(&it);
+    return ret;
+}
+
+/**
+ * Checks whether an entry exists in the archive and is a symlink, without using nor modifying the file offset of
+ * tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
+ *         any other value otherwise.
+ */
+int is_symlink_r(int tar_fd, const char *path) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_IS_SYMLINK);
+    int ret = is_symlink_scan(tar_fd, path);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+static int list_scan(int tar_fd, const char *path, char **entries, size_t *no_entries) {
+    tar_iter_t it;
+    tar_entry_t entry;
+    char dir[sizeof(it.path)];
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        *no_entries = 0;
+        return 0;
+    }
+    if (resolve_header(&it, path, &entry) != 1 || entry.type != DIRTYPE) {
+        iter_destroy(&it);
+        *no_entries = 0;
+        return 0;
+    }
+    size_t dir_len = entry.path_len;
+    memcpy(dir, entry.path, dir_len + 1);
+
+    size_t countEntry = 0;
+    iter_rewind(&it);
+    while (iter_next(&it, &entry) == 1) {
+        // Une entrée est listée si elle est directement dans le répertoire : le reste du chemin ne contient
+        // pas de '/', sauf éventuellement à la fin pour un sous-répertoire
+        if (entry.path_len > dir_len && strncmp(entry.path, dir, dir_len) == 0) {
+            const char *slash = strchr(entry.path + dir_len, '/');
+            if (slash == NULL || slash == entry.path + entry.path_len - 1) {
+                if (countEntry < *no_entries) {
+                    strncpy(entries[countEntry], entry.path, 100);
+                    countEntry++;
+                }
+            }
+        }
+    }
+
+    iter_destroy(&it);
+    *no_entries = countEntry;
+    return 1;
+}
+
+/**
+ * Lists the entries at a given path in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int list_r(int tar_fd, const char *path, char **entries, size_t *no_entries) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_LIST);
+    int ret = list_scan(tar_fd, path, entries, no_entries);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+static ssize_t read_file_scan(int tar_fd, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        *len = 0;
+        return -1;
+    }
+    if (resolve_header(&it, path, &entry) != 1 || !is_file_type(entry.type)) {
+        iter_destroy(&it);
+        *len = 0;
+        return -1;
+    }
+
+    size_t file_size = entry.size;
+
+    // Vérification de l'offset
+    if (offset >= file_size) {
+        iter_destroy(&it);
+        *len = 0;
+        return -2;
+    }
+
+    size_t bytes_to_read = file_size - offset;
+    if (bytes_to_read > *len) {
+        bytes_to_read = *len;  // Ne pas dépasser la taille du tampon
+    }
+
+    // Les données d'un petit fichier sont souvent déjà dans le morceau lu avec son en-tête
+    ssize_t bytes_read = entry.sparse != TAR_SPARSE_NONE
+                         ? sparse_pread(read_at_iter, &it, entry.sparse, entry.data_offset, dest, bytes_to_read, offset)
+                         : iter_pread(&it, dest, bytes_to_read, entry.data_offset + offset);
+    iter_destroy(&it);
+    if (bytes_read == -1) {
+        *len = 0;
+        return -1;
+    }
+    *len = bytes_read;
+
+    // Retourner le nombre d'octets restants à lire
+    return file_size - offset - bytes_read;
+}
+
+/**
+ * Reads a file at a given path in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t read_file_r(int tar_fd, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_READ_FILE);
+    ssize_t ret = read_file_scan(tar_fd, path, offset, dest, len);
+    probe_end(&probe, path, NULL);
+    return ret;
+}
+
+/**
+ * Checks whether the archive is valid.
+ *
+ * Each non-null header of a valid archive has:
+ *  - a magic value of "ustar" and a null,
+ *  - a version value of "00" and no null,
+ *  - a correct checksum
+ *
+ * @param tar_fd A file descriptor pointing to the start of a file supposed to contain a tar archive.
+ *
+ * @return a zero or positive value if the archive is valid, representing the number of non-null headers in the archive,
+ *         -1 if the archive contains a header with an invalid magic value,
+ *         -2 if the archive contains a header with an invalid version value,
+ *         -3 if the archive contains a header with an invalid checksum value
+ */
+int check_archive(int tar_fd) {
+    return check_archive_r(tar_fd);
+}
+
+/**
+ * Checks whether an entry exists in the archive.
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int exists(int tar_fd, char *path) {
+    return exists_r(tar_fd, path);
+}
+
+
+/**
+ * Checks whether an entry exists in the archive and is a directory.
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int is_dir(int tar_fd, char *path) {
+    return is_dir_r(tar_fd, path);
+}
+
+/**
+ * Checks whether an entry exists in the archive and is a file.
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a file,
+ *         any other value otherwise.
+ */
+int is_file(int tar_fd, char *path) {
+    return is_file_r(tar_fd, path);
+}
+
+/**
+ * Checks whether an entry exists in the archive and is a symlink.
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
+ *         any other value otherwise.
+ */
+int is_symlink(int tar_fd, char *path) {
+    return is_symlink_r(tar_fd, path);
+}
+
+
+/**
+ * Lists the entries at a given path in the archive.
+ * list() does not recurse into the directories listed at the given path.
+ *
+ * Example:
+ *  dir/          list(..., "dir/", ...) lists "dir/a", "dir/b", "dir/c/" and "dir/e/"
+ *   ├── a
+ *   ├── b
+ *   ├── c/
+ *   │   └── d
+ *   └── e/
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive. If the entry is a symlink, it must be resolved to its linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+
+int list(int tar_fd, char *path, char **entries, size_t *no_entries) {
+    return list_r(tar_fd, path, entries, no_entries);
+}
+
+
+/**
+ * Reads a file at a given path in the archive.
+ *
+ * @param tar_fd A file descriptor pointing to the start of a valid tar archive file.
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it must be resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return -1 if no entry at the given path exists in the archive or the entry is not a file,
+ *         -2 if the offset is outside the file total length,
+ *         zero if the file was read in its entirety into the destination buffer,
+ *         a positive value if the file was partially read, representing the remaining bytes left to be read to reach
+ *         the end of the file.
+ *
+ */
+ssize_t read_file(int tar_fd, char *path, size_t offset, uint8_t *dest, size_t *len) {
+    return read_file_r(tar_fd, path, offset, dest, len);
+}
+
+/*
+ * Validation parallèle.
+ *
+ * Le thread appelant parcourt la chaîne des en-têtes avec un itérateur à petits morceaux et
+ * distribue leurs offsets par lots à un ensemble de threads qui relisent chaque en-tête avec pread() et le valident.
+ * Le résultat est celui de l'en-tête invalide de plus petit indice, comme pour check_archive().
+ */
+#define CHECK_BATCH 1024
+#define CHECK_WINDOW (64 * 1024)
+
+struct check_batch {
+    size_t first;                 // indice du premier en-tête du lot
+    size_t count;
+    off_t offsets[CHECK_BATCH];
+    struct check_batch *next;
+};
+
+struct check_shared {
+    int tar_fd;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct check_batch *head;
+    struct check_batch *tail;
+    int done;
+    size_t fail_index;            // SIZE_MAX tant qu'aucun en-tête invalide n'a été trouvé
+    int fail_code;
+};
+
+static size_t check_fail_index(struct check_shared *shared) {
+    return __atomic_load_n(&shared->fail_index, __ATOMIC_RELAXED);
+}
+
+static void check_report(struct check_shared *shared, size_t index, int code) {
+    pthread_mutex_lock(&shared->lock);
+    if (index < shared->fail_index) {
+        __atomic_store_n(&shared->fail_index, index, __ATOMIC_RELAXED);
+        shared->fail_code = code;
+    }
+    pthread_mutex_unlock(&shared->lock);
+}
+
+static void *check_worker(void *arg) {
+    struct check_shared *shared = arg;
+    tar_header_t header;
+
+    for (;;) {
+        pthread_mutex_lock(&shared->lock);
+        while (shared->head == NULL && !shared->done) {
+            pthread_cond_wait(&shared->cond, &shared->lock);
+        }
+        struct check_batch *batch = shared->head;
+        if (batch == NULL) {
+            pthread_mutex_unlock(&shared->lock);
+            return NULL;
+        }
+        shared->head = batch->next;
+        if (shared->head == NULL) {
+            shared->tail = NULL;
+        }
+        pthread_mutex_unlock(&shared->lock);
+
+        for (size_t i = 0; i < batch->count; i++) {
+            // Inutile de valider au-delà d'un en-tête invalide déjà trouvé
+            if (batch->first + i >= check_fail_index(shared)) {
+                break;
+            }
+            int ret = -1;
+            if (io_pread(shared->tar_fd, &header, sizeof(header), batch->offsets[i]) == sizeof(header)) {
+                ret = validate_header(&header);
+            }
+            if (ret != 0) {
+                check_report(shared, batch->first + i, ret);
+                break;
+            }
+        }
+        free(batch);
+    }
+}
+
+static void check_push(struct check_shared *shared, struct check_batch *batch) {
+    pthread_mutex_lock(&shared->lock);
+    batch->next = NULL;
+    if (shared->tail == NULL) {
+        shared->head = batch;
+    } else {
+        shared->tail->next = batch;
+    }
+    shared->tail = batch;
+    pthread_cond_signal(&shared->cond);
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/* Parcourt la chaîne des en-têtes et la distribue aux threads, retourne le nombre d'en-têtes ou -1 */
+static ssize_t check_walk(struct check_shared *shared) {
+    tar_iter_t it;
+    tar_entry_t entry;
+    struct check_batch *batch = NULL;
+    size_t count = 0;
+
+    if (iter_init(&it, shared->tar_fd, CHECK_WINDOW) == -1) {
+        return -1;
+    }
+    while (count < check_fail_index(shared) && iter_next(&it, &entry) == 1) {
+        uint64_t offsets[2];
+        int n_headers = 0;
+        uint64_t header_offset = entry.data_offset - BLOCK_SIZE;
+        if (entry.pax_blocks != 0) {
+            offsets[n_headers++] = header_offset - entry.pax_blocks * BLOCK_SIZE;
+        }
+        offsets[n_headers++] = header_offset;
+
+        for (int i = 0; i < n_headers; i++) {
+            if (batch == NULL) {
+                batch = malloc(sizeof(struct check_batch));
+                if (batch == NULL) {
+                    iter_destroy(&it);
+                    return -1;
+                }
+                batch->first = count;
+                batch->count = 0;
+            }
+            batch->offsets[batch->count++] = offsets[i];
+            count++;
+            if (batch->count == CHECK_BATCH) {
+                check_push(shared, batch);
+                batch = NULL;
+            }
+        }
+
+        // La taille d'un en-tête au magic ou à la version invalide n'a pas de sens : la validation s'arrêtera là
+        if (strncmp(entry.header->magic, TMAGIC, TMAGLEN) != 0
+            || strncmp(entry.header->version, TVERSION, TVERSLEN) != 0) {
+            break;
+        }
+    }
+    if (batch != NULL) {
+        check_push(shared, batch);
+    }
+    iter_destroy(&it);
+    return count;
+}
+
+/**
+ * Checks whether the archive is valid, using several threads.
+ *
+ * @param tar_fd A file descriptor pointing to a file supposed to contain a tar archive. Its file offset is not used
+ *               nor modified.
+ * @param nthreads The number of validation threads, zero or a negative value uses one thread per online CPU.
+ *
+ * @return the same values as check_archive().
+ */
+int check_archive_parallel(int tar_fd, int nthreads) {
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? cpus : 1;
+    }
+
+    struct check_shared shared = {
+        .tar_fd = tar_fd,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .fail_index = SIZE_MAX,
+    };
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    if (threads == NULL) {
+        return check_archive_r(tar_fd);
+    }
+    int started = 0;
+    while (started < nthreads && pthread_create(&threads[started], NULL, check_worker, &shared) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        free(threads);
+        return check_archive_r(tar_fd);
+    }
+
+    ssize_t count = check_walk(&shared);
+
+    pthread_mutex_lock(&shared.lock);
+    shared.done = 1;
+    pthread_cond_broadcast(&shared.cond);
+    pthread_mutex_unlock(&shared.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // Lots restants si le parcours a échoué avant que les threads ne les consomment
+    while (shared.head != NULL) {
+        struct check_batch *next = shared.head->next;
+        free(shared.head);
+        shared.head = next;
+    }
+
+    if (shared.fail_index != SIZE_MAX) {
+        return shared.fail_code;
+    }
+    if (count == -1) {
+        return check_archive_r(tar_fd);
+    }
+    return count;
+}
+
+/*
+ * Cache d'extents.
+ *
+ * L'archive est découpée en extents de taille fixe, identifiés par leur numéro (offset / taille). Le cache est
+ * partagé en shards, chacun avec son verrou, sa table de hachage chaînée et ses emplacements, remplacés selon
+ * l'algorithme CLOCK : l'aiguille passe sur les emplacements et libère le premier qui n'a pas été lu depuis son
+ * dernier passage. La lecture d'un extent absent se fait hors du verrou, dans un tampon qui prend ensuite la place de
+ * celui de l'emplacement libéré.
+ */
+#define CACHE_SHARDS 16
+#define CACHE_NONE UINT32_MAX
+
+struct cache_slot {
+    uint64_t key;         // numéro de l'extent
+    uint8_t *data;        // NULL si l'emplacement est libre
+    size_t len;           // octets valides, moins que la taille d'un extent à la fin de l'archive
+    uint32_t next;        // chaînage dans la table de hachage
+    int referenced;
+};
+
+struct cache_shard {
+    pthread_mutex_t lock;
+    struct cache_slot *slots;
+    uint32_t n_slots;
+    uint32_t *buckets;    // premier emplacement de chaque chaîne
+    uint32_t mask;
+    uint32_t hand;        // aiguille de CLOCK
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} __attribute__((aligned(64)));
+
+struct extent_cache {
+    int tar_fd;
+    size_t extent_size;
+    size_t n_shards;
+    struct cache_shard shards[CACHE_SHARDS];
+};
+
+static inline uint64_t cache_mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void cache_destroy(struct extent_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        struct cache_shard *shard = &cache->shards[i];
+        if (shard->slots != NULL) {
+            for (uint32_t j = 0; j < shard->n_slots; j++) {
+                free(shard->slots[j].data);
+            }
+        }
+        free(shard->slots);
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(cache);
+}
+
+static struct extent_cache *cache_create(int tar_fd, size_t budget, size_t extent_size) {
+    size_t n_extents = budget / extent_size;
+    if (n_extents == 0) {
+        n_extents = 1;
+    }
+    struct extent_cache *cache = calloc(1, sizeof(struct extent_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->tar_fd = tar_fd;
+    cache->extent_size = extent_size;
+    cache->n_shards = n_extents < CACHE_SHARDS ? n_extents : CACHE_SHARDS;
+
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        struct cache_shard *shard = &cache->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->n_slots = n_extents / cache->n_shards + (i < n_extents % cache->n_shards);
+        uint32_t n_buckets = 1;
+        while (n_buckets < shard->n_slots * 2) {
+            n_buckets *= 2;
+        }
+        shard->mask = n_buckets - 1;
+        shard->slots = calloc(shard->n_slots, sizeof(struct cache_slot));
+        shard->buckets = malloc(n_buckets * sizeof(uint32_t));
+        if (shard->slots == NULL || shard->buckets == NULL) {
+            cache->n_shards = i + 1;
+            cache_destroy(cache);
+            return NULL;
+        }
+        memset(shard->buckets, 0xff, n_buckets * sizeof(uint32_t));
+    }
+    return cache;
+}
+
+static uint32_t cache_lookup(const struct cache_shard *shard, uint64_t key, uint64_t mixed) {
+    uint32_t i = shard->buckets[(mixed >> 8) & shard->mask];
+    while (i != CACHE_NONE && shard->slots[i].key != key) {
+        i = shard->slots[i].next;
+    }
+    return i;
+}
+
+static void cache_unlink(struct cache_shard *shard, uint32_t slot_index) {
+    struct cache_slot *slot = &shard->slots[slot_index];
+    uint32_t *link = &shard->buckets[(cache_mix(slot->key) >> 8) & shard->mask];
+    while (*link != slot_index) {
+        link = &shard->slots[*link].next;
+    }
+    *link = slot->next;
+}
+
+/* Place un extent lu dans le cache, data lui appartient ensuite ; retourne l'emplacement, le verrou étant pris */
+static uint32_t cache_insert(struct cache_shard *shard, uint64_t key, uint64_t mixed, uint8_t *data, size_t len) {
+    for (;;) {
+        struct cache_slot *slot = &shard->slots[shard->hand];
+        uint32_t victim = shard->hand;
+        shard->hand = shard->hand + 1 == shard->n_slots ? 0 : shard->hand + 1;
+        if (slot->data != NULL && slot->referenced) {
+            slot->referenced = 0;
+            continue;
+        }
+        if (slot->data != NULL) {
+            cache_unlink(shard, victim);
+            free(slot->data);
+            shard->evictions++;
+        }
+        uint32_t *bucket = &shard->buckets[(mixed >> 8) & shard->mask];
+        slot->key = key;
+        slot->data = data;
+        slot->len = len;
+        slot->referenced = 1;
+        slot->next = *bucket;
+        *bucket = victim;
+        return victim;
+    }
+}
+
+/* Lecteur passant par le cache, src étant le cache */
+static ssize_t read_at_cache(void *src, void *dest, size_t len, uint64_t offset) {
+    struct extent_cache *cache = src;
+    size_t done = 0;
+
+    while (done < len) {
+        uint64_t pos = offset + done;
+        uint64_t key = pos / cache->extent_size;
+        size_t in_extent = pos % cache->extent_size;
+        uint64_t mixed = cache_mix(key);
+        struct cache_shard *shard = &cache->shards[mixed % cache->n_shards];
+
+        pthread_mutex_lock(&shard->lock);
+        uint32_t i = cache_lookup(shard, key, mixed);
+        if (i != CACHE_NONE) {
+            shard->hits++;
+        } else {
+            shard->misses++;
+            pthread_mutex_unlock(&shard->lock);
+
+            uint8_t *data = malloc(cache->extent_size);
+            if (data == NULL) {
+                return -1;
+            }
+            ssize_t n = read_at_fd(&cache->tar_fd, data, cache->extent_size, key * cache->extent_size);
+            if (n == -1) {
+                free(data);
+                return -1;
+            }
+
+            pthread_mutex_lock(&shard->lock);
+            // Un autre thread a pu lire le même extent entre-temps
+            i = cache_lookup(shard, key, mixed);
+            if (i == CACHE_NONE) {
+                i = cache_insert(shard, key, mixed, data, n);
+            } else {
+                free(data);
+            }
+        }
+        struct cache_slot *slot = &shard->slots[i];
+        slot->referenced = 1;
+        size_t n = 0;
+        if (in_extent < slot->len) {
+            n = slot->len - in_extent < len - done ? slot->len - in_extent : len - done;
+            memcpy((uint8_t *)dest + done, slot->data + in_extent, n);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        if (n == 0) {
+            break;  // Fin de l'archive
+        }
+        done += n;
+    }
+    return done;
+}
+
+/* Entrée décodée d'un index, les chaînes sont stockées dans l'arène de l'index */
+typedef struct {
+    uint64_t size;
+    uint64_t data_off;
+    uint32_t path_off;
+    uint32_t path_len;
+    uint32_t link_off;
+    uint32_t hash;
+    uint32_t first_child;    // indices dans entries, NO_ENTRY si absent
+    uint32_t next_sibling;
+    uint32_t resolved;       // pour un lien, entrée finale une fois résolue, NO_ENTRY tant qu'inconnue
+    char type;
+    char sparse;             // pour un fichier creux, data_off donne la position de sa carte
+} index_entry_t;
+
+#define NO_ENTRY UINT32_MAX
+#define BROKEN_LINK (UINT32_MAX - 1)
+
+struct tar_index {
+    int tar_fd;
+    index_entry_t *entries;
+    size_t n_entries;
+    size_t cap_entries;
+    char *strings;
+    size_t strings_len;
+    size_t strings_cap;
+    uint32_t *slots;     // 0 si vide, sinon indice de l'entrée + 1
+    size_t n_slots;      // toujours une puissance de 2
+    uint32_t root_first; // première entrée à la racine de l'archive
+    int external;        // les tableaux pointent dans un fichier projeté en mémoire et n'appartiennent pas à l'index
+    void *map;           // fichier projeté par tar_index_load(), à libérer avec l'index
+    size_t map_len;
+    struct extent_cache *cache;   // cache d'extents des lectures, NULL s'il n'est pas activé
+    tar_stats_t stats;   // activité des appels faits sur l'index, mise à jour atomiquement
+};
+
+/* FNV-1a 32 bits */
+static uint32_t path_hash(const char *path, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int index_push_string(tar_index_t *index, const char *str, size_t len, uint32_t *off) {
+    if (index->strings_len + len + 1 > index->strings_cap) {
+        size_t cap = index->strings_cap ? index->strings_cap * 2 : 4096;
+        while (cap < index->strings_len + len + 1) {
+            cap *= 2;
+        }
+        char *strings = realloc(index->strings, cap);
+        if (strings == NULL) {
+            return -1;
+        }
+        index->strings = strings;
+        index->strings_cap = cap;
+    }
+    *off = index->strings_len;
+    memcpy(index->strings + index->strings_len, str, len);
+    index->strings[index->strings_len + len] = '\0';
+    index->strings_len += len + 1;
+    return 0;
+}
+
+static const index_entry_t *index_find_len(const tar_index_t *index, const char *path, size_t len) {
+    if (index->n_slots == 0) {
+        return NULL;
+    }
+    uint32_t h = path_hash(path, len);
+    size_t mask = index->n_slots - 1;
+
+    for (size_t i = h & mask; index->slots[i] != 0; i = (i + 1) & mask) {
+        const index_entry_t *entry = &index->entries[index->slots[i] - 1];
+        if (entry->hash == h && entry->path_len == len
+            && memcmp(index->strings + entry->path_off, path, len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static const index_entry_t *index_find(const tar_index_t *index, const char *path) {
+    return index_find_len(index, path, strlen(path));
+}
+
+/**
+ * Relie chaque entrée à son répertoire parent. Les entrées sont parcourues à l'envers et ajoutées en tête de liste,
+ * les enfants sont donc dans l'ordre de l'archive. Seule la première occurrence d'un chemin fait partie de l'arbre,
+ * et une entrée dont le répertoire parent n'est pas dans l'archive n'est rattachée à rien, comme pour list().
+ */
+static void index_build_tree(tar_index_t *index) {
+    index->root_first = NO_ENTRY;
+    for (size_t e = 0; e < index->n_entries; e++) {
+        index->entries[e].first_child = NO_ENTRY;
+        index->entries[e].next_sibling = NO_ENTRY;
+    }
+
+    for (size_t e = index->n_entries; e-- > 0;) {
+        index_entry_t *entry = &index->entries[e];
+        const char *path = index->strings + entry->path_off;
+        if (index_find_len(index, path, entry->path_len) != entry) {
+            continue;
+        }
+
+        size_t len = parent_len(path, entry->path_len);
+        uint32_t *head;
+        if (len == 0) {
+            head = &index->root_first;
+        } else {
+            const index_entry_t *parent = index_find_len(index, path, len);
+            if (parent == NULL || parent->type != DIRTYPE) {
+                continue;
+            }
+            head = &index->entries[parent - index->entries].first_child;
+        }
+        entry->next_sibling = *head;
+        *head = e;
+    }
+}
+
+/* Remplit la table de hachage, en cas de doublon la première entrée de l'archive l'emporte comme pour exists() */
+static int index_build_slots(tar_index_t *index) {
+    size_t n_slots = 16;
+    while (n_slots < index->n_entries * 2) {
+        n_slots *= 2;
+    }
+    index->slots = calloc(n_slots, sizeof(uint32_t));
+    if (index->slots == NULL) {
+        return -1;
+    }
+    index->n_slots = n_slots;
+
+    size_t mask = n_slots - 1;
+    for (size_t e = 0; e < index->n_entries; e++) {
+        const index_entry_t *entry = &index->entries[e];
+        size_t i = entry->hash & mask;
+        int duplicate = 0;
+        while (index->slots[i] != 0) {
+            const index_entry_t *other = &index->entries[index->slots[i] - 1];
+            if (other->hash == entry->hash && other->path_len == entry->path_len
+                && memcmp(index->strings + other->path_off, index->strings + entry->path_off, entry->path_len) == 0) {
+                duplicate = 1;
+                break;
+            }
+            i = (i + 1) & mask;
+        }
+        if (!duplicate) {
+            index->slots[i] = e + 1;
+        }
+    }
+    return 0;
+}
+
+/* Clé de tri d'une entrée : à chemin égal, l'ordre de l'archive est conservé */
+struct sort_key {
+    const char *path;
+    uint64_t data_off;
+    uint32_t entry;
+};
+
+static int sort_key_cmp(const void *a, const void *b) {
+    const struct sort_key *ka = a;
+    const struct sort_key *kb = b;
+    int cmp = strcmp(ka->path, kb->path);
+    if (cmp == 0) {
+        cmp = ka->data_off < kb->data_off ? -1 : 1;
+    }
+    return cmp;
+}
+
+/* Trie les entrées par chemin en renumérotant les liens de l'arbre et du cache de résolution */
+static int index_sort(tar_index_t *index) {
+    size_t n = index->n_entries;
+    struct sort_key *keys = malloc(n * sizeof(struct sort_key));
+    uint32_t *rank = malloc(n * sizeof(uint32_t));
+    index_entry_t *sorted = malloc(n * sizeof(index_entry_t));
+    if (keys == NULL || rank == NULL || sorted == NULL) {
+        free(keys);
+        free(rank);
+        free(sorted);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        keys[i].path = index->strings + index->entries[i].path_off;
+        keys[i].data_off = index->entries[i].data_off;
+        keys[i].entry = i;
+    }
+    qsort(keys, n, sizeof(struct sort_key), sort_key_cmp);
+
+    for (size_t i = 0; i < n; i++) {
+        rank[keys[i].entry] = i;
+    }
+#define RENUMBER(x) ((x) == NO_ENTRY || (x) == BROKEN_LINK ? (x) : rank[(x)])
+    for (size_t i = 0; i < n; i++) {
+        sorted[i] = index->entries[keys[i].entry];
+        sorted[i].first_child = RENUMBER(sorted[i].first_child);
+        sorted[i].next_sibling = RENUMBER(sorted[i].next_sibling);
+        sorted[i].resolved = RENUMBER(sorted[i].resolved);
+    }
+    index->root_first = RENUMBER(index->root_first);
+#undef RENUMBER
+
+    free(index->entries);
+    index->entries = sorted;
+    index->cap_entries = n;
+    free(keys);
+    free(rank);
+    return 0;
+}
+
+/**
+ * Termine la construction d'un index : table de hachage, arbre des répertoires (qui garde l'ordre de l'archive),
+ * puis tri des entrées par chemin et reconstruction de la table de hachage dans ce nouvel ordre.
+ */
+static int index_finish(tar_index_t *index) {
+    if (index_build_slots(index) == -1) {
+        return -1;
+    }
+    index_build_tree(index);
+    free(index->slots);
+    index->slots = NULL;
+    if (index_sort(index) == -1) {
+        return -1;
+    }
+    return index_build_slots(index);
+}
+
+/* Ajoute à l'index une entrée décodée par entry_decode() */
+static int index_add_entry(tar_index_t *index, const tar_entry_t *decoded) {
+    if (index->n_entries == index->cap_entries) {
+        size_t cap = index->cap_entries ? index->cap_entries * 2 : 64;
+        index_entry_t *entries = realloc(index->entries, cap * sizeof(index_entry_t));
+        if (entries == NULL) {
+            return -1;
+        }
+        index->entries = entries;
+        index->cap_entries = cap;
+    }
+
+    const tar_header_t *hdr = decoded->header;
+    index_entry_t *entry = &index->entries[index->n_entries];
+    entry->path_len = decoded->path_len;
+    entry->hash = path_hash(decoded->path, decoded->path_len);
+    entry->type = decoded->type;
+    entry->sparse = decoded->sparse;
+    entry->size = decoded->size;
+    entry->data_off = decoded->data_offset;
+    entry->resolved = NO_ENTRY;
+    if (index_push_string(index, decoded->path, decoded->path_len, &entry->path_off) == -1
+        || index_push_string(index, hdr->linkname, strnlen(hdr->linkname, sizeof(hdr->linkname)),
+                             &entry->link_off) == -1) {
+        return -1;
+    }
+    index->n_entries++;
+    return 0;
+}
+
+/**
+ * Builds an index of the archive in a single pass.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ *
+ * @return a newly allocated index to be released with tar_index_close(),
+ *         NULL if the archive could not be read or memory could not be allocated.
+ */
+tar_index_t *tar_index_open(int tar_fd) {
+    tar_index_t *index = calloc(1, sizeof(tar_index_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    index->tar_fd = tar_fd;
+
+    tar_iter_t it;
+    tar_entry_t entry;
+    int ret;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        free(index);
+        return NULL;
+    }
+    while ((ret = iter_next(&it, &entry)) == 1) {
+        if (index_add_entry(index, &entry) == -1) {
+            break;
+        }
+    }
+    iter_destroy(&it);
+
+    if (ret != 0 || index_finish(index) == -1) {
+        tar_index_close(index);
+        return NULL;
+    }
+    return index;
+}
+
+/**
+ * Releases an index built by tar_index_open().
+ *
+ * @param index The index to release, may be NULL.
+ */
+void tar_index_close(tar_index_t *index) {
+    if (index == NULL) {
+        return;
+    }
+    if (!index->external) {
+        free(index->entries);
+        free(index->strings);
+        free(index->slots);
+    }
+    if (index->map != NULL) {
+        munmap(index->map, index->map_len);
+    }
+    cache_destroy(index->cache);
+    free(index);
+}
+
+/**
+ * Checks whether an entry exists in the indexed archive.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_index_exists(const tar_index_t *index, const char *path) {
+    return index_find(index, path) != NULL;
+}
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a directory.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int tar_index_is_dir(const tar_index_t *index, const char *path) {
+    const index_entry_t *entry = index_find(index, path);
+    return entry != NULL && entry->type == DIRTYPE;
+}
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a file.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a file,
+ *         any other value otherwise.
+ */
+int tar_index_is_file(const tar_index_t *index, const char *path) {
+    const index_entry_t *entry = index_find(index, path);
+    return entry != NULL && is_file_type(entry->type);
+}
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a symlink.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
+ *         any other value otherwise.
+ */
+int tar_index_is_symlink(const tar_index_t *index, const char *path) {
+    const index_entry_t *entry = index_find(index, path);
+    return entry != NULL && (entry->type == SYMTYPE || entry->type == LNKTYPE);
+}
+
+
+/* Cherche un chemin normalisé, un répertoire est aussi trouvé sans son '/' final (et inversement) */
+static const index_entry_t *index_lookup(const tar_index_t *index, const char *path, size_t len) {
+    const index_entry_t *entry = index_find_len(index, path, len);
+
+    if (entry == NULL && len > 0) {
+        if (path[len - 1] == '/') {
+            entry = index_find_len(index, path, len - 1);
+        } else if (len + 1 < RESOLVE_PATH_MAX) {
+            char dir[RESOLVE_PATH_MAX];
+            memcpy(dir, path, len);
+            dir[len] = '/';
+            entry = index_find_len(index, dir, len + 1);
+        }
+    }
+    return entry;
+}
+
+/**
+ * Suit les liens de l'index, comme resolve_header(), jusqu'à une entrée qui n'est pas un lien. Le résultat est mémorisé
+ * dans chaque lien traversé, la résolution d'un lien déjà rencontré se fait donc en temps constant. Seuls une entrée
+ * trouvée, une cible absente ou invalide et une boucle avérée sont mémorisés : un lien arrêté par la limite de
+ * MAX_LINK_HOPS sauts peut être à quelques sauts de sa cible, et se résoudrait en partant de plus près.
+ *
+ * @return l'entrée finale, NULL si la chaîne de liens est cassée, forme une boucle ou est trop longue
+ */
+static const index_entry_t *index_resolve(const tar_index_t *index, const char *path) {
+    char cur[RESOLVE_PATH_MAX];
+    char target[RESOLVE_PATH_MAX];
+    uint32_t visited[MAX_LINK_HOPS + 1];
+    int n_visited = 0;
+    int memoize = 1;
+    const index_entry_t *result = NULL;
+    ssize_t len = normalize_path(path, strlen(path), cur, sizeof(cur));
+
+    for (int hops = 0; len >= 0; hops++) {
+        const index_entry_t *entry = index_lookup(index, cur, len);
+        size_t prefix_len = 0;
+
+        if (entry == NULL) {
+            // Un répertoire intermédiaire du chemin est peut-être un lien
+            for (size_t i = 1; i + 1 < (size_t)len && entry == NULL; i++) {
+                if (cur[i] == '/') {
+                    entry = index_find_len(index, cur, i);
+                    if (entry != NULL && !is_link(entry->type)) {
+                        entry = NULL;
+                    }
+                    prefix_len = i;
+                }
+            }
+            if (entry == NULL) {
+                break;
+            }
+        } else if (!is_link(entry->type)) {
+            result = entry;
+            break;
+        } else {
+            uint32_t cached = __atomic_load_n(&entry->resolved, __ATOMIC_RELAXED);
+            if (cached != NO_ENTRY) {
+                result = cached == BROKEN_LINK ? NULL : &index->entries[cached];
+                break;
+            }
+            // Un lien déjà traversé par cette résolution : la boucle est avérée
+            uint32_t id = entry - index->entries;
+            for (int i = 0; i < n_visited; i++) {
+                if (visited[i] == id) {
+                    len = -1;
+                    break;
+                }
+            }
+            if (len < 0) {
+                break;
+            }
+            visited[n_visited++] = id;
+        }
+        if (hops == MAX_LINK_HOPS) {
+            memoize = 0;
+            break;
+        }
+
+        ssize_t target_len = link_target(index->strings + entry->path_off, entry->path_len,
+                                         index->strings + entry->link_off, entry->type, target);
+        if (target_len < 0) {
+            break;
+        }
+        if (prefix_len > 0) {
+            len = splice_link(cur, len, prefix_len, target, target_len);
+        } else {
+            memcpy(cur, target, target_len + 1);
+            len = target_len;
+        }
+    }
+
+    // La table est partagée entre threads : le cache est écrit atomiquement, deux threads y écrivent la même valeur
+    uint32_t value = result == NULL ? BROKEN_LINK : (uint32_t)(result - index->entries);
+    for (int i = 0; memoize && i < n_visited; i++) {
+        __atomic_store_n(&index->entries[visited[i]].resolved, value, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+/**
+ * Lists the entries of a directory of the indexed archive, a page at a time.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to a directory in the archive, or an empty string for the root of the archive. If the entry is a
+ *             symlink, it is resolved to its linked-to entry.
+ * @param cursor An in-out argument. The caller set it to zero to start listing the directory, and then passes it back
+ *               unchanged to get the next pages.
+ * @param entries An array of max_entries entries to fill.
+ * @param max_entries The number of entries in `entries`.
+ *
+ * @return the number of entries listed, zero once the whole directory has been listed,
+ *         -1 if no directory at the given path exists in the archive.
+ */
+ssize_t list_next(const tar_index_t *index, const char *path, size_t *cursor, tar_dirent_t *entries,
+                  size_t max_entries) {
+    uint32_t next;
+
+    if (path[0] == '\0') {
+        next = index->root_first;
+    } else {
+        const index_entry_t *dir = index_resolve(index, path);
+        if (dir == NULL || dir->type != DIRTYPE) {
+            return -1;
+        }
+        next = dir->first_child;
+    }
+    // Le curseur est l'indice de la prochaine entrée à lister plus un, SIZE_MAX une fois le listing terminé
+    if (*cursor == SIZE_MAX) {
+        return 0;
+    }
+    if (*cursor != 0) {
+        next = *cursor - 1;
+    }
+
+    size_t count = 0;
+    while (count < max_entries && next != NO_ENTRY) {
+        const index_entry_t *child = &index->entries[next];
+        entries[count].path = index->strings + child->path_off;
+        entries[count].type = child->type;
+        entries[count].size = child->size;
+        count++;
+        next = child->next_sibling;
+    }
+    *cursor = next == NO_ENTRY ? SIZE_MAX : (size_t)next + 1;
+    return count;
+}
+
+struct tar_mmap {
+    const uint8_t *base;
+    size_t map_len;
+    tar_index_t *index;
+};
+
+/**
+ * Maps an archive in memory and indexes its entries.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. It must stay open while the handle is used.
+ *
+ * @return a newly allocated handle to be released with tar_close_mmap(),
+ *         NULL if the archive could not be mapped or memory could not be allocated.
+ */
+tar_mmap_t *tar_open_mmap(int tar_fd) {
+    struct stat st;
+    if (fstat(tar_fd, &st) == -1) {
+        return NULL;
+    }
+
+    tar_mmap_t *handle = calloc(1, sizeof(tar_mmap_t));
+    if (handle == NULL) {
+        return NULL;
+    }
+    handle->index = calloc(1, sizeof(tar_index_t));
+    if (handle->index == NULL) {
+        free(handle);
+        return NULL;
+    }
+    handle->index->tar_fd = tar_fd;
+
+    // mmap() refuse une longueur nulle, une archive vide n'a simplement aucune entrée
+    handle->map_len = st.st_size;
+    if (handle->map_len > 0) {
+        void *base = mmap(NULL, handle->map_len, PROT_READ, MAP_SHARED, tar_fd, 0);
+        if (base == MAP_FAILED) {
+            tar_close_mmap(handle);
+            return NULL;
+        }
+        handle->base = base;
+    }
+
+    // L'index est construit directement depuis le mapping, sans aucun appel à read()
+    char path[HEADER_PATH_MAX];
+    tar_entry_t entry;
+    size_t need;
+    uint64_t offset = 0;
+    while (offset < handle->map_len
+           && entry_decode(handle->base + offset, handle->map_len - offset, offset, path, &entry, &need, &offset) == 1
+           && entry.header->name[0] != '\0') {
+        if (index_add_entry(handle->index, &entry) == -1) {
+            tar_close_mmap(handle);
+            return NULL;
+        }
+    }
+    if (index_finish(handle->index) == -1) {
+        tar_close_mmap(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+/**
+ * Unmaps an archive mapped by tar_open_mmap(). Pointers returned by tar_view() are no longer valid afterwards.
+ *
+ * @param handle The handle to release, may be NULL.
+ */
+void tar_close_mmap(tar_mmap_t *handle) {
+    if (handle == NULL) {
+        return;
+    }
+    if (handle->base != NULL) {
+        munmap((void *)handle->base, handle->map_len);
+    }
+    tar_index_close(handle->index);
+    free(handle);
+}
+
+/* Lecteur sur le mapping de l'archive */
+static ssize_t read_at_mmap(void *src, void *dest, size_t len, uint64_t offset) {
+    const tar_mmap_t *handle = src;
+    if (offset >= handle->map_len) {
+        return 0;
+    }
+    if (len > handle->map_len - offset) {
+        len = handle->map_len - offset;
+    }
+    memcpy(dest, handle->base + offset, len);
+    return len;
+}
+
+/**
+ * Gives a direct view on the content of a file of the mapped archive, without copying it.
+ *
+ * @param handle A handle returned by tar_open_mmap().
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param ptr An out argument, set to the first byte of the file inside the mapping.
+ * @param len An out argument, set to the size of the file.
+ *
+ * @return zero on success,
+ *         -1 if no entry at the given path exists in the archive, the entry is not a file or is a sparse file, whose
+ *         holes are not stored in the archive.
+ */
+int tar_view(const tar_mmap_t *handle, const char *path, const uint8_t **ptr, size_t *len) {
+    const index_entry_t *entry = index_resolve(handle->index, path);
+    if (entry == NULL || !is_file_type(entry->type) || entry->sparse != TAR_SPARSE_NONE) {
+        return -1;
+    }
+    // Archive tronquée : les données annoncées dépassent la fin du mapping
+    if (entry->data_off + entry->size > handle->map_len) {
+        return -1;
+    }
+    *ptr = handle->base + entry->data_off;
+    *len = entry->size;
+    return 0;
+}
+
+/**
+ * Reads a file at a given path in the mapped archive, with the same semantics as read_file().
+ *
+ * @param handle A handle returned by tar_open_mmap().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return -1 if no entry at the given path exists in the archive or the entry is not a file,
+ *         -2 if the offset is outside the file total length,
+ *         zero if the file was read in its entirety into the destination buffer,
+ *         a positive value if the file was partially read, representing the remaining bytes left to be read to reach
+ *         the end of the file.
+ */
+ssize_t tar_mmap_read_file(const tar_mmap_t *handle, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    const uint8_t *data;
+    size_t file_size;
+
+    const index_entry_t *entry = index_resolve(handle->index, path);
+    if (entry != NULL && is_file_type(entry->type) && entry->sparse != TAR_SPARSE_NONE) {
+        // Fichier creux : seuls les segments de données sont copiés depuis le mapping
+        if (offset >= entry->size) {
+            *len = 0;
+            return -2;
+        }
+        size_t bytes_to_read = entry->size - offset < *len ? entry->size - offset : *len;
+        ssize_t bytes_read = sparse_pread(read_at_mmap, (void *)handle, entry->sparse, entry->data_off, dest,
+                                          bytes_to_read, offset);
+        if (bytes_read == -1) {
+            *len = 0;
+            return -1;
+        }
+        *len = bytes_read;
+        return entry->size - offset - bytes_read;
+    }
+
+    if (tar_view(handle, path, &data, &file_size) == -1) {
+        *len = 0;
+        return -1;
+    }
+    if (offset >= file_size) {
+        *len = 0;
+        return -2;
+    }
+
+    size_t bytes_to_read = file_size - offset;
+    if (bytes_to_read > *len) {
+        bytes_to_read = *len;
+    }
+    memcpy(dest, data + offset, bytes_to_read);
+    *len = bytes_to_read;
+
+    return file_size - offset - bytes_to_read;
+}
+
+
+/**
+ * Looks up several paths in a single pass over the archive.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param paths The paths to look up, duplicates are allowed.
+ * @param n The number of paths.
+ * @param out An array of n results, out[i] is filled for paths[i].
+ *
+ * @return the number of paths found in the archive,
+ *         -1 if the archive could not be read or memory could not be allocated.
+ */
+ssize_t tar_stat_many(int tar_fd, const char **paths, size_t n, tar_stat_t *out) {
+    size_t n_slots = 16;
+    while (n_slots < n * 2) {
+        n_slots *= 2;
+    }
+    size_t mask = n_slots - 1;
+
+    // slots contient le premier indice de requête (+ 1) pour chaque chemin distinct, les requêtes
+    // identiques sont chaînées par same_path
+    uint32_t *slots = calloc(n_slots, sizeof(uint32_t));
+    uint32_t *hashes = malloc(n * sizeof(uint32_t));
+    size_t *same_path = malloc(n * sizeof(size_t));
+    if (slots == NULL || hashes == NULL || same_path == NULL) {
+        free(slots);
+        free(hashes);
+        free(same_path);
+        return -1;
+    }
+
+    size_t remaining = 0;
+    for (size_t q = 0; q < n; q++) {
+        memset(&out[q], 0, sizeof(tar_stat_t));
+        hashes[q] = path_hash(paths[q], strlen(paths[q]));
+        same_path[q] = SIZE_MAX;
+
+        size_t i = hashes[q] & mask;
+        while (slots[i] != 0 && (hashes[slots[i] - 1] != hashes[q] || strcmp(paths[slots[i] - 1], paths[q]) != 0)) {
+            i = (i + 1) & mask;
+        }
+        if (slots[i] == 0) {
+            slots[i] = q + 1;
+            remaining++;
+        } else {
+            same_path[q] = same_path[slots[i] - 1];
+            same_path[slots[i] - 1] = q;
+        }
+    }
+
+    tar_iter_t it;
+    tar_entry_t entry;
+    ssize_t found = 0;
+    int ret = 0;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        found = -1;
+        goto out;
+    }
+    // On s'arrête dès que tous les chemins demandés ont été trouvés
+    while (remaining > 0 && (ret = iter_next(&it, &entry)) == 1) {
+        uint32_t h = path_hash(entry.path, entry.path_len);
+        size_t i = h & mask;
+        while (slots[i] != 0 && (hashes[slots[i] - 1] != h || strcmp(paths[slots[i] - 1], entry.path) != 0)) {
+            i = (i + 1) & mask;
+        }
+        if (slots[i] == 0 || out[slots[i] - 1].found) {
+            continue;
+        }
+
+        for (size_t q = slots[i] - 1; q != SIZE_MAX; q = same_path[q]) {
+            out[q].found = 1;
+            out[q].type = entry.type;
+            out[q].sparse = entry.sparse;
+            out[q].size = entry.size;
+            out[q].data_offset = entry.data_offset;
+            header_linkname(entry.header, out[q].linkname);
+            found++;
+        }
+        remaining--;
+    }
+    iter_destroy(&it);
+    if (ret == -1) {
+        found = -1;
+    }
+
+out:
+    free(slots);
+    free(hashes);
+    free(same_path);
+    return found;
+}
+
+
+/*
+ * Lectures groupées.
+ *
+ * read_files_v() résout toutes les requêtes en un parcours, plus un par saut de lien, trie les plages à lire par position dans l'archive et
+ * regroupe les plages voisines en un seul preadv(). Les petits trous entre deux plages (en-têtes, bourrage, fichiers
+ * non demandés) sont lus dans un tampon jeté plutôt que de couper le lot.
+ */
+#define READV_MERGE_GAP (64 * 1024)
+#define READV_MAX_IOV 1024
+
+struct readv_range {
+    uint64_t off;         // position dans l'archive
+    size_t len;
+    uint8_t *dest;
+    size_t req;           // indice de la requête
+};
+
+static int readv_range_cmp(const void *a, const void *b) {
+    const struct readv_range *ra = a, *rb = b;
+    if (ra->off != rb->off) {
+        return ra->off < rb->off ? -1 : 1;
+    }
+    return ra->req < rb->req ? -1 : ra->req > rb->req;
+}
+
+/* preadv() jusqu'à avoir tout lu ou atteint la fin du fichier, iov est modifié au passage */
+static ssize_t preadv_full(int fd, struct iovec *iov, int iovcnt, uint64_t offset) {
+    size_t done = 0;
+    while (iovcnt > 0) {
+        ssize_t n = io_preadv(fd, iov, iovcnt, offset + done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return done;
+}
+
+/* Requête en cours de résolution par resolve_many() */
+struct resolve_pending {
+    size_t q;                // indice de la requête
+    char *path;              // chemin normalisé courant
+    size_t len;
+    int hops;
+    size_t first;            // candidats du tour : chemin, variante au '/' final, puis préfixes
+    size_t count;
+};
+
+/**
+ * Résout plusieurs chemins comme resolve_header(), mais par tours : chaque tour cherche en un seul parcours, pour
+ * toutes les requêtes en attente, le chemin normalisé, sa variante avec ou sans '/' final et chacun de ses préfixes,
+ * qui pourrait être un lien. Un chemin absent est donc confirmé dès le premier parcours, et seuls les liens demandent
+ * un tour de plus par saut, partagé par toutes les requêtes.
+ *
+ * @return 0, out[q].found valant 1 si une entrée qui n'est pas un lien a été trouvée pour paths[q],
+ *         -1 si l'archive n'a pas pu être lue ou la mémoire allouée
+ */
+static int resolve_many(int tar_fd, const char **paths, size_t n, tar_stat_t *out) {
+    struct resolve_pending *pending = calloc(n, sizeof(struct resolve_pending));
+    const char **cand_paths = NULL;
+    tar_stat_t *cand_stats = NULL;
+    char *strings = NULL;
+    size_t n_pending = 0;
+    int ret = -1;
+    char cur[RESOLVE_PATH_MAX];
+
+    if (pending == NULL) {
+        return -1;
+    }
+    for (size_t q = 0; q < n; q++) {
+        memset(&out[q], 0, sizeof(tar_stat_t));
+        ssize_t len = normalize_path(paths[q], strlen(paths[q]), cur, sizeof(cur));
+        if (len < 0) {
+            continue;
+        }
+        struct resolve_pending *p = &pending[n_pending];
+        p->q = q;
+        p->len = len;
+        if ((p->path = strdup(cur)) == NULL) {
+            goto out;
+        }
+        n_pending++;
+    }
+
+    while (n_pending > 0) {
+        // Candidats du tour : leur nombre et la place de leurs chaînes, terminateurs compris
+        size_t n_cand = 0, strings_len = 0;
+        for (size_t i = 0; i < n_pending; i++) {
+            struct resolve_pending *p = &pending[i];
+            p->first = n_cand;
+            p->count = p->len > 0 ? 2 : 1;
+            strings_len += 2 * p->len + 3;
+            for (size_t j = 1; j + 1 < p->len; j++) {
+                if (p->path[j] == '/') {
+                    p->count++;
+                    strings_len += j + 1;
+                }
+            }
+            n_cand += p->count;
+        }
+        free(cand_paths);
+        free(cand_stats);
+        free(strings);
+        cand_paths = malloc(n_cand * sizeof(char *));
+        cand_stats = malloc(n_cand * sizeof(tar_stat_t));
+        strings = malloc(strings_len);
+        if (cand_paths == NULL || cand_stats == NULL || strings == NULL) {
+            goto out;
+        }
+
+        char *w = strings;
+        for (size_t i = 0; i < n_pending; i++) {
+            struct resolve_pending *p = &pending[i];
+            size_t c = p->first;
+            cand_paths[c++] = memcpy(w, p->path, p->len + 1);
+            w += p->len + 1;
+            if (p->len > 0) {
+                // Un répertoire est aussi trouvé sans son '/' final, et inversement
+                size_t alt_len = p->path[p->len - 1] == '/' ? p->len - 1 : p->len + 1;
+                memcpy(w, p->path, p->len);
+                w[p->len] = '/';
+                w[alt_len] = '\0';
+                cand_paths[c++] = w;
+                w += alt_len + 1;
+            }
+            for (size_t j = 1; j + 1 < p->len; j++) {
+                if (p->path[j] == '/') {
+                    memcpy(w, p->path, j);
+                    w[j] = '\0';
+                    cand_paths[c++] = w;
+                    w += j + 1;
+                }
+            }
+        }
+        if (tar_stat_many(tar_fd, cand_paths, n_cand, cand_stats) == -1) {
+            goto out;
+        }
+
+        // Comme scan_lookup() : le chemin, sinon sa variante, sinon le plus court préfixe qui est un lien
+        size_t kept = 0;
+        for (size_t i = 0; i < n_pending; i++) {
+            struct resolve_pending *p = &pending[i];
+            const tar_stat_t *st = NULL;
+            size_t c = p->first, prefix_len = 0;
+            if (cand_stats[c].found) {
+                st = &cand_stats[c];
+            } else if (p->count > 1 && cand_stats[c + 1].found) {
+                c++;
+                st = &cand_stats[c];
+            } else {
+                for (c = p->first + 2; c < p->first + p->count; c++) {
+                    if (cand_stats[c].found && is_link(cand_stats[c].type)) {
+                        st = &cand_stats[c];
+                        prefix_len = strlen(cand_paths[c]);
+                        break;
+                    }
+                }
+            }
+
+            ssize_t len = -1;
+            if (st != NULL && !is_link(st->type)) {
+                out[p->q] = *st;
+            } else if (st != NULL && p->hops < MAX_LINK_HOPS) {
+                char target[RESOLVE_PATH_MAX];
+                ssize_t target_len = link_target(cand_paths[c], strlen(cand_paths[c]), st->linkname, st->type,
+                                                 target);
+                if (target_len >= 0 && prefix_len > 0) {
+                    memcpy(cur, p->path, p->len + 1);
+                    len = splice_link(cur, p->len, prefix_len, target, target_len);
+                } else if (target_len >= 0) {
+                    memcpy(cur, target, target_len + 1);
+                    len = target_len;
+                }
+            }
+            if (len < 0) {
+                free(p->path);
+                continue;
+            }
+            // Le lien est suivi au tour suivant
+            char *path = strdup(cur);
+            if (path == NULL) {
+                free(p->path);
+                for (size_t k = i + 1; k < n_pending; k++) {
+                    free(pending[k].path);
+                }
+                n_pending = kept;
+                goto out;
+            }
+            free(p->path);
+            pending[kept++] = (struct resolve_pending){p->q, path, len, p->hops + 1, 0, 0};
+        }
+        n_pending = kept;
+    }
+    ret = 0;
+
+out:
+    for (size_t i = 0; i < n_pending; i++) {
+        free(pending[i].path);
+    }
+    free(pending);
+    free(cand_paths);
+    free(cand_stats);
+    free(strings);
+    return ret;
+}
+
+/**
+ * Reads several files of the archive at once, with the same semantics as read_file() for each of them.
+ *
+ * All the paths are resolved in a single pass over the archive, plus one pass per link hop shared by all the
+ * requests. The ranges to read are then sorted by offset in the archive, and neighbouring ranges are merged so that
+ * they are read with as few preadv() calls as possible.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param reqs An array of n requests. For each one, path, offset, dest and len are set by the caller, and len and
+ *             result are set by the callee as read_file() would set its len argument and return value.
+ * @param n The number of requests.
+ *
+ * @return the number of requests whose result is not negative,
+ *         -1 if the archive could not be read or memory could not be allocated.
+ */
+ssize_t read_files_v(int tar_fd, tar_read_req_t *reqs, size_t n) {
+    // malloc(0) peut retourner NULL : rien à lire, rien à allouer
+    if (n == 0) {
+        return 0;
+    }
+    size_t paths_size, stats_size, ranges_size;
+    if (__builtin_mul_overflow(n, sizeof(char *), &paths_size)
+        || __builtin_mul_overflow(n, sizeof(tar_stat_t), &stats_size)
+        || __builtin_mul_overflow(n, sizeof(struct readv_range), &ranges_size)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    const char **paths = malloc(paths_size);
+    tar_stat_t *stats = malloc(stats_size);
+    struct readv_range *ranges = malloc(ranges_size);
+    struct iovec *iov = malloc(READV_MAX_IOV * sizeof(struct iovec));
+    uint8_t *gap = NULL;
+    size_t n_ranges = 0;
+    ssize_t served = -1;
+
+    if (paths == NULL || stats == NULL || ranges == NULL || iov == NULL) {
+        goto out;
+    }
+    for (size_t q = 0; q < n; q++) {
+        paths[q] = reqs[q].path;
+    }
+    // Liens et chemins à normaliser sont résolus comme par read_file(), par tours communs à toutes les requêtes
+    if (resolve_many(tar_fd, paths, n, stats) == -1) {
+        goto out;
+    }
+
+    for (size_t q = 0; q < n; q++) {
+        tar_read_req_t *req = &reqs[q];
+        size_t capacity = req->len;
+        req->len = 0;
+        req->result = -1;
+
+        tar_stat_t *st = &stats[q];
+        uint64_t size = st->size, data_off = st->data_offset;
+        char sparse = st->sparse;
+        if (!st->found || !is_file_type(st->type)) {
+            continue;
+        }
+
+        if (req->offset >= size) {
+            req->result = -2;
+            continue;
+        }
+        size_t bytes_to_read = size - req->offset < capacity ? size - req->offset : capacity;
+        req->result = size - req->offset - bytes_to_read;
+        if (sparse != TAR_SPARSE_NONE) {
+            // Les segments d'un fichier creux sont lus à part, seuls les trous n'en demandent aucune lecture
+            ssize_t got = sparse_pread(read_at_fd, &tar_fd, sparse, data_off, req->dest, bytes_to_read, req->offset);
+            if (got == -1) {
+                req->result = -1;
+                goto out;
+            }
+            req->len = got;
+            req->result += bytes_to_read - got;
+            continue;
+        }
+        if (bytes_to_read > 0) {
+            ranges[n_ranges++] = (struct readv_range){data_off + req->offset, bytes_to_read, req->dest, q};
+        }
+    }
+
+    qsort(ranges, n_ranges, sizeof(struct readv_range), readv_range_cmp);
+    for (size_t i = 0; i < n_ranges;) {
+        // Lot de plages triées, disjointes et assez proches
+        uint64_t start = ranges[i].off;
+        uint64_t end = start;
+        int iovcnt = 0;
+        size_t j = i;
+        while (j < n_ranges && iovcnt + 2 <= READV_MAX_IOV) {
+            if (j > i) {
+                if (ranges[j].off < end || ranges[j].off - end > READV_MERGE_GAP) {
+                    break;
+                }
+                if (ranges[j].off > end) {
+                    if (gap == NULL && (gap = malloc(READV_MERGE_GAP)) == NULL) {
+                        goto out;
+                    }
+                    iov[iovcnt++] = (struct iovec){gap, ranges[j].off - end};
+                }
+            }
+            iov[iovcnt++] = (struct iovec){ranges[j].dest, ranges[j].len};
+            end = ranges[j].off + ranges[j].len;
+            j++;
+        }
+
+        ssize_t got = preadv_full(tar_fd, iov, iovcnt, start);
+        for (size_t k = i; k < j; k++) {
+            tar_read_req_t *req = &reqs[ranges[k].req];
+            if (got == -1) {
+                req->result = -1;
+                continue;
+            }
+            // Archive tronquée : seul le début du lot a pu être lu
+            uint64_t avail = (uint64_t)got > ranges[k].off - start ? got - (ranges[k].off - start) : 0;
+            req->len = avail < ranges[k].len ? avail : ranges[k].len;
+            req->result += ranges[k].len - req->len;
+        }
+        if (got == -1) {
+            goto out;
+        }
+        i = j;
+    }
+
+    served = 0;
+    for (size_t q = 0; q < n; q++) {
+        served += reqs[q].result >= 0;
+    }
+
+out:
+    free(paths);
+    free(stats);
+    free(ranges);
+    free(iov);
+    free(gap);
+    return served;
+}
+
+
+struct tar_file {
+    int tar_fd;
+    uint64_t data_off;
+    uint64_t size;
+    uint64_t pos;
+    int sparse;
+    struct sparse_map map;   // segments d'un fichier creux, chargés à l'ouverture
+};
+
+/**
+ * Opens a file of the archive for reading.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. It must stay open while the file is used.
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ *
+ * @return a newly allocated file to be released with tar_fclose(),
+ *         NULL if no entry at the given path exists in the archive, the entry is not a file or memory could not be
+ *         allocated.
+ */
+tar_file_t *tar_fopen(int tar_fd, const char *path) {
+    tar_iter_t it;
+    tar_entry_t entry;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return NULL;
+    }
+    int found = resolve_header(&it, path, &entry);
+    iter_destroy(&it);
+    if (found != 1 || !is_file_type(entry.type)) {
+        return NULL;
+    }
+
+    tar_file_t *file = malloc(sizeof(tar_file_t));
+    if (file == NULL) {
+        return NULL;
+    }
+    file->tar_fd = tar_fd;
+    file->data_off = entry.data_offset;
+    file->size = entry.size;
+    file->pos = 0;
+    file->sparse = entry.sparse != TAR_SPARSE_NONE;
+    memset(&file->map, 0, sizeof(file->map));
+    if (file->sparse && sparse_load(read_at_fd, &file->tar_fd, entry.sparse, entry.data_offset, &file->map) == -1) {
+        free(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * Reads from a given position of a file, without using nor modifying its current position.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param buf A destination buffer.
+ * @param len The size of buf.
+ * @param offset The position in the file to read from.
+ *
+ * @return the number of bytes read, zero if offset is at or after the end of the file,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_pread(const tar_file_t *file, void *buf, size_t len, off_t offset) {
+    if (offset < 0) {
+        return -1;
+    }
+    if ((uint64_t)offset >= file->size) {
+        return 0;
+    }
+    if (len > file->size - offset) {
+        len = file->size - offset;  // Ne pas lire au-delà de la fin du fichier
+    }
+    if (file->sparse) {
+        int tar_fd = file->tar_fd;
+        return sparse_read(&file->map, read_at_fd, &tar_fd, buf, len, offset);
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = io_pread(file->tar_fd, (uint8_t *)buf + done, len - done, file->data_off + offset + done);
+        if (n == -1) {
+            return -1;
+        }
+        if (n == 0) {
+            break;  // Archive tronquée
+        }
+        done += n;
+    }
+    return done;
+}
+
+/**
+ * Reads from the current position of a file and advances the position by the number of bytes read.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param buf A destination buffer.
+ * @param len The size of buf.
+ *
+ * @return the number of bytes read, zero at the end of the file,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_fread(tar_file_t *file, void *buf, size_t len) {
+    ssize_t n = tar_pread(file, buf, len, file->pos);
+    if (n > 0) {
+        file->pos += n;
+    }
+    return n;
+}
+
+/**
+ * Moves the current position of a file, as lseek() does.
+ *
+ * SEEK_DATA and SEEK_HOLE move to the start of the next data segment or hole at or after offset, so that the holes
+ * of a sparse file can be recreated instead of written. A file that is not sparse has a single data segment, followed
+ * by the implicit hole at its end.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param offset The offset to move to, relative to whence.
+ * @param whence SEEK_SET, SEEK_CUR, SEEK_END, SEEK_DATA or SEEK_HOLE (the latter two need _GNU_SOURCE).
+ *
+ * @return the new position from the start of the file,
+ *         -1 if whence is invalid or the new position would be negative, or with SEEK_DATA and SEEK_HOLE if offset
+ *         is at or after the end of the file or no data follows it.
+ */
+off_t tar_fseek(tar_file_t *file, off_t offset, int whence) {
+    off_t base;
+
+    if (whence == SEEK_DATA || whence == SEEK_HOLE) {
+        if (offset < 0 || (uint64_t)offset >= file->size) {
+            return -1;
+        }
+        uint64_t pos = offset;
+        if (file->sparse) {
+            const struct sparse_map *map = &file->map;
+            size_t i = sparse_find(map, pos);
+            while (i < map->n && map->segs[i].size == 0) {
+                i++;
+            }
+            if (whence == SEEK_DATA) {
+                if (i == map->n || map->segs[i].offset >= file->size) {
+                    return -1;
+                }
+                if (map->segs[i].offset > pos) {
+                    pos = map->segs[i].offset;
+                }
+            } else if (i < map->n && map->segs[i].offset <= pos) {
+                // Le trou commence après ce segment et ceux qui lui sont accolés
+                pos = map->segs[i].offset + map->segs[i].size;
+                while (++i < map->n && map->segs[i].offset == pos) {
+                    pos += map->segs[i].size;
+                }
+            }
+        } else if (whence == SEEK_HOLE) {
+            pos = file->size;
+        }
+        file->pos = pos < file->size ? pos : file->size;
+        return file->pos;
+    }
+
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = file->pos;
+            break;
+        case SEEK_END:
+            base = file->size;
+            break;
+        default:
+            return -1;
+    }
+    if (base + offset < 0) {
+        return -1;
+    }
+    file->pos = base + offset;
+    return file->pos;
+}
+
+/**
+ * Gives the size of a file opened by tar_fopen().
+ *
+ * @param file A file opened by tar_fopen().
+ *
+ * @return the size of the file in bytes.
+ */
+uint64_t tar_fsize(const tar_file_t *file) {
+    return file->size;
+}
+
+/**
+ * Closes a file opened by tar_fopen().
+ *
+ * @param file The file to close, may be NULL.
+ */
+void tar_fclose(tar_file_t *file) {
+    if (file != NULL) {
+        free(file->map.segs);
+    }
+    free(file);
+}
+
+
+static ssize_t index_read_file(const tar_index_t *index, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    const index_entry_t *entry = index_resolve(index, path);
+    if (entry == NULL || !is_file_type(entry->type)) {
+        *len = 0;
+        return -1;
+    }
+    if (offset >= entry->size) {
+        *len = 0;
+        return -2;
+    }
+
+    size_t bytes_to_read = entry->size - offset;
+    if (bytes_to_read > *len) {
+        bytes_to_read = *len;
+    }
+    int tar_fd = index->tar_fd;
+    read_at_t read_at = index->cache != NULL ? read_at_cache : read_at_fd;
+    void *src = index->cache != NULL ? (void *)index->cache : &tar_fd;
+    ssize_t bytes_read = entry->sparse != TAR_SPARSE_NONE
+                         ? sparse_pread(read_at, src, entry->sparse, entry->data_off, dest, bytes_to_read, offset)
+                         : read_at(src, dest, bytes_to_read, entry->data_off + offset);
+    if (bytes_read == -1) {
+        *len = 0;
+        return -1;
+    }
+    *len = bytes_read;
+    return entry->size - offset - bytes_read;
+}
+
+/**
+ * Reads a file at a given path in the indexed archive, with the same semantics as read_file().
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_index_read_file(const tar_index_t *index, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    struct probe probe;
+    probe_begin(&probe, TAR_FN_INDEX_READ_FILE);
+    ssize_t ret = index_read_file(index, path, offset, dest, len);
+    probe_end(&probe, path, &((tar_index_t *)index)->stats);
+    return ret;
+}
+
+/**
+ * Copies the counters of an index: the activity of all the calls made on it, by any thread.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param out An out argument, set to the counters of the index.
+ */
+void tar_index_stats(const tar_index_t *index, tar_stats_t *out) {
+    const uint64_t *src = (const uint64_t *)&index->stats;
+    uint64_t *dest = (uint64_t *)out;
+    for (size_t i = 0; i < sizeof(tar_stats_t) / sizeof(uint64_t); i++) {
+        dest[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Sets the counters of an index to zero.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ */
+void tar_index_stats_reset(tar_index_t *index) {
+    uint64_t *counters = (uint64_t *)&index->stats;
+    for (size_t i = 0; i < sizeof(tar_stats_t) / sizeof(uint64_t); i++) {
+        __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Enables a cache of the data read by tar_index_read_file(), so that repeated reads of the same parts of the archive
+ * are served from memory without any system call. The cache holds fixed-size extents of the archive and evicts the
+ * least recently used ones (CLOCK approximation) once its budget is reached. It is split in shards with their own
+ * lock, so that concurrent readers rarely contend.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load(), with no read in progress.
+ * @param budget The maximum memory used by cached data, in bytes, zero selects TAR_CACHE_DEFAULT_BUDGET.
+ * @param extent_size The size of the cached extents, zero selects TAR_CACHE_DEFAULT_EXTENT.
+ *
+ * @return zero on success,
+ *         -1 if memory could not be allocated.
+ */
+int tar_index_cache_enable(tar_index_t *index, size_t budget, size_t extent_size) {
+    struct extent_cache *cache = cache_create(index->tar_fd, budget ? budget : TAR_CACHE_DEFAULT_BUDGET,
+                                              extent_size ? extent_size : TAR_CACHE_DEFAULT_EXTENT);
+    if (cache == NULL) {
+        return -1;
+    }
+    cache_destroy(index->cache);
+    index->cache = cache;
+    return 0;
+}
+
+/**
+ * Disables and frees the cache of an index, see tar_index_cache_enable().
+ *
+ * @param index An index with no read in progress.
+ */
+void tar_index_cache_disable(tar_index_t *index) {
+    cache_destroy(index->cache);
+    index->cache = NULL;
+}
+
+/**
+ * Gives the counters of the cache of an index.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param stats An out argument, set to the counters, or to zeros if the cache is not enabled.
+ */
+void tar_index_cache_stats(const tar_index_t *index, tar_cache_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    struct extent_cache *cache = index->cache;
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        struct cache_shard *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        for (uint32_t j = 0; j < shard->n_slots; j++) {
+            stats->cached_bytes += shard->slots[j].data != NULL ? cache->extent_size : 0;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/*
+ * Index persistant.
+ *
+ * Le fichier reprend tel quel la représentation en mémoire de l'index (entrées triées par chemin, table de hachage,
+ * arène des chaînes), si bien que tar_index_load() n'a qu'à le projeter en mémoire. Il n'est valable que sur une
+ * machine de même architecture, ce que vérifient le magic et la taille des entrées, et pour une archive inchangée :
+ * taille, date de modification et empreinte du premier et du dernier en-tête.
+ */
+#define SIDECAR_MAGIC "TARIDX\0\1"
+
+struct sidecar_header {
+    char magic[8];
+    uint32_t entry_size;
+    uint32_t root_first;
+    uint64_t archive_size;
+    int64_t archive_mtime_sec;
+    int64_t archive_mtime_nsec;
+    uint64_t header_hash;
+    uint64_t n_entries;
+    uint64_t n_slots;
+    uint64_t strings_len;
+    uint64_t entries_off;
+    uint64_t slots_off;
+    uint64_t strings_off;
+};
+
+/* FNV-1a 64 bits du premier en-tête et de celui de la dernière entrée indexée */
+static int sidecar_header_hash(const tar_index_t *index, uint64_t *hash) {
+    uint8_t block[BLOCK_SIZE];
+    uint64_t offsets[2] = {0, 0};
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t i = 0; i < index->n_entries; i++) {
+        if (index->entries[i].data_off - BLOCK_SIZE > offsets[1]) {
+            offsets[1] = index->entries[i].data_off - BLOCK_SIZE;
+        }
+    }
+    for (int k = 0; k < (index->n_entries > 0 ? 2 : 0); k++) {
+        if (io_pread(index->tar_fd, block, BLOCK_SIZE, offsets[k]) != BLOCK_SIZE) {
+            return -1;
+        }
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            h ^= block[i];
+            h *= 1099511628211ull;
+        }
+    }
+    *hash = h;
+    return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static uint64_t align8(uint64_t x) {
+    return (x + 7) & ~(uint64_t)7;
+}
+
+/**
+ * Écrit l'index (en-tête puis tableaux) à la position courante de fd. Les champs d'identification de l'archive de hdr
+ * sont remplis par l'appelant, les offsets sont relatifs au début de l'en-tête, qui doit être aligné sur 8 octets.
+ */
+static int index_write_blob(int fd, const tar_index_t *index, struct sidecar_header *hdr) {
+    static const uint8_t zeros[8] = {0};
+
+    memcpy(hdr->magic, SIDECAR_MAGIC, sizeof(hdr->magic));
+    hdr->entry_size = sizeof(index_entry_t);
+    hdr->root_first = index->root_first;
+    hdr->n_entries = index->n_entries;
+    hdr->n_slots = index->n_slots;
+    hdr->strings_len = index->strings_len;
+    hdr->entries_off = align8(sizeof(*hdr));
+    hdr->slots_off = align8(hdr->entries_off + hdr->n_entries * sizeof(index_entry_t));
+    hdr->strings_off = align8(hdr->slots_off + hdr->n_slots * sizeof(uint32_t));
+
+    if (write_all(fd, hdr, sizeof(*hdr)) == -1
+        || write_all(fd, zeros, hdr->entries_off - sizeof(*hdr)) == -1
+        || write_all(fd, index->entries, hdr->n_entries * sizeof(index_entry_t)) == -1
+        || write_all(fd, zeros, hdr->slots_off - hdr->entries_off - hdr->n_entries * sizeof(index_entry_t)) == -1
+        || write_all(fd, index->slots, hdr->n_slots * sizeof(uint32_t)) == -1
+        || write_all(fd, zeros, hdr->strings_off - hdr->slots_off - hdr->n_slots * sizeof(uint32_t)) == -1
+        || write_all(fd, index->strings, hdr->strings_len) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+/* La chaîne à l'offset off de l'arène de l'index est-elle terminée avant la fin de l'arène ? */
+static int index_string_valid(const tar_index_t *index, uint64_t off) {
+    return off < index->strings_len && memchr(index->strings + off, '\0', index->strings_len - off) != NULL;
+}
+
+/*
+ * Vérifie chaque entrée et chaque case de la table de hachage d'un index chargé : chaînes dans l'arène et terminées,
+ * indices d'entrées dans le tableau, et au moins une case vide pour que les recherches s'arrêtent.
+ *
+ * @return 0 si l'index est cohérent, -1 sinon
+ */
+static int index_check_blob(const tar_index_t *index) {
+    for (size_t i = 0; i < index->n_entries; i++) {
+        const index_entry_t *entry = &index->entries[i];
+        uint64_t path_end = (uint64_t)entry->path_off + entry->path_len;
+        if (path_end >= index->strings_len || index->strings[path_end] != '\0'
+            || !index_string_valid(index, entry->link_off)
+            || (entry->first_child != NO_ENTRY && entry->first_child >= index->n_entries)
+            || (entry->next_sibling != NO_ENTRY && entry->next_sibling >= index->n_entries)
+            || (entry->resolved != NO_ENTRY && entry->resolved != BROKEN_LINK
+                && entry->resolved >= index->n_entries)) {
+            return -1;
+        }
+    }
+    size_t empty = 0;
+    for (size_t i = 0; i < index->n_slots; i++) {
+        if (index->slots[i] > index->n_entries) {
+            return -1;
+        }
+        empty += index->slots[i] == 0;
+    }
+    return empty > 0 ? 0 : -1;
+}
+
+/**
+ * Crée un index dont les tableaux pointent dans un bloc écrit par index_write_blob() et projeté en mémoire. Le bloc
+ * n'appartient pas à l'index.
+ *
+ * @return l'index, NULL si le bloc est corrompu (errno vaut alors EINVAL) ou en cas d'erreur d'allocation
+ */
+static tar_index_t *index_map_blob(uint8_t *blob, size_t blob_len, struct sidecar_header *hdr) {
+    if (blob_len < sizeof(*hdr)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    memcpy(hdr, blob, sizeof(*hdr));
+    // Les tailles et les offsets sont vérifiés sans débordement, et les tableaux doivent être alignés
+    uint64_t entries_len, slots_len, entries_end, slots_end, strings_end;
+    int valid = memcmp(hdr->magic, SIDECAR_MAGIC, sizeof(hdr->magic)) == 0
+                && hdr->entry_size == sizeof(index_entry_t)
+                && hdr->n_entries < BROKEN_LINK
+                && (hdr->n_slots & (hdr->n_slots - 1)) == 0 && hdr->n_slots > hdr->n_entries
+                && hdr->strings_len <= UINT32_MAX
+                && !__builtin_mul_overflow(hdr->n_entries, sizeof(index_entry_t), &entries_len)
+                && !__builtin_mul_overflow(hdr->n_slots, sizeof(uint32_t), &slots_len)
+                && !__builtin_add_overflow(hdr->entries_off, entries_len, &entries_end)
+                && !__builtin_add_overflow(hdr->slots_off, slots_len, &slots_end)
+                && !__builtin_add_overflow(hdr->strings_off, hdr->strings_len, &strings_end)
+                && hdr->entries_off >= sizeof(*hdr) && entries_end <= hdr->slots_off
+                && slots_end <= hdr->strings_off && strings_end <= blob_len
+                && (uintptr_t)(blob + hdr->entries_off) % _Alignof(index_entry_t) == 0
+                && (uintptr_t)(blob + hdr->slots_off) % _Alignof(uint32_t) == 0
+                && (hdr->root_first == NO_ENTRY || hdr->root_first < hdr->n_entries);
+    if (!valid) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    tar_index_t *index = calloc(1, sizeof(tar_index_t));
+    if (index == NULL) {
+        return NULL;
+    }
+    index->external = 1;
+    index->tar_fd = -1;
+    index->entries = (index_entry_t *)(blob + hdr->entries_off);
+    index->n_entries = hdr->n_entries;
+    index->slots = (uint32_t *)(blob + hdr->slots_off);
+    index->n_slots = hdr->n_slots;
+    index->strings = (char *)blob + hdr->strings_off;
+    index->strings_len = hdr->strings_len;
+    index->root_first = hdr->root_first;
+    if (index_check_blob(index) == -1) {
+        free(index);
+        errno = EINVAL;
+        return NULL;
+    }
+    return index;
+}
+
+/* Ouvre path.tmp en écriture, le fichier sera renommé en path par commit_tmp() */
+static int create_tmp(const char *path, char **tmp_path) {
+    size_t tmp_len = strlen(path) + 5;
+    *tmp_path = malloc(tmp_len);
+    if (*tmp_path == NULL) {
+        return -1;
+    }
+    snprintf(*tmp_path, tmp_len, "%s.tmp", path);
+    int fd = open(*tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        free(*tmp_path);
+    }
+    return fd;
+}
+
+/* Ferme le fichier temporaire et le renomme si ret vaut zéro, le supprime sinon : un lecteur ne voit jamais de
+ * fichier à moitié écrit */
+static int commit_tmp(int fd, char *tmp_path, const char *path, int ret) {
+    if (close(fd) == -1) {
+        ret = -1;
+    }
+    if (ret == 0 && rename(tmp_path, path) == -1) {
+        ret = -1;
+    }
+    if (ret == -1) {
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return ret;
+}
+
+/* Projette un fichier en mémoire, en copie privée modifiable : le cache de résolution des liens écrit dans les entrées */
+static void *map_file(const char *path, size_t *len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *len = st.st_size;
+    return map;
+}
+
+/**
+ * Saves an index next to its archive, so that later processes can load it with tar_index_load() instead of scanning
+ * the archive.
+ *
+ * @param index An index built by tar_index_open() or tar_index_load().
+ * @param sidecar_path The path of the index file to write, e.g. "archive.tar.tidx". It is replaced atomically.
+ *
+ * @return zero on success,
+ *         -1 if the archive could not be read or the index file could not be written.
+ */
+int tar_index_save(const tar_index_t *index, const char *sidecar_path) {
+    struct stat st;
+    struct sidecar_header hdr;
+    char *tmp_path;
+
+    if (fstat(index->tar_fd, &st) == -1) {
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.archive_size = st.st_size;
+    hdr.archive_mtime_sec = st.st_mtim.tv_sec;
+    hdr.archive_mtime_nsec = st.st_mtim.tv_nsec;
+    if (sidecar_header_hash(index, &hdr.header_hash) == -1) {
+        return -1;
+    }
+
+    int fd = create_tmp(sidecar_path, &tmp_path);
+    if (fd == -1) {
+        return -1;
+    }
+    return commit_tmp(fd, tmp_path, sidecar_path, index_write_blob(fd, index, &hdr));
+}
+
+/**
+ * Loads an index saved by tar_index_save(). The index file is mapped in memory and used as is: no scan of the archive
+ * is needed, lookups are served right away.
+ *
+ * @param sidecar_path The path of the index file.
+ * @param tar_fd A file descriptor pointing to the archive the index was saved for.
+ *
+ * @return a newly allocated index to be released with tar_index_close(),
+ *         NULL if the index file could not be read, is corrupted, or is stale because the archive changed since it
+ *         was saved (errno is then set to ESTALE).
+ */
+tar_index_t *tar_index_load(const char *sidecar_path, int tar_fd) {
+    struct stat tar_st;
+    struct sidecar_header hdr;
+    size_t map_len;
+
+    if (fstat(tar_fd, &tar_st) == -1) {
+        return NULL;
+    }
+    void *map = map_file(sidecar_path, &map_len);
+    if (map == NULL) {
+        return NULL;
+    }
+    tar_index_t *index = index_map_blob(map, map_len, &hdr);
+    if (index == NULL) {
+        munmap(map, map_len);
+        return NULL;
+    }
+    index->map = map;
+    index->map_len = map_len;
+    index->tar_fd = tar_fd;
+
+    uint64_t hash;
+    if ((uint64_t)tar_st.st_size != hdr.archive_size || tar_st.st_mtim.tv_sec != hdr.archive_mtime_sec
+        || tar_st.st_mtim.tv_nsec != hdr.archive_mtime_nsec
+        || sidecar_header_hash(index, &hash) == -1 || hash != hdr.header_hash) {
+        tar_index_close(index);
+        errno = ESTALE;
+        return NULL;
+    }
+    return index;
+}
+
+
+/*
+ * Archives compressées avec gzip.
+ *
+ * tar_gz_open() décompresse l'archive une seule fois. Pendant ce passage, il note un point de reprise environ tous les
+ * span octets de données décompressées, à une frontière de bloc deflate : la position dans le flux compressé (à
+ * l'octet et au bit près) et les 32 Kio de données qui précèdent, dont le bloc suivant peut dépendre. Les en-têtes
+ * tar qui passent sont validés comme par check_archive() et ajoutés à un index.
+ *
+ * Une lecture à un offset donné des données décompressées repart ensuite du dernier point de reprise qui le précède,
+ * ou de la position courante du décompresseur si elle est plus proche, au lieu de tout décompresser depuis le début.
+ */
+#define GZ_WINDOW 32768
+#define GZ_CHUNK (64 * 1024)
+#define GZ_MAGIC "TARGZX\0\1"
+
+struct gz_point {
+    uint64_t out;        // offset dans les données décompressées
+    uint64_t in;         // offset dans le fichier compressé du premier octet entier du bloc
+    int bits;            // nombre de bits du bloc dans l'octet qui précède in
+    uint32_t window;     // indice de la fenêtre de 32 Kio dans windows
+};
+
+struct tar_gz {
+    int gz_fd;
+    size_t span;
+    struct gz_point *points;
+    size_t n_points;
+    size_t cap_points;
+    uint8_t *windows;          // n_points fenêtres de GZ_WINDOW octets
+    uint64_t total_out;        // taille des données décompressées
+    int check;                 // résultat de check_archive() sur les données décompressées
+    tar_index_t *index;
+    void *map;                 // fichier projeté par tar_gz_load()
+    size_t map_len;
+
+    // Décompresseur courant, réutilisé par les lectures qui avancent dans l'archive
+    z_stream strm;
+    int strm_live;
+    int strm_raw;              // flux deflate brut (repris depuis un point) ou gzip
+    uint64_t strm_out;         // offset des prochaines données décompressées
+    uint64_t in_off;           // offset du prochain octet à lire dans le fichier compressé
+    uint8_t in_buf[GZ_CHUNK];
+};
+
+/* Parcours des en-têtes tar dans les données décompressées, qui arrivent par morceaux */
+struct gz_walker {
+    uint64_t next;             // offset du prochain en-tête
+    uint8_t *buf;              // en-têtes de l'entrée courante déjà reçus
+    size_t cap;
+    size_t have;
+    size_t need;               // octets nécessaires pour décoder l'entrée, voir entry_decode()
+    int done;
+    int count;
+    int check;
+    tar_index_t *index;
+};
+
+static int gz_walk(struct gz_walker *w, const uint8_t *data, size_t n, uint64_t pos) {
+    char path[HEADER_PATH_MAX];
+    tar_entry_t entry;
+
+    while (n > 0 && !w->done) {
+        if (pos < w->next) {
+            size_t skip = w->next - pos < n ? w->next - pos : n;
+            data += skip;
+            pos += skip;
+            n -= skip;
+            continue;
+        }
+        if (w->need > w->cap) {
+            uint8_t *buf = realloc(w->buf, w->need);
+            if (buf == NULL) {
+                return -1;
+            }
+            w->buf = buf;
+            w->cap = w->need;
+        }
+        size_t take = w->need - w->have < n ? w->need - w->have : n;
+        memcpy(w->buf + w->have, data, take);
+        w->have += take;
+        data += take;
+        pos += take;
+        n -= take;
+        if (w->have < w->need) {
+            break;
+        }
+
+        // Une entrée à plusieurs en-têtes demande d'en recevoir davantage avant de pouvoir la décoder
+        uint64_t next;
+        if (entry_decode(w->buf, w->have, w->next, path, &entry, &w->need, &next) == 0) {
+            continue;
+        }
+        w->have = 0;
+        w->need = BLOCK_SIZE;
+        if (entry.header->name[0] == '\0') {
+            w->done = 1;
+            break;
+        }
+        // Comme check_archive(), on s'arrête au premier en-tête invalide
+        int ret = entry.pax_blocks != 0 ? validate_header(entry_pax_header(&entry)) : 0;
+        if (ret == 0) {
+            w->count += entry.pax_blocks != 0;
+            ret = validate_header(entry.header);
+        }
+        if (ret != 0) {
+            w->check = ret;
+            w->done = 1;
+            break;
+        }
+        if (index_add_entry(w->index, &entry) == -1) {
+            return -1;
+        }
+        w->count++;
+        w->next = next;
+    }
+    return 0;
+}
+
+static int gz_add_point(tar_gz_t *gz, uint64_t in, int bits, uint64_t out, const uint8_t *window, size_t win_pos) {
+    if (gz->n_points == gz->cap_points) {
+        size_t cap = gz->cap_points ? gz->cap_points * 2 : 8;
+        struct gz_point *points = realloc(gz->points, cap * sizeof(struct gz_point));
+        if (points == NULL) {
+            return -1;
+        }
+        gz->points = points;
+        uint8_t *windows = realloc(gz->windows, cap * GZ_WINDOW);
+        if (windows == NULL) {
+            return -1;
+        }
+        gz->windows = windows;
+        gz->cap_points = cap;
+    }
+    struct gz_point *point = &gz->points[gz->n_points];
+    point->out = out;
+    point->in = in;
+    point->bits = bits;
+    point->window = gz->n_points;
+
+    // La fenêtre est circulaire : on la remet dans l'ordre, les octets les plus anciens en premier
+    uint8_t *dest = gz->windows + (size_t)point->window * GZ_WINDOW;
+    memcpy(dest, window + win_pos, GZ_WINDOW - win_pos);
+    memcpy(dest + GZ_WINDOW - win_pos, window, win_pos);
+    gz->n_points++;
+    return 0;
+}
+
+/* Décompresse toute l'archive une fois pour placer les points de reprise et indexer les en-têtes */
+static int gz_build(tar_gz_t *gz) {
+    z_stream strm;
+    uint8_t *window = calloc(1, GZ_WINDOW);
+    uint8_t *input = malloc(GZ_CHUNK);
+    struct gz_walker walker = {0};
+    uint64_t in_off = 0, last = 0;
+    int ret = Z_OK;
+
+    walker.index = gz->index;
+    walker.need = BLOCK_SIZE;
+    if (window == NULL || input == NULL) {
+        free(window);
+        free(input);
+        return -1;
+    }
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK) {  // 47 : en-tête gzip ou zlib détecté automatiquement
+        free(window);
+        free(input);
+        return -1;
+    }
+
+    gz->total_out = 0;
+    strm.avail_out = 0;
+    do {
+        ssize_t n = io_pread(gz->gz_fd, input, GZ_CHUNK, in_off);
+        if (n <= 0) {
+            ret = n == 0 ? Z_DATA_ERROR : Z_ERRNO;
+            break;
+        }
+        in_off += n;
+        strm.next_in = input;
+        strm.avail_in = n;
+
+        do {
+            if (strm.avail_out == 0) {
+                strm.avail_out = GZ_WINDOW;
+                strm.next_out = window;
+            }
+            uint8_t *produced = strm.next_out;
+            uint64_t before = gz->total_out;
+
+            ret = inflate(&strm, Z_BLOCK);
+            size_t out_n = strm.next_out - produced;
+            gz->total_out += out_n;
+            if (ret == Z_NEED_DICT || ret == Z_MEM_ERROR || ret == Z_DATA_ERROR || ret == Z_STREAM_ERROR) {
+                break;
+            }
+            if (gz_walk(&walker, produced, out_n, before) == -1) {
+                ret = Z_MEM_ERROR;
+                break;
+            }
+
+            // Fin d'un bloc deflate qui n'est pas le dernier : point de reprise possible
+            if ((strm.data_type & 128) && !(strm.data_type & 64)
+                && (gz->total_out == 0 || gz->total_out - last >= gz->span || gz->n_points == 0)) {
+                if (gz_add_point(gz, in_off - strm.avail_in, strm.data_type & 7, gz->total_out, window,
+                                 GZ_WINDOW - strm.avail_out) == -1) {
+                    ret = Z_MEM_ERROR;
+                    break;
+                }
+                last = gz->total_out;
+            }
+
+            // Membre gzip suivant éventuel, concaténé au précédent
+            if (ret == Z_STREAM_END && strm.avail_in > 0) {
+                inflateReset(&strm);
+                ret = Z_OK;
+            }
+        } while (strm.avail_in != 0 && ret != Z_STREAM_END);
+
+        if (ret == Z_STREAM_END) {
+            // Vérifie s'il reste un membre gzip après la fin de celui-ci
+            uint8_t probe;
+            if (io_pread(gz->gz_fd, &probe, 1, in_off) == 1) {
+                inflateReset(&strm);
+                ret = Z_OK;
+            }
+        }
+    } while (ret != Z_STREAM_END);
+
+    inflateEnd(&strm);
+    free(window);
+    free(input);
+    free(walker.buf);
+    gz->check = walker.check != 0 ? walker.check : walker.count;
+    return ret == Z_STREAM_END ? 0 : -1;
+}
+
+static void gz_strm_end(tar_gz_t *gz) {
+    if (gz->strm_live) {
+        inflateEnd(&gz->strm);
+        gz->strm_live = 0;
+    }
+}
+
+/* Positionne le décompresseur sur un point de reprise */
+static int gz_strm_seek(tar_gz_t *gz, const struct gz_point *point) {
+    gz_strm_end(gz);
+    memset(&gz->strm, 0, sizeof(gz->strm));
+    if (inflateInit2(&gz->strm, -15) != Z_OK) {
+        return -1;
+    }
+    gz->strm_live = 1;
+    gz->strm_raw = 1;
+    gz->in_off = point->in;
+    if (point->bits) {
+        uint8_t byte;
+        if (io_pread(gz->gz_fd, &byte, 1, point->in - 1) != 1) {
+            return -1;
+        }
+        inflatePrime(&gz->strm, point->bits, byte >> (8 - point->bits));
+    }
+    inflateSetDictionary(&gz->strm, gz->windows + (size_t)point->window * GZ_WINDOW, GZ_WINDOW);
+    gz->strm_out = point->out;
+    return 0;
+}
+
+/* Fournit au décompresseur la suite du fichier compressé, retourne le nombre d'octets disponibles */
+static ssize_t gz_strm_fill(tar_gz_t *gz) {
+    if (gz->strm.avail_in == 0) {
+        ssize_t n = io_pread(gz->gz_fd, gz->in_buf, GZ_CHUNK, gz->in_off);
+        if (n <= 0) {
+            return n;
+        }
+        gz->in_off += n;
+        gz->strm.next_in = gz->in_buf;
+        gz->strm.avail_in = n;
+    }
+    return gz->strm.avail_in;
+}
+
+/* Décompresse jusqu'à len octets dans dest, retourne le nombre d'octets produits ou -1 */
+static ssize_t gz_strm_inflate(tar_gz_t *gz, uint8_t *dest, size_t len) {
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t avail = gz_strm_fill(gz);
+        if (avail <= 0) {
+            return avail == 0 ? (ssize_t)done : -1;
+        }
+        gz->strm.next_out = dest + done;
+        gz->strm.avail_out = len - done;
+        int ret = inflate(&gz->strm, Z_NO_FLUSH);
+        size_t produced = (len - done) - gz->strm.avail_out;
+        done += produced;
+        gz->strm_out += produced;
+
+        if (ret == Z_STREAM_END) {
+            // Fin d'un membre : le flux brut s'arrête avant les 8 octets de fin gzip, qu'on saute pour
+            // enchaîner sur le membre suivant en mode gzip
+            if (gz->strm_raw) {
+                size_t trailer = 8;
+                while (trailer > 0) {
+                    if (gz_strm_fill(gz) <= 0) {
+                        return done;
+                    }
+                    size_t skip = trailer < gz->strm.avail_in ? trailer : gz->strm.avail_in;
+                    gz->strm.next_in += skip;
+                    gz->strm.avail_in -= skip;
+                    trailer -= skip;
+                }
+                gz->strm_raw = 0;
+                inflateReset2(&gz->strm, 31);
+            } else {
+                inflateReset(&gz->strm);
+            }
+            if (gz_strm_fill(gz) <= 0) {
+                return done;
+            }
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    return done;
+}
+
+/**
+ * Lit len octets des données décompressées à partir de offset.
+ *
+ * @return le nombre d'octets lus, -1 en cas d'erreur
+ */
+static ssize_t gz_read_at(tar_gz_t *gz, uint8_t *dest, size_t len, uint64_t offset) {
+    if (offset >= gz->total_out) {
+        return 0;
+    }
+    if (len > gz->total_out - offset) {
+        len = gz->total_out - offset;
+    }
+
+    // Dernier point de reprise avant offset, par recherche dichotomique
+    size_t lo = 0, hi = gz->n_points;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (gz->points[mid].out <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const struct gz_point *point = &gz->points[lo];
+    if (!gz->strm_live || gz->strm_out > offset || gz->strm_out < point->out) {
+        if (gz_strm_seek(gz, point) == -1) {
+            gz_strm_end(gz);
+            return -1;
+        }
+    }
+
+    uint8_t discard[GZ_CHUNK];
+    while (gz->strm_out < offset) {
+        size_t skip = offset - gz->strm_out < sizeof(discard) ? offset - gz->strm_out : sizeof(discard);
+        ssize_t n = gz_strm_inflate(gz, discard, skip);
+        if (n <= 0) {
+            gz_strm_end(gz);
+            return -1;
+        }
+    }
+    ssize_t n = gz_strm_inflate(gz, dest, len);
+    if (n == -1) {
+        gz_strm_end(gz);
+    }
+    return n;
+}
+
+/* Lecteur sur les données décompressées */
+static ssize_t read_at_gz(void *src, void *dest, size_t len, uint64_t offset) {
+    return gz_read_at(src, dest, len, offset);
+}
+
+/**
+ * Opens a gzip-compressed archive and builds its checkpoint index.
+ *
+ * @param gz_fd A file descriptor pointing to a gzip-compressed tar archive. It must stay open while the handle is used.
+ * @param span The distance in bytes of uncompressed data between two checkpoints, zero selects TAR_GZ_DEFAULT_SPAN.
+ *
+ * @return a newly allocated handle to be released with tar_gz_close(),
+ *         NULL if the archive could not be read or decompressed or memory could not be allocated.
+ */
+tar_gz_t *tar_gz_open(int gz_fd, size_t span) {
+    tar_gz_t *gz = calloc(1, sizeof(tar_gz_t));
+    if (gz == NULL) {
+        return NULL;
+    }
+    gz->gz_fd = gz_fd;
+    gz->span = span ? span : TAR_GZ_DEFAULT_SPAN;
+    gz->index = calloc(1, sizeof(tar_index_t));
+    if (gz->index == NULL) {
+        free(gz);
+        return NULL;
+    }
+    gz->index->tar_fd = -1;
+
+    if (gz_build(gz) == -1 || index_finish(gz->index) == -1) {
+        tar_gz_close(gz);
+        return NULL;
+    }
+    return gz;
+}
+
+/**
+ * Releases a handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @param gz The handle to release, may be NULL.
+ */
+void tar_gz_close(tar_gz_t *gz) {
+    if (gz == NULL) {
+        return;
+    }
+    gz_strm_end(gz);
+    tar_index_close(gz->index);
+    if (gz->map != NULL) {
+        munmap(gz->map, gz->map_len);
+    } else {
+        free(gz->points);
+        free(gz->windows);
+    }
+    free(gz);
+}
+
+/* En-tête du fichier de points de reprise, suivi des points, des fenêtres puis de l'index */
+struct gz_file_header {
+    char magic[8];
+    uint64_t gz_size;
+    int64_t gz_mtime_sec;
+    int64_t gz_mtime_nsec;
+    uint64_t span;
+    uint64_t total_out;
+    int64_t check;
+    uint64_t n_points;
+    uint64_t points_off;
+    uint64_t windows_off;
+    uint64_t index_off;
+};
+
+/*
+ * Vérifie chaque point de reprise d'un fichier chargé : fenêtre dans le fichier, nombre de bits dans un octet, octet
+ * précédent dans l'archive compressée, et offsets décompressés strictement croissants jusqu'à la fin des données.
+ *
+ * @return 0 si les points sont cohérents, -1 sinon
+ */
+static int gz_check_points(const struct gz_point *points, const struct gz_file_header *hdr) {
+    for (uint64_t i = 0; i < hdr->n_points; i++) {
+        const struct gz_point *point = &points[i];
+        if (point->window >= hdr->n_points || point->bits < 0 || point->bits > 7
+            || (point->bits != 0 && point->in < 1) || point->in > hdr->gz_size || point->out > hdr->total_out
+            || (i > 0 && point->out <= points[i - 1].out)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Saves the checkpoint index of a compressed archive, so that later processes can load it with tar_gz_load() instead
+ * of decompressing the whole archive.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param checkpoint_path The path of the file to write, e.g. "archive.tar.gz.gzidx". It is replaced atomically.
+ *
+ * @return zero on success,
+ *         -1 if the archive could not be read or the file could not be written.
+ */
+int tar_gz_save(const tar_gz_t *gz, const char *checkpoint_path) {
+    struct stat st;
+    struct gz_file_header hdr;
+    struct sidecar_header index_hdr;
+    static const uint8_t zeros[8] = {0};
+    char *tmp_path;
+
+    if (fstat(gz->gz_fd, &st) == -1) {
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, GZ_MAGIC, sizeof(hdr.magic));
+    hdr.gz_size = st.st_size;
+    hdr.gz_mtime_sec = st.st_mtim.tv_sec;
+    hdr.gz_mtime_nsec = st.st_mtim.tv_nsec;
+    hdr.span = gz->span;
+    hdr.total_out = gz->total_out;
+    hdr.check = gz->check;
+    hdr.n_points = gz->n_points;
+    hdr.points_off = align8(sizeof(hdr));
+    hdr.windows_off = align8(hdr.points_off + hdr.n_points * sizeof(struct gz_point));
+    hdr.index_off = hdr.windows_off + hdr.n_points * GZ_WINDOW;
+
+    // L'identité de l'archive est portée par l'en-tête du fichier, pas par celui de l'index
+    memset(&index_hdr, 0, sizeof(index_hdr));
+
+    int fd = create_tmp(checkpoint_path, &tmp_path);
+    if (fd == -1) {
+        return -1;
+    }
+    int ret = write_all(fd, &hdr, sizeof(hdr)) == -1
+              || write_all(fd, zeros, hdr.points_off - sizeof(hdr)) == -1
+              || write_all(fd, gz->points, hdr.n_points * sizeof(struct gz_point)) == -1
+              || write_all(fd, zeros, hdr.windows_off - hdr.points_off - hdr.n_points * sizeof(struct gz_point)) == -1
+              || write_all(fd, gz->windows, hdr.n_points * GZ_WINDOW) == -1
+              || index_write_blob(fd, gz->index, &index_hdr) == -1 ? -1 : 0;
+    return commit_tmp(fd, tmp_path, checkpoint_path, ret);
+}
+
+/**
+ * Loads a checkpoint index saved by tar_gz_save(), without decompressing the archive.
+ *
+ * @param checkpoint_path The path of the checkpoint file.
+ * @param gz_fd A file descriptor pointing to the compressed archive the checkpoints were saved for.
+ *
+ * @return a newly allocated handle to be released with tar_gz_close(),
+ *         NULL if the file could not be read, is corrupted, or is stale because the archive changed since it was
+ *         saved (errno is then set to ESTALE).
+ */
+tar_gz_t *tar_gz_load(const char *checkpoint_path, int gz_fd) {
+    struct stat st;
+    struct gz_file_header hdr;
+    struct sidecar_header index_hdr;
+    size_t map_len;
+
+    if (fstat(gz_fd, &st) == -1) {
+        return NULL;
+    }
+    uint8_t *map = map_file(checkpoint_path, &map_len);
+    if (map == NULL) {
+        return NULL;
+    }
+    if (map_len < sizeof(hdr)) {
+        munmap(map, map_len);
+        errno = EINVAL;
+        return NULL;
+    }
+    memcpy(&hdr, map, sizeof(hdr));
+    // Les tailles et les offsets sont vérifiés sans débordement, et les points doivent être alignés
+    uint64_t points_len, windows_len, points_end, windows_end;
+    int valid = memcmp(hdr.magic, GZ_MAGIC, sizeof(hdr.magic)) == 0 && hdr.n_points > 0
+                && hdr.n_points <= UINT32_MAX
+                && !__builtin_mul_overflow(hdr.n_points, sizeof(struct gz_point), &points_len)
+                && !__builtin_mul_overflow(hdr.n_points, GZ_WINDOW, &windows_len)
+                && !__builtin_add_overflow(hdr.points_off, points_len, &points_end)
+                && !__builtin_add_overflow(hdr.windows_off, windows_len, &windows_end)
+                && hdr.points_off >= sizeof(hdr) && hdr.points_off % 8 == 0
+                && points_end <= hdr.windows_off && windows_end == hdr.index_off && hdr.index_off <= map_len;
+    if (!valid || gz_check_points((const struct gz_point *)(map + hdr.points_off), &hdr) == -1) {
+        munmap(map, map_len);
+        errno = EINVAL;
+        return NULL;
+    }
+    if ((uint64_t)st.st_size != hdr.gz_size || st.st_mtim.tv_sec != hdr.gz_mtime_sec
+        || st.st_mtim.tv_nsec != hdr.gz_mtime_nsec) {
+        munmap(map, map_len);
+        errno = ESTALE;
+        return NULL;
+    }
+
+    tar_gz_t *gz = calloc(1, sizeof(tar_gz_t));
+    if (gz == NULL) {
+        munmap(map, map_len);
+        return NULL;
+    }
+    gz->map = map;
+    gz->map_len = map_len;
+    gz->gz_fd = gz_fd;
+    gz->span = hdr.span;
+    gz->total_out = hdr.total_out;
+    gz->check = hdr.check;
+    gz->n_points = hdr.n_points;
+    gz->points = (struct gz_point *)(map + hdr.points_off);
+    gz->windows = map + hdr.windows_off;
+    gz->index = index_map_blob(map + hdr.index_off, map_len - hdr.index_off, &index_hdr);
+    if (gz->index == NULL) {
+        tar_gz_close(gz);
+        return NULL;
+    }
+    return gz;
+}
+
+/**
+ * Checks whether the compressed archive is valid, see check_archive().
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @return the same values as check_archive().
+ */
+int tar_gz_check_archive(const tar_gz_t *gz) {
+    return gz->check;
+}
+
+/**
+ * Gives the index of the entries of the compressed archive. It can be used with the tar_index_*() lookups and
+ * list_next(), but not to read files: use tar_gz_read_file() instead.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @return the index of the archive, valid as long as the handle.
+ */
+const tar_index_t *tar_gz_index(const tar_gz_t *gz) {
+    return gz->index;
+}
+
+/**
+ * Checks whether an entry exists in the compressed archive.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_gz_exists(const tar_gz_t *gz, const char *path) {
+    return tar_index_exists(gz->index, path);
+}
+
+/**
+ * Lists the entries at a given path in the compressed archive, see list().
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_gz_list(const tar_gz_t *gz, const char *path, char **entries, size_t *no_entries) {
+    tar_dirent_t page[64];
+    size_t cursor = 0;
+    size_t count = 0;
+    ssize_t n;
+
+    do {
+        n = list_next(gz->index, path, &cursor, page, 64);
+        if (n == -1) {
+            *no_entries = 0;
+            return 0;
+        }
+        for (ssize_t i = 0; i < n && count < *no_entries; i++) {
+            strncpy(entries[count++], page[i].path, 100);
+        }
+    } while (n > 0 && count < *no_entries);
+    *no_entries = count;
+    return 1;
+}
+
+/**
+ * Reads a file at a given path in the compressed archive, with the same semantics as read_file().
+ *
+ * Decompression starts from the closest checkpoint before the requested data, or continues from the previous read
+ * when it is closer.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_gz_read_file(tar_gz_t *gz, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    const index_entry_t *entry = index_resolve(gz->index, path);
+    if (entry == NULL || !is_file_type(entry->type)) {
+        *len = 0;
+        return -1;
+    }
+    if (offset >= entry->size) {
+        *len = 0;
+        return -2;
+    }
+
+    size_t bytes_to_read = entry->size - offset;
+    if (bytes_to_read > *len) {
+        bytes_to_read = *len;
+    }
+    ssize_t bytes_read = entry->sparse != TAR_SPARSE_NONE
+                         ? sparse_pread(read_at_gz, gz, entry->sparse, entry->data_off, dest, bytes_to_read, offset)
+                         : gz_read_at(gz, dest, bytes_to_read, entry->data_off + offset);
+    if (bytes_read == -1) {
+        *len = 0;
+        return -1;
+    }
+    *len = bytes_read;
+    return entry->size - offset - bytes_read;
+}
+
+/*
+ * Lecture en flux.
+ *
+ * tar_stream() lit l'archive une seule fois, sans jamais se déplacer dans le fichier, ce qui permet de traiter une
+ * archive qui arrive par un tube ou une socket. Les données dont l'appelant ne veut pas sont passées avec splice()
+ * vers /dev/null quand le descripteur est un tube, sinon lues et jetées.
+ */
+#define STREAM_BUF (64 * 1024)
+
+struct tar_stream_state {
+    int fd;
+    int null_fd;          // /dev/null, ouvert à la première donnée à passer
+    uint64_t pos;         // offset dans l'archive du premier octet de buf non consommé
+    uint8_t *buf;
+    size_t start;         // premier octet non consommé de buf
+    size_t end;           // fin des données de buf
+    uint8_t *member;      // en-têtes de l'entrée courante
+    size_t member_cap;
+};
+
+/* Remplit le tampon pour qu'il contienne au moins un octet, retourne le nombre d'octets disponibles, 0 ou -1 */
+static ssize_t stream_fill(struct tar_stream_state *st) {
+    if (st->start < st->end) {
+        return st->end - st->start;
+    }
+    ssize_t n;
+    do {
+        n = io_read(st->fd, st->buf, STREAM_BUF);
+    } while (n == -1 && errno == EINTR);
+    if (n <= 0) {
+        return n;
+    }
+    st->start = 0;
+    st->end = n;
+    return n;
+}
+
+/* Lit exactement len octets, retourne 0, ou -1 si l'archive est tronquée ou illisible */
+static int stream_read(struct tar_stream_state *st, void *dest, size_t len) {
+    uint8_t *out = dest;
+    while (len > 0) {
+        ssize_t avail = stream_fill(st);
+        if (avail <= 0) {
+            return -1;
+        }
+        size_t take = (size_t)avail < len ? (size_t)avail : len;
+        memcpy(out, st->buf + st->start, take);
+        st->start += take;
+        st->pos += take;
+        out += take;
+        len -= take;
+    }
+    return 0;
+}
+
+/* Passe len octets de l'archive, retourne 0, ou -1 si l'archive est tronquée ou illisible */
+static int stream_skip(struct tar_stream_state *st, uint64_t len) {
+    // D'abord ce qui est déjà dans le tampon
+    size_t buffered = st->end - st->start;
+    size_t take = buffered < len ? buffered : len;
+    st->start += take;
+    st->pos += take;
+    len -= take;
+
+    // Puis splice() vers /dev/null, qui n'est possible que si fd est un tube
+    if (len >= STREAM_BUF && st->null_fd != -2) {
+        if (st->null_fd == -1) {
+            st->null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        }
+        while (len > 0 && st->null_fd >= 0) {
+            ssize_t n = splice(st->fd, NULL, st->null_fd, NULL, len, SPLICE_F_MOVE);
+            if (n > 0) {
+                st->pos += n;
+                len -= n;
+            } else if (n == 0) {
+                return -1;
+            } else if (errno != EINTR) {
+                // Pas un tube : on n'essaie plus et on lit le reste
+                close(st->null_fd);
+                st->null_fd = -2;
+                break;
+            }
+        }
+    }
+
+    while (len > 0) {
+        ssize_t avail = stream_fill(st);
+        if (avail <= 0) {
+            return -1;
+        }
+        take = (size_t)avail < len ? (size_t)avail : len;
+        st->start += take;
+        st->pos += take;
+        len -= take;
+    }
+    return 0;
+}
+
+/* Transmet len octets de données à on_data par morceaux, offset étant leur position dans le fichier */
+static int stream_data(struct tar_stream_state *st, const tar_stream_callbacks_t *callbacks, const tar_entry_t *entry,
+                       void *ctx, uint64_t offset, uint64_t len, int *stop) {
+    uint64_t end = offset + len;
+    while (offset < end) {
+        ssize_t avail = stream_fill(st);
+        if (avail <= 0) {
+            return -1;
+        }
+        size_t take = (uint64_t)avail < end - offset ? (size_t)avail : end - offset;
+        if (callbacks->on_data(entry, st->buf + st->start, take, offset, ctx) != 0) {
+            *stop = 1;
+            return 0;
+        }
+        st->start += take;
+        st->pos += take;
+        offset += take;
+    }
+    return 0;
+}
+
+/* Lecteur pour sparse_load() : les en-têtes de l'entrée sont dans member, la suite est lue en avançant dans le flux */
+struct stream_reader {
+    struct tar_stream_state *st;
+    uint64_t member_off;
+    size_t member_len;
+};
+
+static ssize_t read_at_stream(void *src, void *dest, size_t len, uint64_t offset) {
+    struct stream_reader *r = src;
+    struct tar_stream_state *st = r->st;
+    if (offset >= r->member_off && offset + len <= r->member_off + r->member_len) {
+        memcpy(dest, st->member + (offset - r->member_off), len);
+        return len;
+    }
+    if (offset < st->pos || stream_skip(st, offset - st->pos) == -1 || stream_read(st, dest, len) == -1) {
+        return -1;
+    }
+    return len;
+}
+
+/* Transmet les segments d'un fichier creux à on_data, à leur position dans le fichier ; les trous sont sautés */
+static int stream_sparse(struct tar_stream_state *st, const tar_stream_callbacks_t *callbacks,
+                         const tar_entry_t *entry, void *ctx, uint64_t member_off, size_t member_len, int *stop) {
+    struct stream_reader reader = {st, member_off, member_len};
+    struct sparse_map map;
+
+    if (sparse_load(read_at_stream, &reader, entry->sparse, entry->data_offset, &map) == -1) {
+        return -1;
+    }
+    int ret = 0;
+    for (size_t i = 0; i < map.n && ret == 0 && !*stop; i++) {
+        if (map.segs[i].data_off < st->pos) {
+            ret = -1;
+            break;
+        }
+        ret = stream_skip(st, map.segs[i].data_off - st->pos);
+        if (ret == 0) {
+            ret = stream_data(st, callbacks, entry, ctx, map.segs[i].offset, map.segs[i].size, stop);
+        }
+    }
+    free(map.segs);
+    return ret;
+}
+
+/**
+ * Reads an archive in a single forward pass and calls the caller back for each entry, without seeking. This works on
+ * pipes, sockets and standard input as well as on regular files.
+ *
+ * Each header is validated as check_archive() does before on_entry is called, except that the GNU magic, "ustar  ",
+ * is accepted so that GNU archives and their sparse files can be streamed. The data of an entry is given to on_data
+ * if on_entry returns TAR_STREAM_DATA and skipped otherwise. For a sparse file, only its data segments are given, at
+ * their offset in the file: the holes between them are left to the caller.
+ *
+ * @param fd A file descriptor open for reading, positioned at the start of the archive. It is read up to the end of
+ *           the archive, or less if a callback stops the walk.
+ * @param callbacks The functions to call, either may be NULL. Without on_entry every entry is skipped, without on_data
+ *                  the data of every entry is skipped.
+ * @param ctx An opaque pointer given back to the callbacks.
+ *
+ * @return the number of entries visited, including the one whose callback stopped the walk,
+ *         -1 if an archive header contains an invalid magic value,
+ *         -2 if an archive header contains an invalid version value,
+ *         -3 if an archive header contains an invalid checksum value,
+ *         -4 if the archive could not be read or is truncated.
+ */
+ssize_t tar_stream(int fd, const tar_stream_callbacks_t *callbacks, void *ctx) {
+    struct tar_stream_state st = {.fd = fd, .null_fd = -1};
+    char path[HEADER_PATH_MAX];
+    ssize_t count = 0;
+    ssize_t ret = 0;
+
+    st.buf = malloc(STREAM_BUF);
+    st.member = malloc(BLOCK_SIZE);
+    st.member_cap = BLOCK_SIZE;
+    if (st.buf == NULL || st.member == NULL) {
+        free(st.buf);
+        free(st.member);
+        return -4;
+    }
+    while (1) {
+        uint64_t header_offset = st.pos;
+        tar_entry_t entry;
+        size_t have = 0, need = BLOCK_SIZE;
+        uint64_t next;
+        int decoded = 0;
+
+        // Lit les en-têtes de l'entrée, pax et blocs d'extension GNU compris
+        while (!decoded) {
+            if (need > st.member_cap) {
+                uint8_t *member = realloc(st.member, need);
+                if (member == NULL) {
+                    break;
+                }
+                st.member = member;
+                st.member_cap = need;
+            }
+            if (stream_read(&st, st.member + have, need - have) == -1) {
+                break;
+            }
+            have = need;
+            decoded = entry_decode(st.member, have, header_offset, path, &entry, &need, &next);
+        }
+        if (!decoded) {
+            // Une archive sans blocs de fin reste acceptée si elle s'arrête sur une frontière d'en-tête
+            ret = st.pos == header_offset && st.end == st.start ? count : -4;
+            break;
+        }
+        if (entry.header->name[0] == '\0') {
+            ret = count;
+            break;
+        }
+        int valid = entry.pax_blocks != 0 ? validate_member_header(entry_pax_header(&entry)) : 0;
+        if (valid == 0) {
+            valid = validate_member_header(entry.header);
+        }
+        if (valid != 0) {
+            ret = valid;
+            break;
+        }
+        count++;
+
+        int action = callbacks != NULL && callbacks->on_entry != NULL ? callbacks->on_entry(&entry, ctx)
+                                                                      : TAR_STREAM_SKIP;
+        if (action == TAR_STREAM_STOP) {
+            ret = count;
+            break;
+        }
+        int stop = 0;
+        int r = 0;
+        if (action == TAR_STREAM_DATA && callbacks->on_data != NULL) {
+            r = entry.sparse != TAR_SPARSE_NONE
+                ? stream_sparse(&st, callbacks, &entry, ctx, header_offset, have, &stop)
+                : stream_data(&st, callbacks, &entry, ctx, 0, entry.size, &stop);
+        }
+        if (stop) {
+            ret = count;
+            break;
+        }
+        // Bourrage et données non transmises jusqu'à l'en-tête suivant
+        if (r == -1 || next < st.pos || stream_skip(&st, next - st.pos) == -1) {
+            ret = -4;
+            break;
+        }
+    }
+
+    if (st.null_fd >= 0) {
+        close(st.null_fd);
+    }
+    free(st.buf);
+    free(st.member);
+    return ret;
+}
+
+/*
+ * Lectures asynchrones.
+ *
+ * Les chemins sont résolus dans l'index, en mémoire, au moment de la soumission : seule la lecture des données est
+ * asynchrone. Avec io_uring, les lectures sont déposées dans l'anneau de soumission et envoyées au noyau en une fois
+ * par tar_async_poll() ou tar_async_wait(), le descripteur de l'archive étant enregistré (fixed file) et les tampons
+ * enregistrés lus avec IORING_OP_READ_FIXED. Sans io_uring, un petit groupe de threads fait des pread().
+ *
+ * Chaque requête occupe un emplacement jusqu'à ce que sa complétion soit rendue à l'appelant ; les emplacements sont
+ * chaînés dans une liste libre, dans la file d'attente des threads ou dans la liste des complétions prêtes.
+ */
+#define ASYNC_THREADS 4
+#define ASYNC_NONE UINT32_MAX
+#define URING_READ_MAX (1U << 30)  // sqe->len est sur 32 bits et cqe->res, signé, sur 32 bits aussi
+
+struct async_slot {
+    void *user_data;
+    uint8_t *dest;
+    size_t len;           // octets demandés
+    uint64_t off;         // position des données dans l'archive
+    uint64_t remaining;   // octets du fichier après la plage demandée
+    ssize_t result;
+    size_t got;           // octets déjà lus, une lecture courte étant reprise là où elle s'est arrêtée
+    int buf_index;        // tampon enregistré qui contient dest, -1 sinon
+    uint32_t next;
+};
+
+struct tar_async {
+    const tar_index_t *index;
+    int tar_fd;
+    unsigned depth;
+    struct async_slot *slots;
+    uint32_t free_head;
+    uint32_t done_head;   // complétions prêtes, dans l'ordre où elles sont arrivées
+    uint32_t done_tail;
+    unsigned used;        // emplacements occupés
+    unsigned pending;     // lectures soumises et pas encore terminées
+    struct iovec *bufs;
+    unsigned n_bufs;
+    pthread_mutex_t lock;
+
+    // io_uring
+    int uring;
+    int ring_fd;
+    int fixed_file;
+    unsigned to_submit;
+    void *sq_ptr;
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Groupe de threads
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    uint32_t queue_head;
+    uint32_t queue_tail;
+    pthread_t threads[ASYNC_THREADS];
+    int n_threads;
+    int stop;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int ring_fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+/*
+ * Les noyaux 5.1 à 5.5 acceptent io_uring_setup() mais refusent IORING_OP_READ, et ne savent pas non plus répondre à
+ * IORING_REGISTER_PROBE : les lectures ne passent par l'anneau que si le noyau annonce les deux opérations utilisées.
+ */
+static int uring_probe(int ring_fd) {
+    size_t ops_len = IORING_OP_READ > IORING_OP_READ_FIXED ? IORING_OP_READ + 1 : IORING_OP_READ_FIXED + 1;
+    struct io_uring_probe *probe = calloc(1, sizeof(*probe) + ops_len * sizeof(struct io_uring_probe_op));
+    if (probe == NULL) {
+        return -1;
+    }
+    int ret = uring_register(ring_fd, IORING_REGISTER_PROBE, probe, ops_len) == 0
+              && probe->last_op >= IORING_OP_READ && probe->last_op >= IORING_OP_READ_FIXED
+              && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+              && (probe->ops[IORING_OP_READ_FIXED].flags & IO_URING_OP_SUPPORTED) ? 0 : -1;
+    free(probe);
+    return ret;
+}
+
+/* Crée l'anneau et projette ses files, retourne -1 si io_uring n'est pas disponible */
+static int uring_open(tar_async_t *a) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    a->ring_fd = uring_setup(a->depth, &params);
+    if (a->ring_fd < 0) {
+        return -1;
+    }
+    if (uring_probe(a->ring_fd) == -1) {
+        return -1;
+    }
+
+    a->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    a->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (a->cq_len > a->sq_len) {
+            a->sq_len = a->cq_len;
+        }
+        a->cq_len = 0;
+    }
+    a->sq_ptr = mmap(NULL, a->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->ring_fd,
+                     IORING_OFF_SQ_RING);
+    if (a->sq_ptr == MAP_FAILED) {
+        a->sq_ptr = NULL;
+        return -1;
+    }
+    a->cq_ptr = a->sq_ptr;
+    if (a->cq_len > 0) {
+        a->cq_ptr = mmap(NULL, a->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->ring_fd,
+                         IORING_OFF_CQ_RING);
+        if (a->cq_ptr == MAP_FAILED) {
+            a->cq_ptr = NULL;
+            return -1;
+        }
+    }
+    a->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = mmap(NULL, a->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->ring_fd,
+                   IORING_OFF_SQES);
+    if (a->sqes == MAP_FAILED) {
+        a->sqes = NULL;
+        return -1;
+    }
+
+    uint8_t *sq = a->sq_ptr, *cq = a->cq_ptr;
+    a->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    a->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + params.sq_off.array);
+    a->cq_head = (unsigned *)(cq + params.cq_off.head);
+    a->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    a->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Descripteur enregistré : le noyau n'a plus à le retrouver à chaque lecture
+    a->fixed_file = uring_register(a->ring_fd, IORING_REGISTER_FILES, &a->tar_fd, 1) == 0;
+    return 0;
+}
+
+static void uring_close(tar_async_t *a) {
+    if (a->sqes != NULL) {
+        munmap(a->sqes, a->sqes_len);
+    }
+    if (a->cq_ptr != NULL && a->cq_ptr != a->sq_ptr) {
+        munmap(a->cq_ptr, a->cq_len);
+    }
+    if (a->sq_ptr != NULL) {
+        munmap(a->sq_ptr, a->sq_len);
+    }
+    if (a->ring_fd >= 0) {
+        close(a->ring_fd);
+    }
+}
+
+/* Dépose la lecture de la suite d'un emplacement, par morceaux d'au plus URING_READ_MAX octets */
+static void uring_push(tar_async_t *a, uint32_t slot_index) {
+    const struct async_slot *slot = &a->slots[slot_index];
+    size_t len = slot->len - slot->got < URING_READ_MAX ? slot->len - slot->got : URING_READ_MAX;
+    unsigned tail = *a->sq_tail;
+    unsigned index = tail & *a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = slot->buf_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = a->fixed_file ? 0 : a->tar_fd;
+    sqe->flags = a->fixed_file ? IOSQE_FIXED_FILE : 0;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->dest + slot->got);
+    sqe->len = len;
+    sqe->off = slot->off + slot->got;
+    sqe->buf_index = slot->buf_index >= 0 ? slot->buf_index : 0;
+    sqe->user_data = slot_index;
+    a->sq_array[index] = index;
+    __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    a->to_submit++;
+}
+
+/* Ajoute un emplacement terminé à la liste des complétions prêtes, le verrou étant pris */
+static void async_done(tar_async_t *a, uint32_t slot_index) {
+    a->slots[slot_index].next = ASYNC_NONE;
+    if (a->done_tail == ASYNC_NONE) {
+        a->done_head = slot_index;
+    } else {
+        a->slots[a->done_tail].next = slot_index;
+    }
+    a->done_tail = slot_index;
+}
+
+/* Résultat d'une lecture qui a rapporté got octets, ou une erreur si got est négatif */
+static void async_finish(struct async_slot *slot, ssize_t got) {
+    if (got < 0) {
+        slot->result = -1;
+        slot->got = 0;
+        return;
+    }
+    slot->got = got;
+    slot->result = slot->remaining + (slot->len - got);
+}
+
+/* Envoie les lectures déposées et récupère les complétions, en attendant au moins min_complete */
+static int uring_reap(tar_async_t *a, unsigned min_complete) {
+    if (a->to_submit > 0 || min_complete > 0) {
+        int ret;
+        do {
+            ret = uring_enter(a->ring_fd, a->to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+        } while (ret == -1 && errno == EINTR);
+        if (ret == -1) {
+            return -1;
+        }
+        a->to_submit -= (unsigned)ret < a->to_submit ? (unsigned)ret : a->to_submit;
+    }
+
+    unsigned head = *a->cq_head;
+    unsigned tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+        uint32_t slot_index = cqe->user_data;
+        struct async_slot *slot = &a->slots[slot_index];
+        // Une lecture courte qui n'a pas atteint la fin du fichier est reprise, comme par read_at_fd()
+        if (cqe->res > 0 && slot->got + cqe->res < slot->len) {
+            slot->got += cqe->res;
+            uring_push(a, slot_index);
+            continue;
+        }
+        async_finish(slot, cqe->res < 0 ? -1 : (ssize_t)(slot->got + cqe->res));
+        async_done(a, slot_index);
+        a->pending--;
+    }
+    __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void *async_worker(void *arg) {
+    tar_async_t *a = arg;
+
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        while (a->queue_head == ASYNC_NONE && !a->stop) {
+            pthread_cond_wait(&a->work_cond, &a->lock);
+        }
+        if (a->queue_head == ASYNC_NONE) {
+            break;
+        }
+        uint32_t slot_index = a->queue_head;
+        struct async_slot *slot = &a->slots[slot_index];
+        a->queue_head = slot->next;
+        if (a->queue_head == ASYNC_NONE) {
+            a->queue_tail = ASYNC_NONE;
+        }
+        pthread_mutex_unlock(&a->lock);
+
+        int tar_fd = a->tar_fd;
+        async_finish(slot, read_at_fd(&tar_fd, slot->dest, slot->len, slot->off));
+
+        pthread_mutex_lock(&a->lock);
+        async_done(a, slot_index);
+        a->pending--;
+        pthread_cond_signal(&a->done_cond);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return NULL;
+}
+
+/**
+ * Creates an asynchronous read engine on an indexed archive.
+ *
+ * io_uring is used when the kernel supports it, a pool of pread() threads otherwise. A handle is meant to be used by
+ * a single thread, which can keep up to depth reads in flight.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load(). It must stay open while the handle
+ *              is used.
+ * @param depth The maximum number of reads in flight, zero selects TAR_ASYNC_DEFAULT_DEPTH.
+ * @param flags Zero, or TAR_ASYNC_FORCE_THREADS to use the thread pool even if io_uring is available.
+ *
+ * @return a newly allocated handle to be released with tar_async_close(),
+ *         NULL if memory could not be allocated or the threads could not be started.
+ */
+tar_async_t *tar_async_open(const tar_index_t *index, unsigned depth, int flags) {
+    tar_async_t *a = calloc(1, sizeof(tar_async_t));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->index = index;
+    a->tar_fd = index->tar_fd;
+    a->depth = depth ? depth : TAR_ASYNC_DEFAULT_DEPTH;
+    a->ring_fd = -1;
+    a->done_head = a->done_tail = ASYNC_NONE;
+    a->queue_head = a->queue_tail = ASYNC_NONE;
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->work_cond, NULL);
+    pthread_cond_init(&a->done_cond, NULL);
+
+    a->slots = malloc(a->depth * sizeof(struct async_slot));
+    if (a->slots == NULL) {
+        tar_async_close(a);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < a->depth; i++) {
+        a->slots[i].next = i + 1 < a->depth ? i + 1 : ASYNC_NONE;
+    }
+    a->free_head = 0;
+
+    if (!(flags & TAR_ASYNC_FORCE_THREADS) && uring_open(a) == 0) {
+        a->uring = 1;
+        return a;
+    }
+    uring_close(a);
+    a->ring_fd = -1;
+    a->sq_ptr = a->cq_ptr = NULL;
+    a->sqes = NULL;
+
+    for (int i = 0; i < ASYNC_THREADS; i++) {
+        if (pthread_create(&a->threads[i], NULL, async_worker, a) != 0) {
+            tar_async_close(a);
+            return NULL;
+        }
+        a->n_threads++;
+    }
+    return a;
+}
+
+/**
+ * Gives the name of the backend used by an asynchronous read engine.
+ *
+ * @param a A handle returned by tar_async_open().
+ *
+ * @return "io_uring" or "threads".
+ */
+const char *tar_async_backend(const tar_async_t *a) {
+    return a->uring ? "io_uring" : "threads";
+}
+
+/**
+ * Registers destination buffers, so that reads into them skip the mapping of user memory by the kernel. Only io_uring
+ * makes use of them, the call succeeds without effect with the thread pool.
+ *
+ * @param a A handle returned by tar_async_open(), with no read in flight.
+ * @param bufs The buffers to register. A read uses a registered buffer if its destination lies entirely inside it.
+ * @param n The number of buffers.
+ *
+ * @return zero on success,
+ *         -1 if reads are in flight, memory could not be allocated or the kernel refused the buffers.
+ */
+int tar_async_register_buffers(tar_async_t *a, const struct iovec *bufs, unsigned n) {
+    if (a->used > 0) {
+        errno = EBUSY;
+        return -1;
+    }
+    struct iovec *copy = malloc(n * sizeof(struct iovec));
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, bufs, n * sizeof(struct iovec));
+    if (a->uring) {
+        if (a->n_bufs > 0) {
+            uring_register(a->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        }
+        if (uring_register(a->ring_fd, IORING_REGISTER_BUFFERS, copy, n) != 0) {
+            free(copy);
+            free(a->bufs);
+            a->bufs = NULL;
+            a->n_bufs = 0;
+            return -1;
+        }
+    }
+    free(a->bufs);
+    a->bufs = copy;
+    a->n_bufs = n;
+    return 0;
+}
+
+/**
+ * Submits an asynchronous read of a file of the archive, with the same semantics as read_file(). The path is
+ * resolved immediately in the index; the read itself completes later, see tar_async_poll() and tar_async_wait().
+ *
+ * Requests that need no read (no such file, offset after the end of the file) complete immediately, as do sparse
+ * files, which are read synchronously.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param path A path to an entry in the archive to read from. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer, which must stay valid until the read completes.
+ * @param len The size of dest.
+ * @param user_data An opaque pointer given back with the completion.
+ *
+ * @return zero if the request was accepted,
+ *         -1 if depth requests are already in flight (errno is then set to EAGAIN).
+ */
+int tar_async_read(tar_async_t *a, const char *path, size_t offset, uint8_t *dest, size_t len, void *user_data) {
+    if (a->used == a->depth) {
+        errno = EAGAIN;
+        return -1;
+    }
+    uint32_t slot_index = a->free_head;
+    struct async_slot *slot = &a->slots[slot_index];
+    a->free_head = slot->next;
+    a->used++;
+
+    slot->user_data = user_data;
+    slot->dest = dest;
+    slot->len = 0;
+    slot->remaining = 0;
+    slot->got = 0;
+    slot->result = -1;
+    slot->buf_index = -1;
+
+    const index_entry_t *entry = index_resolve(a->index, path);
+    int immediate = 1;
+    if (entry != NULL && is_file_type(entry->type)) {
+        if (offset >= entry->size) {
+            slot->result = -2;
+        } else {
+            slot->len = entry->size - offset < len ? entry->size - offset : len;
+            slot->remaining = entry->size - offset - slot->len;
+            slot->off = entry->data_off + offset;
+            slot->result = slot->remaining;
+            if (entry->sparse != TAR_SPARSE_NONE) {
+                int tar_fd = a->tar_fd;
+                async_finish(slot, sparse_pread(read_at_fd, &tar_fd, entry->sparse, entry->data_off, dest,
+                                                slot->len, offset));
+            } else if (slot->len > 0) {
+                immediate = 0;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&a->lock);
+    if (immediate) {
+        async_done(a, slot_index);
+        pthread_mutex_unlock(&a->lock);
+        return 0;
+    }
+    a->pending++;
+    if (a->uring) {
+        pthread_mutex_unlock(&a->lock);
+        for (unsigned i = 0; i < a->n_bufs; i++) {
+            uint8_t *base = a->bufs[i].iov_base;
+            if (dest >= base && dest + slot->len <= base + a->bufs[i].iov_len) {
+                slot->buf_index = i;
+                break;
+            }
+        }
+        uring_push(a, slot_index);
+        return 0;
+    }
+    slot->next = ASYNC_NONE;
+    if (a->queue_tail == ASYNC_NONE) {
+        a->queue_head = slot_index;
+    } else {
+        a->slots[a->queue_tail].next = slot_index;
+    }
+    a->queue_tail = slot_index;
+    pthread_cond_signal(&a->work_cond);
+    pthread_mutex_unlock(&a->lock);
+    return 0;
+}
+
+/* Rend au plus max complétions prêtes, le verrou étant pris */
+static size_t async_collect(tar_async_t *a, tar_async_completion_t *out, size_t max) {
+    size_t count = 0;
+    while (count < max && a->done_head != ASYNC_NONE) {
+        uint32_t slot_index = a->done_head;
+        struct async_slot *slot = &a->slots[slot_index];
+        a->done_head = slot->next;
+        if (a->done_head == ASYNC_NONE) {
+            a->done_tail = ASYNC_NONE;
+        }
+        out[count].user_data = slot->user_data;
+        out[count].result = slot->result;
+        out[count].len = slot->got;
+        count++;
+
+        slot->next = a->free_head;
+        a->free_head = slot_index;
+        a->used--;
+    }
+    return count;
+}
+
+/**
+ * Sends the submitted reads to the kernel if needed and collects the completed ones, without blocking.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param out An array of max completions.
+ * @param max The size of out.
+ *
+ * @return the number of completions written to out,
+ *         -1 if the reads could not be submitted.
+ */
+ssize_t tar_async_poll(tar_async_t *a, tar_async_completion_t *out, size_t max) {
+    return tar_async_wait(a, out, max, 0);
+}
+
+/**
+ * Collects completed reads, blocking until at least min_complete of them are available or no read is left in flight.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param out An array of max completions.
+ * @param max The size of out.
+ * @param min_complete The number of completions to wait for, at most max.
+ *
+ * @return the number of completions written to out,
+ *         -1 if the reads could not be submitted.
+ */
+ssize_t tar_async_wait(tar_async_t *a, tar_async_completion_t *out, size_t max, size_t min_complete) {
+    size_t count = 0;
+
+    if (min_complete > max) {
+        min_complete = max;
+    }
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+        if (a->uring && uring_reap(a, 0) == -1) {
+            pthread_mutex_unlock(&a->lock);
+            return -1;
+        }
+        count += async_collect(a, out + count, max - count);
+        if (count >= min_complete || a->pending == 0) {
+            break;
+        }
+        if (a->uring) {
+            if (uring_reap(a, 1) == -1) {
+                pthread_mutex_unlock(&a->lock);
+                return -1;
+            }
+        } else {
+            pthread_cond_wait(&a->done_cond, &a->lock);
+        }
+    }
+    pthread_mutex_unlock(&a->lock);
+    return count;
+}
+
+/**
+ * Releases an asynchronous read engine, after waiting for the reads in flight. Their completions are discarded.
+ *
+ * @param a The handle to release, may be NULL.
+ */
+void tar_async_close(tar_async_t *a) {
+    if (a == NULL) {
+        return;
+    }
+    if (a->slots != NULL && (a->uring || a->n_threads > 0)) {
+        tar_async_completion_t discard[64];
+        while (a->used > 0 && tar_async_wait(a, discard, 64, 64) > 0) {
+        }
+    }
+    pthread_mutex_lock(&a->lock);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->work_cond);
+    pthread_mutex_unlock(&a->lock);
+    for (int i = 0; i < a->n_threads; i++) {
+        pthread_join(a->threads[i], NULL);
+    }
+    if (a->uring) {
+        uring_close(a);
+    }
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->work_cond);
+    pthread_cond_destroy(&a->done_cond);
+    free(a->bufs);
+    free(a->slots);
+    free(a);
+}
+
+/*
+ * Extraction.
+ *
+ * Le thread appelant parcourt les en-têtes et crée les répertoires au fil du parcours, puis un groupe de threads
+ * écrit les fichiers réguliers en copiant leurs données de l'archive dans le noyau (copy_file_range(), sendfile() à
+ * défaut), sans passer par la mémoire du processus. Les liens sont créés en dernier : un lien symbolique venant de
+ * l'archive ne peut ainsi pas rediriger l'écriture d'un fichier hors du répertoire de destination, et un lien laissé
+ * par une extraction précédente n'est suivi par aucune entrée, son parent comme son chemin étant vérifiés. Les modes des
+ * répertoires sont appliqués à la toute fin, pour qu'un répertoire en lecture seule puisse d'abord être rempli.
+ */
+#define EXTRACT_WINDOW (64 * 1024)
+#define EXTRACT_BUF (256 * 1024)
+#define EXTRACT_PREALLOC_MIN (1024 * 1024)
+
+struct extract_item {
+    char *path;           // chemin relatif au répertoire de destination
+    char *target;         // cible d'un lien, relative à la destination pour un lien physique
+    char type;
+    char sparse;
+    mode_t mode;
+    time_t mtime;
+    uint64_t size;
+    uint64_t data_offset;
+};
+
+struct extract_list {
+    struct extract_item *items;
+    size_t n;
+    size_t cap;
+};
+
+struct extract_shared {
+    int tar_fd;
+    int dest_fd;
+    const struct extract_list *files;
+    pthread_mutex_t lock;
+    size_t next;          // prochain fichier à écrire
+    int error;            // errno de la première erreur, zéro sinon
+};
+
+static struct extract_item *extract_push(struct extract_list *list) {
+    if (list->n == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        struct extract_item *items = realloc(list->items, cap * sizeof(struct extract_item));
+        if (items == NULL) {
+            return NULL;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    struct extract_item *item = &list->items[list->n++];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+static void extract_free(struct extract_list *list) {
+    for (size_t i = 0; i < list->n; i++) {
+        free(list->items[i].path);
+        free(list->items[i].target);
+    }
+    free(list->items);
+}
+
+/* Le chemin fait-il partie du sous-arbre à extraire ? Un préfixe sans '/' final désigne l'entrée et son contenu */
+static int extract_match(const char *path, size_t len, const char *prefix, size_t prefix_len) {
+    if (prefix_len == 0) {
+        return 1;
+    }
+    return len >= prefix_len && memcmp(path, prefix, prefix_len) == 0
+           && (prefix[prefix_len - 1] == '/' || len == prefix_len || path[prefix_len] == '/');
+}
+
+/*
+ * Calcule le chemin de destination d'une entrée, sans ses strip premiers octets ni ses '/' de tête et de fin.
+ * Retourne 0 et le chemin alloué dans out, 1 si l'entrée doit être ignorée (chemin vide ou contenant ".."), -1 si la
+ * mémoire manque.
+ */
+static int extract_path(const char *path, size_t len, size_t strip, char **out) {
+    path += strip;
+    len -= strip;
+    while (len > 0 && path[0] == '/') {
+        path++;
+        len--;
+    }
+    while (len > 0 && path[len - 1] == '/') {
+        len--;
+    }
+    if (len == 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < len;) {
+        size_t end = i;
+        while (end < len && path[end] != '/') {
+            end++;
+        }
+        if (end - i == 2 && path[i] == '.' && path[i + 1] == '.') {
+            return 1;
+        }
+        i = end + 1;
+    }
+    *out = strndup(path, len);
+    return *out == NULL ? -1 : 0;
+}
+
+/* Refuse un chemin dont un parent est un lien symbolique, que la création d'une entrée suivrait */
+static int extract_check_parents(int dest_fd, char *path) {
+    for (char *slash = strchr(path, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        struct stat st;
+        *slash = '\0';
+        int ret = fstatat(dest_fd, path, &st, AT_SYMLINK_NOFOLLOW);
+        *slash = '/';
+        if (ret == -1) {
+            return -1;
+        }
+        if (S_ISLNK(st.st_mode)) {
+            errno = ELOOP;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Crée les répertoires parents d'un chemin, modifié le temps de l'appel. Un parent qui existe déjà doit être un vrai
+ * répertoire : un lien symbolique laissé dans la destination par une extraction précédente y est refusé.
+ */
+static int extract_mkdirs(int dest_fd, char *path) {
+    for (char *slash = strchr(path, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        struct stat st;
+        *slash = '\0';
+        int ret = mkdirat(dest_fd, path, 0777);
+        if (ret == -1 && errno == EEXIST) {
+            ret = fstatat(dest_fd, path, &st, AT_SYMLINK_NOFOLLOW);
+            if (ret == 0 && S_ISLNK(st.st_mode)) {
+                errno = ELOOP;
+                ret = -1;
+            }
+        }
+        *slash = '/';
+        if (ret == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Crée un répertoire ; un lien symbolique laissé à sa place est remplacé, son mode serait sinon appliqué ailleurs */
+static int extract_mkdir(int dest_fd, const char *path) {
+    struct stat st;
+    if (mkdirat(dest_fd, path, 0700) == 0) {
+        return 0;
+    }
+    if (errno != EEXIST || fstatat(dest_fd, path, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+        return -1;
+    }
+    if (S_ISLNK(st.st_mode) && (unlinkat(dest_fd, path, 0) == -1 || mkdirat(dest_fd, path, 0700) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Copie len octets de l'archive dans out, dans le noyau quand c'est possible */
+static int extract_copy(int tar_fd, uint64_t in_off, int out, uint64_t out_off, uint64_t len) {
+    loff_t in_pos = in_off, out_pos = out_off;
+
+    while (len > 0) {
+        ssize_t n = copy_file_range(tar_fd, &in_pos, out, &out_pos, len, 0);
+        if (n == -1 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            break;
+        }
+        if (n <= 0) {
+            errno = n == 0 ? EIO : errno;  // archive tronquée
+            return -1;
+        }
+        len -= n;
+    }
+
+    // sendfile() écrit à la position courante de out
+    if (len > 0 && lseek(out, out_pos, SEEK_SET) == -1) {
+        return -1;
+    }
+    while (len > 0) {
+        off_t pos = in_pos;
+        ssize_t n = sendfile(out, tar_fd, &pos, len);
+        if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            break;
+        }
+        if (n <= 0) {
+            errno = n == 0 ? EIO : errno;
+            return -1;
+        }
+        in_pos = pos;
+        out_pos += n;
+        len -= n;
+    }
+
+    // Dernier recours : copie par un tampon
+    uint8_t *buf = len > 0 ? malloc(EXTRACT_BUF) : NULL;
+    if (len > 0 && buf == NULL) {
+        return -1;
+    }
+    while (len > 0) {
+        size_t chunk = len < EXTRACT_BUF ? len : EXTRACT_BUF;
+        ssize_t n = read_at_fd(&tar_fd, buf, chunk, in_pos);
+        if (n != (ssize_t)chunk || pwrite(out, buf, chunk, out_pos) != (ssize_t)chunk) {
+            errno = n >= 0 && n != (ssize_t)chunk ? EIO : errno;
+            free(buf);
+            return -1;
+        }
+        in_pos += chunk;
+        out_pos += chunk;
+        len -= chunk;
+    }
+    free(buf);
+    return 0;
+}
+
+static int extract_file(int tar_fd, int dest_fd, const struct extract_item *item) {
+    // O_NOFOLLOW ne protège que le dernier composant du chemin
+    if (extract_check_parents(dest_fd, item->path) == -1) {
+        return -1;
+    }
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC;
+    int out = openat(dest_fd, item->path, flags, 0600);
+    if (out == -1 && errno == ELOOP) {
+        // Un lien symbolique laissé par une extraction précédente est remplacé, pas suivi
+        unlinkat(dest_fd, item->path, 0);
+        out = openat(dest_fd, item->path, flags, 0600);
+    }
+    if (out == -1) {
+        return -1;
+    }
+
+    int ret = 0;
+    if (item->sparse != TAR_SPARSE_NONE) {
+        // Seuls les segments de données sont écrits, les trous restent des trous dans le fichier extrait
+        struct sparse_map map;
+        ret = sparse_load(read_at_fd, &tar_fd, item->sparse, item->data_offset, &map);
+        if (ret == 0) {
+            for (size_t i = 0; ret == 0 && i < map.n; i++) {
+                ret = extract_copy(tar_fd, map.segs[i].data_off, out, map.segs[i].offset, map.segs[i].size);
+            }
+            free(map.segs);
+        }
+        if (ret == 0) {
+            ret = ftruncate(out, item->size);
+        }
+    } else {
+        // Échec sans conséquence : le système de fichiers ne sait simplement pas préallouer
+        if (item->size >= EXTRACT_PREALLOC_MIN) {
+            fallocate(out, 0, 0, item->size);
+        }
+        ret = extract_copy(tar_fd, item->data_offset, out, 0, item->size);
+    }
+
+    if (ret == 0) {
+        struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, {.tv_sec = item->mtime}};
+        ret = fchmod(out, item->mode);
+        if (ret == 0) {
+            ret = futimens(out, times);
+        }
+    }
+    if (close(out) == -1) {
+        ret = -1;
+    }
+    return ret;
+}
+
+static void *extract_worker(void *arg) {
+    struct extract_shared *shared = arg;
+
+    while (1) {
+        pthread_mutex_lock(&shared->lock);
+        size_t i = shared->error == 0 ? shared->next++ : shared->files->n;
+        pthread_mutex_unlock(&shared->lock);
+        if (i >= shared->files->n) {
+            return NULL;
+        }
+        if (extract_file(shared->tar_fd, shared->dest_fd, &shared->files->items[i]) == -1) {
+            pthread_mutex_lock(&shared->lock);
+            if (shared->error == 0) {
+                shared->error = errno ? errno : EIO;
+            }
+            pthread_mutex_unlock(&shared->lock);
+        }
+    }
+}
+
+/* Parcourt les en-têtes, crée les répertoires et classe les autres entrées ; retourne le nombre d'entrées retenues */
+static ssize_t extract_walk(int tar_fd, int dest_fd, const char *prefix, int flags, struct extract_list *dirs,
+                            struct extract_list *files, struct extract_list *links) {
+    tar_iter_t it;
+    tar_entry_t entry;
+    size_t prefix_len = prefix != NULL ? strlen(prefix) : 0;
+    size_t strip = flags & TAR_EXTRACT_STRIP_PREFIX ? prefix_len : 0;
+    ssize_t count = 0;
+    int ret;
+
+    if (iter_init(&it, tar_fd, EXTRACT_WINDOW) == -1) {
+        return -4;
+    }
+    while ((ret = iter_next(&it, &entry)) == 1) {
+        int valid = entry.pax_blocks != 0 ? validate_member_header(entry_pax_header(&entry)) : 0;
+        if (valid == 0) {
+            valid = validate_member_header(entry.header);
+        }
+        if (valid != 0) {
+            count = valid;
+            break;
+        }
+        if (!extract_match(entry.path, entry.path_len, prefix, prefix_len)) {
+            continue;
+        }
+
+        struct extract_list *list = entry.type == DIRTYPE ? dirs
+                                    : is_file_type(entry.type) ? files
+                                    : entry.type == SYMTYPE || entry.type == LNKTYPE ? links
+                                    : NULL;
+        char *path;
+        int r = list != NULL ? extract_path(entry.path, entry.path_len, strip, &path) : 1;
+        if (r == 1) {
+            continue;  // type non extrait (périphérique, tube...) ou chemin hors de la destination
+        }
+        struct extract_item *item = r == 0 ? extract_push(list) : NULL;
+        if (item == NULL) {
+            if (r == 0) {
+                free(path);
+            }
+            count = -4;
+            break;
+        }
+        item->path = path;
+        item->type = entry.type;
+        item->sparse = entry.sparse;
+        item->mode = entry.mode;
+        item->mtime = entry.mtime;
+        item->size = entry.size;
+        item->data_offset = entry.data_offset;
+        count++;
+
+        if (list == links) {
+            char linkname[sizeof(entry.header->linkname) + 1];
+            header_linkname(entry.header, linkname);
+            size_t link_len = strlen(linkname);
+            if (entry.type == LNKTYPE) {
+                // La cible d'un lien physique est une entrée de l'archive, elle suit le même chemin que les autres
+                size_t link_strip = extract_match(linkname, link_len, prefix, prefix_len) ? strip : 0;
+                r = extract_path(linkname, link_len, link_strip, &item->target);
+            } else {
+                item->target = strdup(linkname);
+                r = item->target == NULL ? -1 : 0;
+            }
+            if (r != 0) {
+                errno = r == 1 ? EINVAL : errno;
+                count = -4;
+                break;
+            }
+        }
+        if (extract_mkdirs(dest_fd, path) == -1 || (list == dirs && extract_mkdir(dest_fd, path) == -1)) {
+            count = -4;
+            break;
+        }
+    }
+    if (ret == -1) {
+        count = -4;
+    }
+    iter_destroy(&it);
+    return count;
+}
+
+/**
+ * Extracts an archive, or a subtree of it, to a directory.
+ *
+ * Directories are created first, then regular files are written by a pool of threads, their data being copied from
+ * the archive by the kernel (copy_file_range(), or sendfile()) without going through user space. Large files are
+ * preallocated and sparse files are written with their holes. Links are created last, and the modes and modification
+ * times of the headers are applied. Entries whose path contains a ".." component are skipped, leading '/' are
+ * removed, and devices and FIFOs are not extracted. Existing files are replaced, but existing symlinks are never
+ * followed: one in place of a directory is replaced by that directory, and one in place of a parent directory of an
+ * entry makes the extraction fail, so that nothing is written outside dest_dir. Unlike check_archive(), the GNU
+ * magic, "ustar  ", is accepted, so that GNU archives and their sparse files can be extracted.
+ *
+ * Outside the subtree, only the headers are looked at: the data of the skipped entries is jumped over.
+ *
+ * @param tar_fd A file descriptor pointing to a tar archive file. Its file offset is not used nor modified.
+ * @param subtree_prefix The entry to extract with its content, e.g. "dir/" or "dir", NULL or "" for the whole archive.
+ * @param dest_dir The directory to extract to, which must exist.
+ * @param options The number of threads and TAR_EXTRACT_* flags, NULL for the defaults.
+ *
+ * @return the number of entries extracted,
+ *         -1 if an archive header contains an invalid magic value,
+ *         -2 if an archive header contains an invalid version value,
+ *         -3 if an archive header contains an invalid checksum value,
+ *         -4 if the archive could not be read or an entry could not be created (errno is then set).
+ *         Nothing is undone on error.
+ */
+ssize_t tar_extract(int tar_fd, const char *subtree_prefix, const char *dest_dir,
+                    const tar_extract_options_t *options) {
+    struct extract_list dirs = {0}, files = {0}, links = {0};
+    int nthreads = options != NULL ? options->nthreads : 0;
+    int flags = options != NULL ? options->flags : 0;
+    int error = 0;
+
+    int dest_fd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dest_fd == -1) {
+        return -4;
+    }
+    ssize_t count = extract_walk(tar_fd, dest_fd, subtree_prefix, flags, &dirs, &files, &links);
+    if (count < 0) {
+        error = errno;
+        goto out;
+    }
+
+    // Écriture des fichiers réguliers par le groupe de threads, le thread appelant compris
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? cpus : 1;
+    }
+    if ((size_t)nthreads > files.n) {
+        nthreads = files.n > 0 ? files.n : 1;
+    }
+    struct extract_shared shared = {
+        .tar_fd = tar_fd,
+        .dest_fd = dest_fd,
+        .files = &files,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+    };
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < nthreads - 1
+           && pthread_create(&threads[started], NULL, extract_worker, &shared) == 0) {
+        started++;
+    }
+    extract_worker(&shared);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    if (shared.error != 0) {
+        error = shared.error;
+        count = -4;
+        goto out;
+    }
+
+    // Les liens physiques d'abord, tant qu'aucun lien symbolique de l'archive ne peut détourner leurs chemins
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < links.n; i++) {
+            struct extract_item *item = &links.items[i];
+            if ((item->type == LNKTYPE) != (pass == 0)) {
+                continue;
+            }
+            if (extract_check_parents(dest_fd, item->path) == -1
+                || (item->type == LNKTYPE && extract_check_parents(dest_fd, item->target) == -1)
+                || (unlinkat(dest_fd, item->path, 0) == -1 && errno != ENOENT)
+                || (item->type == LNKTYPE ? linkat(dest_fd, item->target, dest_fd, item->path, 0)
+                                          : symlinkat(item->target, dest_fd, item->path)) == -1) {
+                error = errno;
+                count = -4;
+                goto out;
+            }
+        }
+    }
+
+    // Modes des répertoires, les plus profonds d'abord
+    for (size_t i = dirs.n; i > 0; i--) {
+        if (fchmodat(dest_fd, dirs.items[i - 1].path, dirs.items[i - 1].mode, 0) == -1) {
+            error = errno;
+            count = -4;
+            goto out;
+        }
+    }
+
+out:
+    extract_free(&dirs);
+    extract_free(&files);
+    extract_free(&links);
+    close(dest_fd);
+    errno = error;
+    return count;
+}
+
+/*
+ * Écriture d'archives.
+ *
+ * Les en-têtes et les données des petits fichiers sont construits dans une arène et émis par lots avec writev(),
+ * le bourrage pointant vers un bloc de zéros partagé. Les données des gros fichiers sont copiées par le noyau
+ * (copy_file_range(), sendfile() à défaut). Un en-tête pax précède l'en-tête ustar quand le chemin, la cible d'un lien
+ * ou la taille ne tiennent pas dans ses champs.
+ */
+#define WRITER_ARENA (256 * 1024)
+#define WRITER_IOV 256
+#define WRITER_INLINE_MAX (32 * 1024)
+#define WRITER_PREFETCH 64
+#define USTAR_SIZE_MAX 077777777777ULL
+#define USTAR_ID_MAX 07777777
+
+static const uint8_t zero_blocks[2 * BLOCK_SIZE];
+
+struct tar_writer {
+    int out_fd;
+    int error;            // errno de la première erreur d'écriture, l'archive est alors inutilisable
+    time_t mtime;         // date des entrées qui ne viennent pas d'un fichier
+    uint8_t *arena;       // en-têtes et petites données en attente d'écriture
+    size_t arena_len;
+    struct iovec iov[WRITER_IOV];
+    int n_iov;
+    char *pax;            // enregistrements de l'en-tête pax en cours de construction
+    size_t pax_cap;
+    uint8_t *scratch;     // données d'un petit fichier, lues avant la construction de son en-tête
+};
+
+/* Écrit tous les segments en attente, retourne 0 ou -1 */
+static int writer_flush(tar_writer_t *w) {
+    struct iovec *iov = w->iov;
+    int n = w->n_iov;
+
+    while (n > 0) {
+        ssize_t written = writev(w->out_fd, iov, n);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            w->error = errno;
+            return -1;
+        }
+        while (n > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    w->n_iov = 0;
+    w->arena_len = 0;
+    return 0;
+}
+
+/* Ajoute un segment à écrire, fusionné avec le précédent s'il le prolonge */
+static int writer_queue(tar_writer_t *w, const void *data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    struct iovec *last = w->n_iov > 0 ? &w->iov[w->n_iov - 1] : NULL;
+    if (last != NULL && (const uint8_t *)last->iov_base + last->iov_len == data) {
+        last->iov_len += len;
+        return 0;
+    }
+    if (w->n_iov == WRITER_IOV && writer_flush(w) == -1) {
+        return -1;
+    }
+    w->iov[w->n_iov].iov_base = (void *)data;
+    w->iov[w->n_iov].iov_len = len;
+    w->n_iov++;
+    return 0;
+}
+
+/* Réserve len octets dans l'arène, en vidant d'abord les écritures en attente si elle est pleine */
+static uint8_t *writer_reserve(tar_writer_t *w, size_t len) {
+    if (len > WRITER_ARENA) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    if (w->arena_len + len > WRITER_ARENA && writer_flush(w) == -1) {
+        return NULL;
+    }
+    uint8_t *p = w->arena + w->arena_len;
+    w->arena_len += len;
+    return p;
+}
+
+/* Ajoute un enregistrement "<longueur> <clé>=<valeur>\n" à l'en-tête pax en cours, retourne sa nouvelle taille */
+static ssize_t pax_append(tar_writer_t *w, size_t pax_len, const char *key, const char *value, size_t value_len) {
+    size_t body = 1 + strlen(key) + 1 + value_len + 1;
+    size_t rec_len = body + 1;
+    // La longueur compte ses propres chiffres
+    for (size_t digits = 1, power = 10; ; digits++, power *= 10) {
+        if (body + digits < power) {
+            rec_len = body + digits;
+            break;
+        }
+    }
+    if (pax_len + rec_len + 1 > w->pax_cap) {
+        size_t cap = (pax_len + rec_len + 1) * 2;
+        char *pax = realloc(w->pax, cap);
+        if (pax == NULL) {
+            return -1;
+        }
+        w->pax = pax;
+        w->pax_cap = cap;
+    }
+    int n = snprintf(w->pax + pax_len, w->pax_cap - pax_len, "%zu %s=", rec_len, key);
+    memcpy(w->pax + pax_len + n, value, value_len);
+    w->pax[pax_len + rec_len - 1] = '\n';
+    return pax_len + rec_len;
+}
+
+/* Découpe un chemin entre les champs prefix et name, retourne la longueur du préfixe ou -1 s'il ne tient pas */
+static ssize_t ustar_split(const char *path, size_t len) {
+    if (len <= sizeof(((tar_header_t *)0)->name)) {
+        return 0;
+    }
+    // Le '/' de séparation n'est pas stocké ; un '/' final appartient au nom
+    size_t search = len - 1;
+    while (search > 0) {
+        search--;
+        if (path[search] == '/') {
+            size_t name_len = len - search - 1;
+            if (name_len > sizeof(((tar_header_t *)0)->name)) {
+                return -1;
+            }
+            if (search <= sizeof(((tar_header_t *)0)->prefix)) {
+                return search;
+            }
+        }
+    }
+    return -1;
+}
+
+static void octal_field(char *field, size_t size, uint64_t value) {
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%0*llo", (int)size - 1, (unsigned long long)value);
+    memcpy(field, tmp, size);
+}
+
+/*
+ * Ajoute à l'arène les en-têtes d'une entrée, suivis de data_len octets réservés pour ses données et leur bourrage.
+ * Retourne l'adresse de ces octets, ou NULL en cas d'erreur.
+ */
+static uint8_t *writer_header(tar_writer_t *w, const char *path, char type, mode_t mode, uid_t uid, gid_t gid,
+                              uint64_t size, time_t mtime, const char *linkname, size_t data_len) {
+    size_t path_len = strlen(path);
+    size_t link_len = linkname != NULL ? strlen(linkname) : 0;
+    // Les lecteurs de la bibliothèque ignorent les chemins pax trop longs et ne lisent pas les cibles pax : de tels
+    // chemins et cibles ne pourraient pas être relus
+    if (path_len >= HEADER_PATH_MAX || link_len > sizeof(((tar_header_t *)0)->linkname)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    ssize_t prefix_len = ustar_split(path, path_len);
+    ssize_t pax_len = 0;
+
+    if (prefix_len == -1) {
+        pax_len = pax_append(w, pax_len, "path", path, path_len);
+    }
+    if (pax_len != -1 && size > USTAR_SIZE_MAX) {
+        char digits[24];
+        int n = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)size);
+        pax_len = pax_append(w, pax_len, "size", digits, n);
+    }
+    if (pax_len == -1) {
+        return NULL;
+    }
+
+    size_t headers = (pax_len > 0 ? BLOCK_SIZE + padded_size(pax_len) : 0) + BLOCK_SIZE;
+    uint8_t *p = writer_reserve(w, headers + padded_size(data_len));
+    if (p == NULL) {
+        return NULL;
+    }
+    memset(p, 0, headers);
+    tar_header_t *hdr = (tar_header_t *)p;
+    if (pax_len > 0) {
+        // L'en-tête pax porte un nom arbitraire, les lecteurs qui l'ignorent en extraient un fichier
+        snprintf(hdr->name, sizeof(hdr->name), "PaxHeaders/%.80s", path + (path_len > 80 ? path_len - 80 : 0));
+        octal_field(hdr->mode, sizeof(hdr->mode), 0644);
+        octal_field(hdr->uid, sizeof(hdr->uid), 0);
+        octal_field(hdr->gid, sizeof(hdr->gid), 0);
+        octal_field(hdr->size, sizeof(hdr->size), pax_len);
+        octal_field(hdr->mtime, sizeof(hdr->mtime), mtime > 0 ? mtime : 0);
+        hdr->typeflag = XHDTYPE;
+        memcpy(hdr->magic, TMAGIC, TMAGLEN);
+        memcpy(hdr->version, TVERSION, TVERSLEN);
+        snprintf(hdr->chksum, sizeof(hdr->chksum), "%06o", tar_header_chksum(hdr));
+        hdr->chksum[7] = ' ';
+        memcpy(p + BLOCK_SIZE, w->pax, pax_len);
+        hdr = (tar_header_t *)(p + BLOCK_SIZE + padded_size(pax_len));
+    }
+
+    if (prefix_len > 0) {
+        memcpy(hdr->prefix, path, prefix_len);
+        memcpy(hdr->name, path + prefix_len + 1, path_len - prefix_len - 1);
+    } else {
+        // Chemin trop long : le nom ustar n'en garde que la fin, l'en-tête pax donne le chemin complet
+        size_t name_len = path_len < sizeof(hdr->name) ? path_len : sizeof(hdr->name);
+        memcpy(hdr->name, path + path_len - name_len, name_len);
+    }
+    octal_field(hdr->mode, sizeof(hdr->mode), mode & 07777);
+    octal_field(hdr->uid, sizeof(hdr->uid), uid <= USTAR_ID_MAX ? uid : 0);
+    octal_field(hdr->gid, sizeof(hdr->gid), gid <= USTAR_ID_MAX ? gid : 0);
+    octal_field(hdr->size, sizeof(hdr->size), size <= USTAR_SIZE_MAX ? size : 0);
+    octal_field(hdr->mtime, sizeof(hdr->mtime), mtime > 0 ? mtime : 0);
+    hdr->typeflag = type;
+    if (link_len > 0) {
+        memcpy(hdr->linkname, linkname, link_len);
+    }
+    memcpy(hdr->magic, TMAGIC, TMAGLEN);
+    memcpy(hdr->version, TVERSION, TVERSLEN);
+    snprintf(hdr->chksum, sizeof(hdr->chksum), "%06o", tar_header_chksum(hdr));
+    hdr->chksum[7] = ' ';
+
+    // Le bourrage des données réservées est mis à zéro dès maintenant
+    memset(p + headers + data_len, 0, padded_size(data_len) - data_len);
+    if (writer_queue(w, p, headers + padded_size(data_len)) == -1) {
+        return NULL;
+    }
+    return p + headers;
+}
+
+/* Copie len octets de in_fd à la suite de l'archive, dans le noyau quand c'est possible */
+static int writer_copy(tar_writer_t *w, int in_fd, uint64_t len) {
+    loff_t in_pos = 0;
+
+    while (len > 0) {
+        ssize_t n = copy_file_range(in_fd, &in_pos, w->out_fd, NULL, len, 0);
+        if (n == -1 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            break;
+        }
+        if (n <= 0) {
+            errno = n == 0 ? EIO : errno;  // fichier raccourci pendant l'écriture
+            return -1;
+        }
+        len -= n;
+    }
+    while (len > 0) {
+        off_t pos = in_pos;
+        ssize_t n = sendfile(w->out_fd, in_fd, &pos, len);
+        if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            break;
+        }
+        if (n <= 0) {
+            errno = n == 0 ? EIO : errno;
+            return -1;
+        }
+        in_pos = pos;
+        len -= n;
+    }
+    while (len > 0) {
+        // Dernier recours : copie par l'arène, vide à ce moment
+        size_t chunk = len < WRITER_ARENA ? len : WRITER_ARENA;
+        ssize_t n = read_at_fd(&in_fd, w->arena, chunk, in_pos);
+        if (n != (ssize_t)chunk) {
+            errno = n >= 0 ? EIO : errno;
+            return -1;
+        }
+        if (writer_queue(w, w->arena, chunk) == -1 || writer_flush(w) == -1) {
+            return -1;
+        }
+        in_pos += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/* Chemin d'un répertoire dans l'archive, avec son '/' final, à libérer par l'appelant */
+static char *dir_path(const char *path) {
+    size_t len = strlen(path);
+    char *out = malloc(len + 2);
+    if (out != NULL) {
+        memcpy(out, path, len);
+        out[len] = '/';
+        out[len + (len == 0 || path[len - 1] != '/')] = '\0';
+    }
+    return out;
+}
+
+/* Ajoute une entrée décrite par st ; fd est le fichier ouvert pour un fichier régulier, src_path sert aux liens */
+static int writer_add(tar_writer_t *w, const char *src_path, const char *archive_path, int fd, const struct stat *st) {
+    if (S_ISDIR(st->st_mode)) {
+        char *path = dir_path(archive_path);
+        int ret = path != NULL && writer_header(w, path, DIRTYPE, st->st_mode, st->st_uid, st->st_gid, 0,
+                                                st->st_mtime, NULL, 0) != NULL ? 0 : -1;
+        free(path);
+        return ret;
+    }
+    if (S_ISLNK(st->st_mode)) {
+        char target[4096];
+        ssize_t n = readlink(src_path, target, sizeof(target) - 1);
+        if (n == -1) {
+            return -1;
+        }
+        target[n] = '\0';
+        return writer_header(w, archive_path, SYMTYPE, st->st_mode, st->st_uid, st->st_gid, 0, st->st_mtime,
+                             target, 0) != NULL ? 0 : -1;
+    }
+    if (!S_ISREG(st->st_mode)) {
+        errno = EINVAL;  // les périphériques, tubes et sockets ne sont pas archivés
+        return -1;
+    }
+
+    uint64_t size = st->st_size;
+    if (size <= WRITER_INLINE_MAX) {
+        // Petit fichier : lu avant son en-tête, pour qu'un échec ne laisse pas d'entrée incomplète, puis écrit avec le
+        // lot suivant
+        ssize_t n = read_at_fd(&fd, w->scratch, size, 0);
+        if (n != (ssize_t)size) {
+            errno = n >= 0 ? EIO : errno;
+            return -1;
+        }
+        uint8_t *data = writer_header(w, archive_path, REGTYPE, st->st_mode, st->st_uid, st->st_gid, size,
+                                      st->st_mtime, NULL, size);
+        if (data == NULL) {
+            return -1;
+        }
+        memcpy(data, w->scratch, size);
+        return 0;
+    }
+
+    if (writer_header(w, archive_path, REGTYPE, st->st_mode, st->st_uid, st->st_gid, size, st->st_mtime, NULL, 0)
+        == NULL || writer_flush(w) == -1) {
+        return -1;
+    }
+    // L'en-tête est écrit : un échec de la copie laisse une archive inutilisable
+    if (writer_copy(w, fd, size) == -1) {
+        w->error = errno;
+        return -1;
+    }
+    return writer_queue(w, zero_blocks, padded_size(size) - size);
+}
+
+/**
+ * Creates a writer producing a tar archive, in the format accepted by check_archive().
+ *
+ * @param out_fd A file descriptor open for writing, a regular file, a pipe or a socket. The archive is written from
+ *               its current position; it is not closed by tar_writer_close().
+ *
+ * @return a newly allocated writer to be released with tar_writer_close(),
+ *         NULL if memory could not be allocated.
+ */
+tar_writer_t *tar_writer_open(int out_fd) {
+    tar_writer_t *w = calloc(1, sizeof(tar_writer_t));
+    if (w == NULL) {
+        return NULL;
+    }
+    w->out_fd = out_fd;
+    w->mtime = time(NULL);
+    w->arena = malloc(WRITER_ARENA);
+    w->scratch = malloc(WRITER_INLINE_MAX);
+    if (w->arena == NULL || w->scratch == NULL) {
+        free(w->arena);
+        free(w->scratch);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+/* Refuse toute nouvelle entrée après une erreur d'écriture */
+static int writer_failed(const tar_writer_t *w) {
+    if (w->error != 0) {
+        errno = w->error;
+        return 1;
+    }
+    return 0;
+}
+
+/* Ouvre et décrit un fichier à archiver, fd valant -1 si ce n'est pas un fichier régulier */
+static int writer_prepare(const char *src_path, int *fd, struct stat *st) {
+    *fd = -1;
+    if (lstat(src_path, st) == -1) {
+        return -1;
+    }
+    if (S_ISREG(st->st_mode)) {
+        *fd = open(src_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        // La taille archivée est celle du fichier ouvert
+        if (*fd == -1 || fstat(*fd, st) == -1) {
+            int err = errno;
+            if (*fd != -1) {
+                close(*fd);
+            }
+            errno = err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Adds a file of the file system to the archive: a regular file with its content, a directory, or a symlink, which is
+ * stored as such and not followed. The mode, owner and modification time of the file are kept.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param src_path The path of the file to add.
+ * @param archive_path The path of the entry in the archive.
+ *
+ * @return zero on success,
+ *         -1 if the file could not be read, is of another type, its archive path is longer than 256 bytes or, for a
+ *         symlink, its target longer than 100 bytes (ENAMETOOLONG, the longest this library reads back), or the
+ *         archive could not be written (errno is then set). After a write error the archive is unusable and every
+ *         later call fails.
+ */
+int tar_add_file(tar_writer_t *w, const char *src_path, const char *archive_path) {
+    int fd;
+    struct stat st;
+
+    if (writer_failed(w) || writer_prepare(src_path, &fd, &st) == -1) {
+        return -1;
+    }
+    int ret = writer_add(w, src_path, archive_path, fd, &st);
+    if (fd != -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+    }
+    return ret;
+}
+
+struct writer_input {
+    int fd;
+    int error;            // errno de l'ouverture, zéro si elle a réussi
+    int ready;
+    struct stat st;
+};
+
+struct writer_prefetch {
+    const char *const *src_paths;
+    size_t n;
+    struct writer_input *inputs;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;  // signalée quand une entrée est prête ou consommée
+    size_t next;          // prochaine entrée à préparer
+    size_t consumed;      // entrées déjà ajoutées à l'archive
+    int stop;
+};
+
+static void *writer_prefetch_worker(void *arg) {
+    struct writer_prefetch *pf = arg;
+
+    while (1) {
+        pthread_mutex_lock(&pf->lock);
+        // Pas plus de WRITER_PREFETCH fichiers ouverts d'avance
+        while (!pf->stop && pf->next < pf->n && pf->next >= pf->consumed + WRITER_PREFETCH) {
+            pthread_cond_wait(&pf->cond, &pf->lock);
+        }
+        if (pf->stop || pf->next >= pf->n) {
+            pthread_mutex_unlock(&pf->lock);
+            return NULL;
+        }
+        size_t i = pf->next++;
+        pthread_mutex_unlock(&pf->lock);
+
+        struct writer_input input;
+        input.error = writer_prepare(pf->src_paths[i], &input.fd, &input.st) == -1 ? errno : 0;
+        input.ready = 1;
+
+        pthread_mutex_lock(&pf->lock);
+        pf->inputs[i] = input;
+        pthread_cond_broadcast(&pf->cond);
+        pthread_mutex_unlock(&pf->lock);
+    }
+}
+
+/**
+ * Adds several files of the file system to the archive, as tar_add_file() would one after the other. The files are
+ * opened and stat'ed by a pool of threads ahead of the writing, which follows the order of the arrays so that the
+ * archive does not depend on the scheduling.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param src_paths The paths of the files to add.
+ * @param archive_paths The paths of the entries in the archive, in the same order.
+ * @param n The number of files.
+ * @param nthreads The number of threads opening files, zero or a negative value uses one per online CPU.
+ *
+ * @return zero on success,
+ *         -1 on the first file that could not be added, see tar_add_file(). The files before it are in the archive.
+ */
+int tar_add_files(tar_writer_t *w, const char *const *src_paths, const char *const *archive_paths, size_t n,
+                  int nthreads) {
+    if (writer_failed(w)) {
+        return -1;
+    }
+    if (nthreads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? cpus : 1;
+    }
+    if ((size_t)nthreads > n) {
+        nthreads = n;
+    }
+
+    struct writer_prefetch pf = {
+        .src_paths = src_paths,
+        .n = n,
+        .inputs = calloc(n > 0 ? n : 1, sizeof(struct writer_input)),
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+    pthread_t *threads = malloc((nthreads > 0 ? nthreads : 1) * sizeof(pthread_t));
+    if (pf.inputs == NULL || threads == NULL) {
+        free(pf.inputs);
+        free(threads);
+        return -1;
+    }
+    int started = 0;
+    while (started < nthreads && pthread_create(&threads[started], NULL, writer_prefetch_worker, &pf) == 0) {
+        started++;
+    }
+
+    int ret = 0;
+    size_t i;
+    for (i = 0; i < n && ret == 0; i++) {
+        struct writer_input *input = &pf.inputs[i];
+        if (started == 0) {
+            // Sans thread, chaque fichier est préparé juste avant d'être écrit
+            input->error = writer_prepare(src_paths[i], &input->fd, &input->st) == -1 ? errno : 0;
+        } else {
+            pthread_mutex_lock(&pf.lock);
+            while (!input->ready) {
+                pthread_cond_wait(&pf.cond, &pf.lock);
+            }
+            pthread_mutex_unlock(&pf.lock);
+        }
+
+        if (input->error != 0) {
+            errno = input->error;
+            ret = -1;
+        } else {
+            ret = writer_add(w, src_paths[i], archive_paths[i], input->fd, &input->st);
+        }
+        int err = errno;
+        if (input->fd != -1) {
+            close(input->fd);
+            input->fd = -1;
+        }
+        errno = err;
+
+        pthread_mutex_lock(&pf.lock);
+        pf.consumed = i + 1;
+        pthread_cond_broadcast(&pf.cond);
+        pthread_mutex_unlock(&pf.lock);
+    }
+
+    int err = errno;
+    pthread_mutex_lock(&pf.lock);
+    pf.stop = 1;
+    pthread_cond_broadcast(&pf.cond);
+    pthread_mutex_unlock(&pf.lock);
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    // Fichiers ouverts d'avance et jamais écrits, après une erreur
+    for (; i < n; i++) {
+        if (pf.inputs[i].ready && pf.inputs[i].error == 0 && pf.inputs[i].fd != -1) {
+            close(pf.inputs[i].fd);
+        }
+    }
+    free(threads);
+    free(pf.inputs);
+    pthread_mutex_destroy(&pf.lock);
+    pthread_cond_destroy(&pf.cond);
+    errno = err;
+    return ret;
+}
+
+/**
+ * Adds a directory entry to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the directory in the archive, a '/' is appended if it has none.
+ * @param mode The permission bits of the directory.
+ *
+ * @return zero on success,
+ *         -1 if the path, '/' included, is longer than 256 bytes (errno is then set to ENAMETOOLONG) or the archive
+ *         could not be written (errno is then set).
+ */
+int tar_add_dir(tar_writer_t *w, const char *archive_path, mode_t mode) {
+    if (writer_failed(w)) {
+        return -1;
+    }
+    char *path = dir_path(archive_path);
+    if (path == NULL) {
+        return -1;
+    }
+    uint8_t *p = writer_header(w, path, DIRTYPE, mode, 0, 0, 0, w->mtime, NULL, 0);
+    free(path);
+    return p != NULL ? 0 : -1;
+}
+
+/**
+ * Adds a symlink entry to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the symlink in the archive.
+ * @param target The path the symlink points to.
+ *
+ * @return zero on success,
+ *         -1 if the path is longer than 256 bytes or the target longer than 100 bytes (errno is then set to
+ *         ENAMETOOLONG) or the archive could not be written (errno is then set).
+ */
+int tar_add_symlink(tar_writer_t *w, const char *archive_path, const char *target) {
+    if (writer_failed(w)) {
+        return -1;
+    }
+    return writer_header(w, archive_path, SYMTYPE, 0777, 0, 0, 0, w->mtime, target, 0) != NULL ? 0 : -1;
+}
+
+/**
+ * Adds a regular file with the given content to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the file in the archive.
+ * @param data The content of the file, which can be reused as soon as the call returns.
+ * @param len The size of data.
+ * @param mode The permission bits of the file.
+ *
+ * @return zero on success,
+ *         -1 if the path is longer than 256 bytes (errno is then set to ENAMETOOLONG) or the archive could not be
+ *         written (errno is then set).
+ */
+int tar_add_buffer(tar_writer_t *w, const char *archive_path, const void *data, size_t len, mode_t mode) {
+    if (writer_failed(w)) {
+        return -1;
+    }
+    if (len <= WRITER_INLINE_MAX) {
+        uint8_t *dest = writer_header(w, archive_path, REGTYPE, mode, 0, 0, len, w->mtime, NULL, len);
+        if (dest == NULL) {
+            return -1;
+        }
+        memcpy(dest, data, len);
+        return 0;
+    }
+    // Un gros tampon est écrit sans copie, avant le retour puisqu'il appartient à l'appelant
+    if (writer_header(w, archive_path, REGTYPE, mode, 0, 0, len, w->mtime, NULL, 0) == NULL
+        || writer_queue(w, data, len) == -1 || writer_queue(w, zero_blocks, padded_size(len) - len) == -1) {
+        return -1;
+    }
+    return writer_flush(w);
+}
+
+/**
+ * Writes the end of the archive and releases a writer.
+ *
+ * @param w The writer to release, may be NULL.
+ *
+ * @return zero if the whole archive was written,
+ *         -1 if an earlier call failed to write or the end of the archive could not be written (errno is then set).
+ */
+int tar_writer_close(tar_writer_t *w) {
+    if (w == NULL) {
+        return 0;
+    }
+    int ret = writer_failed(w) || writer_queue(w, zero_blocks, sizeof(zero_blocks)) == -1 || writer_flush(w) == -1
+              ? -1 : 0;
+    int err = errno;
+    free(w->arena);
+    free(w->scratch);
+    free(w->pax);
+    free(w);
+    errno = err;
+    return ret;
+}
+
+/*
+ * Superposition d'archives.
+ *
+ * Chaque couche garde un filtre de Bloom des chemins de ses entrées (sans '/' final), construit en un parcours de ses
+ * en-têtes à l'ouverture, et la liste triée de ses whiteouts. Une recherche interroge les couches de la plus haute à la
+ * plus basse : une couche dont le filtre ne contient pas le chemin est passée sans accès disque, les autres sont
+ * consultées dans leur index, construit à la première recherche qui en a besoin. Un whiteout ".wh.<nom>" masque <nom>
+ * et son contenu dans les couches inférieures, un ".wh..wh..opq" masque tout le contenu de son répertoire.
+ */
+#define BLOOM_BITS_PER_ENTRY 10
+#define BLOOM_HASHES 7
+#define WHITEOUT_PREFIX ".wh."
+#define WHITEOUT_OPAQUE ".wh..wh..opq"
+
+struct overlay_layer {
+    int tar_fd;
+    uint64_t *bloom;
+    uint64_t bloom_mask;  // nombre de bits du filtre moins un, une puissance de 2 moins un
+    char **hidden;        // chemins masqués dans les couches inférieures, triés
+    size_t n_hidden;
+    char **opaque;        // répertoires dont le contenu des couches inférieures est masqué, triés
+    size_t n_opaque;
+    pthread_mutex_t lock;
+    tar_index_t *index;   // construit à la première recherche positive dans le filtre
+};
+
+struct tar_overlay {
+    struct overlay_layer *layers;   // de la plus haute à la plus basse
+    size_t n_layers;
+};
+
+/* FNV-1a 64 bits, dont les deux moitiés donnent les positions du filtre par double hachage */
+static uint64_t overlay_hash(const char *path, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)path[i]) * 1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+static int bloom_maybe(const struct overlay_layer *layer, uint64_t hash) {
+    uint64_t h1 = hash, h2 = (hash >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) & layer->bloom_mask;
+        if (!(layer->bloom[bit / 64] & (1ULL << (bit % 64)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void bloom_add(struct overlay_layer *layer, uint64_t hash) {
+    uint64_t h1 = hash, h2 = (hash >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) & layer->bloom_mask;
+        layer->bloom[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+static int compare_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int sorted_contains(char *const *array, size_t n, const char *key) {
+    return n > 0 && bsearch(&key, array, n, sizeof(char *), compare_str) != NULL;
+}
+
+/* Ajoute une copie de len octets de path à un tableau de chaînes */
+static int strings_push(char ***array, size_t *n, const char *path, size_t len) {
+    if ((*n & (*n - 1)) == 0) {
+        char **grown = realloc(*array, (*n ? *n * 2 : 1) * sizeof(char *));
+        if (grown == NULL) {
+            return -1;
+        }
+        *array = grown;
+    }
+    char *copy = strndup(path, len);
+    if (copy == NULL) {
+        return -1;
+    }
+    (*array)[(*n)++] = copy;
+    return 0;
+}
+
+/* Normalise un chemin en clé de recherche : pas de '/' final, "" pour la racine */
+static ssize_t overlay_key(const char *path, size_t len, char *out) {
+    ssize_t key_len = normalize_path(path, len, out, RESOLVE_PATH_MAX);
+    if (key_len > 0 && out[key_len - 1] == '/') {
+        out[--key_len] = '\0';
+    }
+    return key_len;
+}
+
+/* Parcourt les en-têtes d'une couche pour remplir son filtre et ses listes de whiteouts */
+static int overlay_scan(struct overlay_layer *layer) {
+    tar_iter_t it;
+    tar_entry_t entry;
+    uint64_t *hashes = NULL;
+    size_t n = 0, cap = 0;
+    char key[RESOLVE_PATH_MAX];
+    int ret;
+
+    if (iter_init(&it, layer->tar_fd, 0) == -1) {
+        return -1;
+    }
+    while ((ret = iter_next(&it, &entry)) == 1) {
+        ssize_t key_len = overlay_key(entry.path, entry.path_len, key);
+        if (key_len <= 0) {
+            continue;
+        }
+        size_t dir_len = parent_len(key, key_len);
+        const char *base = key + dir_len;
+        size_t base_len = key_len - dir_len;
+        int pushed = 0;
+
+        if (base_len == strlen(WHITEOUT_OPAQUE) && memcmp(base, WHITEOUT_OPAQUE, base_len) == 0) {
+            // Le répertoire est gardé sans son '/' final, comme les clés
+            pushed = strings_push(&layer->opaque, &layer->n_opaque, key, dir_len > 0 ? dir_len - 1 : 0);
+        } else if (base_len > strlen(WHITEOUT_PREFIX) && memcmp(base, WHITEOUT_PREFIX, strlen(WHITEOUT_PREFIX)) == 0) {
+            // "dir/.wh.name" devient "dir/name"
+            memmove(key + dir_len, base + strlen(WHITEOUT_PREFIX), base_len - strlen(WHITEOUT_PREFIX));
+            pushed = strings_push(&layer->hidden, &layer->n_hidden, key, key_len - strlen(WHITEOUT_PREFIX));
+        } else {
+            if (n == cap) {
+                cap = cap ? cap * 2 : 1024;
+                uint64_t *grown = realloc(hashes, cap * sizeof(uint64_t));
+                if (grown == NULL) {
+                    pushed = -1;
+                } else {
+                    hashes = grown;
+                }
+            }
+            if (pushed == 0) {
+                hashes[n++] = overlay_hash(key, key_len);
+            }
+        }
+        if (pushed == -1) {
+            ret = -1;
+            break;
+        }
+    }
+    iter_destroy(&it);
+
+    // Environ BLOOM_BITS_PER_ENTRY bits par entrée, soit moins de 1 % de faux positifs avec 7 fonctions de hachage
+    uint64_t bits = 64;
+    while (bits < n * BLOOM_BITS_PER_ENTRY) {
+        bits *= 2;
+    }
+    layer->bloom = ret == 0 ? calloc(bits / 64, sizeof(uint64_t)) : NULL;
+    if (layer->bloom != NULL) {
+        layer->bloom_mask = bits - 1;
+        for (size_t i = 0; i < n; i++) {
+            bloom_add(layer, hashes[i]);
+        }
+        if (layer->n_hidden > 0) {
+            qsort(layer->hidden, layer->n_hidden, sizeof(char *), compare_str);
+        }
+        if (layer->n_opaque > 0) {
+            qsort(layer->opaque, layer->n_opaque, sizeof(char *), compare_str);
+        }
+    }
+    free(hashes);
+    return layer->bloom != NULL ? 0 : -1;
+}
+
+static const tar_index_t *overlay_index(struct overlay_layer *layer) {
+    tar_index_t *index = __atomic_load_n(&layer->index, __ATOMIC_ACQUIRE);
+    if (index == NULL) {
+        pthread_mutex_lock(&layer->lock);
+        index = layer->index;
+        if (index == NULL) {
+            index = tar_index_open(layer->tar_fd);
+            __atomic_store_n(&layer->index, index, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&layer->lock);
+    }
+    return index;
+}
+
+/* La couche masque-t-elle key dans les couches inférieures, par un whiteout de key ou d'un de ses parents ? */
+static int overlay_hides(const struct overlay_layer *layer, char *key, size_t key_len) {
+    if (layer->n_hidden == 0 && layer->n_opaque == 0) {
+        return 0;
+    }
+    if (sorted_contains(layer->hidden, layer->n_hidden, key)) {
+        return 1;
+    }
+    int hidden = layer->n_opaque > 0 && key_len > 0 && sorted_contains(layer->opaque, layer->n_opaque, "");
+    for (size_t i = 0; i < key_len && !hidden; i++) {
+        if (key[i] == '/') {
+            key[i] = '\0';
+            hidden = sorted_contains(layer->hidden, layer->n_hidden, key)
+                     || sorted_contains(layer->opaque, layer->n_opaque, key);
+            key[i] = '/';
+        }
+    }
+    return hidden;
+}
+
+/* Cherche une clé dans les couches, retourne l'entrée visible et son index, NULL si elle est absente ou masquée */
+static const index_entry_t *overlay_find(const tar_overlay_t *ov, char *key, size_t key_len,
+                                         const tar_index_t **found_index) {
+    uint64_t hash = overlay_hash(key, key_len);
+
+    for (size_t i = 0; i < ov->n_layers; i++) {
+        struct overlay_layer *layer = &ov->layers[i];
+        if (bloom_maybe(layer, hash)) {
+            const tar_index_t *index = overlay_index(layer);
+            const index_entry_t *entry = index != NULL ? index_lookup(index, key, key_len) : NULL;
+            if (entry != NULL) {
+                *found_index = index;
+                return entry;
+            }
+        }
+        if (overlay_hides(layer, key, key_len)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Suit les liens d'une couche à l'autre, comme index_resolve() : un lien peut être le dernier composant du chemin,
+ * suivi si follow est non nul, ou l'un de ses répertoires intermédiaires, toujours suivi. Chaque recherche, même d'un
+ * répertoire intermédiaire, tient compte des whiteouts de chaque couche. key reçoit le chemin de l'entrée finale.
+ */
+static const index_entry_t *overlay_resolve(const tar_overlay_t *ov, const char *path, int follow, char *key,
+                                            const tar_index_t **found_index) {
+    ssize_t key_len = overlay_key(path, strlen(path), key);
+
+    for (int hops = 0; key_len >= 0 && hops <= MAX_LINK_HOPS; hops++) {
+        const index_entry_t *entry = overlay_find(ov, key, key_len, found_index);
+        size_t prefix_len = 0;
+
+        if (entry == NULL) {
+            // Un répertoire intermédiaire du chemin est peut-être un lien, cherché sous sa propre clé
+            for (size_t i = 1; i < (size_t)key_len && entry == NULL; i++) {
+                if (key[i] == '/') {
+                    key[i] = '\0';
+                    entry = overlay_find(ov, key, i, found_index);
+                    key[i] = '/';
+                    if (entry != NULL && !is_link(entry->type)) {
+                        entry = NULL;
+                    }
+                    prefix_len = i;
                 }
+            }
+            if (entry == NULL) {
+                return NULL;
+            }
+        } else if (!is_link(entry->type) || !follow) {
+            return entry;
+        }
 
-                unsigned long file_size = strtol(header2.size, NULL, 8);
+        const tar_index_t *index = *found_index;
+        char target[RESOLVE_PATH_MAX];
+        ssize_t target_len = link_target(index->strings + entry->path_off, entry->path_len,
+                                         index->strings + entry->link_off, entry->type, target);
+        if (target_len < 0) {
+            break;
+        }
+        if (prefix_len > 0) {
+            key_len = splice_link(key, key_len, prefix_len, target, target_len);
+            if (key_len > 0 && key[key_len - 1] == '/') {
+                key[--key_len] = '\0';
+            }
+        } else {
+            key_len = overlay_key(target, target_len, key);
+        }
+    }
+    return NULL;
+}
 
-                // Vérification de l'offset
-                if (offset >= file_size || offset<0) {
-                    free(pathcpy);
-                    *len = 0;
-                    return -2;  // Offset trop grand
-                }
+/**
+ * Opens an overlay of several archives, as the layers of a container image: a path is looked up from the topmost
+ * layer down and the first layer holding it wins. Whiteout entries (".wh.<name>" hides <name> from the lower layers,
+ * ".wh..wh..opq" hides the whole content of its directory) are honoured, and are themselves invisible. As in an index,
+ * a symlink met as a directory of a path is followed, from layer to layer, by every function.
+ *
+ * The headers of each layer are read once to build a Bloom filter of its paths, so that a lookup skips, without any
+ * read, the layers that do not hold the path. The index of a layer is built the first time a lookup needs it.
+ *
+ * @param fds File descriptors pointing to valid tar archive files, from the topmost layer to the lowest. They must
+ *            stay open while the overlay is used.
+ * @param n The number of layers.
+ *
+ * @return a newly allocated overlay to be released with tar_overlay_close(),
+ *         NULL if a layer could not be read or memory could not be allocated.
+ */
+tar_overlay_t *tar_overlay_open(const int *fds, size_t n) {
+    tar_overlay_t *ov = calloc(1, sizeof(tar_overlay_t));
+    if (ov == NULL) {
+        return NULL;
+    }
+    ov->layers = calloc(n > 0 ? n : 1, sizeof(struct overlay_layer));
+    if (ov->layers == NULL) {
+        free(ov);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        struct overlay_layer *layer = &ov->layers[i];
+        layer->tar_fd = fds[i];
+        pthread_mutex_init(&layer->lock, NULL);
+        ov->n_layers++;
+        if (overlay_scan(layer) == -1) {
+            tar_overlay_close(ov);
+            return NULL;
+        }
+    }
+    return ov;
+}
 
+/**
+ * Releases an overlay opened by tar_overlay_open(). The file descriptors of the layers are not closed.
+ *
+ * @param ov The overlay to release, may be NULL.
+ */
+void tar_overlay_close(tar_overlay_t *ov) {
+    if (ov == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < ov->n_layers; i++) {
+        struct overlay_layer *layer = &ov->layers[i];
+        for (size_t j = 0; j < layer->n_hidden; j++) {
+            free(layer->hidden[j]);
+        }
+        for (size_t j = 0; j < layer->n_opaque; j++) {
+            free(layer->opaque[j]);
+        }
+        free(layer->hidden);
+        free(layer->opaque);
+        free(layer->bloom);
+        tar_index_close(layer->index);
+        pthread_mutex_destroy(&layer->lock);
+    }
+    free(ov->layers);
+    free(ov);
+}
 
-                size_t bytes_to_read = file_size - offset;
+/* Entrée visible à un chemin, sans suivre de lien au dernier composant */
+static const index_entry_t *overlay_entry(const tar_overlay_t *ov, const char *path) {
+    char key[RESOLVE_PATH_MAX];
+    const tar_index_t *index;
+    return overlay_resolve(ov, path, 0, key, &index);
+}
 
+/**
+ * Checks whether an entry exists in the overlay.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay,
+ *         any other value otherwise.
+ */
+int tar_overlay_exists(const tar_overlay_t *ov, const char *path) {
+    return overlay_entry(ov, path) != NULL;
+}
 
-                // Lire les données
+/**
+ * Checks whether an entry exists in the overlay and is a directory.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_dir(const tar_overlay_t *ov, const char *path) {
+    const index_entry_t *entry = overlay_entry(ov, path);
+    return entry != NULL && entry->type == DIRTYPE;
+}
 
-                if (bytes_to_read > *len) {
-                    bytes_to_read = *len;  // Ne pas dépasser la taille du tampon
-                }
+/**
+ * Checks whether an entry exists in the overlay and is a file.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a file,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_file(const tar_overlay_t *ov, const char *path) {
+    const index_entry_t *entry = overlay_entry(ov, path);
+    return entry != NULL && is_file_type(entry->type);
+}
 
-                if (lseek(tar_fd, offset, SEEK_CUR) == -1) {
-                    perror("Erreur lors du positionnement dans le fichier");
-                    free(pathcpy);
-                    return -1;
-                }
+/**
+ * Checks whether an entry exists in the overlay and is a symlink.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a symlink,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_symlink(const tar_overlay_t *ov, const char *path) {
+    const index_entry_t *entry = overlay_entry(ov, path);
+    return entry != NULL && is_link(entry->type);
+}
 
-                ssize_t bytes_read = read(tar_fd, dest, bytes_to_read);
-                if (bytes_read == -1) {
-                    perror("Erreur lors de la lecture des données");
-                    free(pathcpy);
-                    *len = 0;
-                    return -1;
-                }
-            
-                *len = bytes_read;
+/**
+ * Reads a file of the overlay, from the topmost layer that holds it. Symlinks are followed from layer to layer.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry to read from. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_overlay_read_file(const tar_overlay_t *ov, const char *path, size_t offset, uint8_t *dest, size_t *len) {
+    char key[RESOLVE_PATH_MAX];
+    const tar_index_t *index;
+    const index_entry_t *entry = overlay_resolve(ov, path, 1, key, &index);
+
+    if (entry == NULL || !is_file_type(entry->type)) {
+        *len = 0;
+        return -1;
+    }
+    // L'entrée finale n'est pas un lien : sa lecture dans sa couche ne suit plus rien
+    return tar_index_read_file(index, index->strings + entry->path_off, offset, dest, len);
+}
+
+/* Ensemble de noms déjà listés ou masqués, par adressage ouvert */
+struct name_set {
+    const char **names;
+    size_t *lens;
+    size_t n;
+    size_t cap;           // une puissance de 2
+};
+
+/* Ajoute un nom, retourne 1 s'il est nouveau, 0 s'il y était déjà, -1 si la mémoire manque */
+static int name_set_add(struct name_set *set, const char *name, size_t len) {
+    if ((set->n + 1) * 2 > set->cap) {
+        struct name_set grown = {.cap = set->cap ? set->cap * 2 : 64};
+        grown.names = calloc(grown.cap, sizeof(char *));
+        grown.lens = calloc(grown.cap, sizeof(size_t));
+        if (grown.names == NULL || grown.lens == NULL) {
+            free(grown.names);
+            free(grown.lens);
+            return -1;
+        }
+        for (size_t i = 0; i < set->cap; i++) {
+            if (set->names[i] != NULL) {
+                name_set_add(&grown, set->names[i], set->lens[i]);
+            }
+        }
+        free(set->names);
+        free(set->lens);
+        *set = grown;
+    }
+    size_t i = overlay_hash(name, len) & (set->cap - 1);
+    while (set->names[i] != NULL) {
+        if (set->lens[i] == len && memcmp(set->names[i], name, len) == 0) {
+            return 0;
+        }
+        i = (i + 1) & (set->cap - 1);
+    }
+    set->names[i] = name;
+    set->lens[i] = len;
+    set->n++;
+    return 1;
+}
+
+/**
+ * Lists the entries of a directory of the overlay, merged across the layers: an entry of an upper layer hides the
+ * entry of the same name in the lower ones, and whited-out entries are not listed. As list(), it does not recurse into the
+ * directories listed at the given path.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to a directory, or an empty string for the root. If the entry is a symlink, it is resolved to its
+ *             linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path is visible in the overlay,
+ *         any other value otherwise.
+ */
+int tar_overlay_list(const tar_overlay_t *ov, const char *path, char **entries, size_t *no_entries) {
+    char key[RESOLVE_PATH_MAX];
+    const tar_index_t *index;
+    size_t max = *no_entries;
+    *no_entries = 0;
 
-                // Retourner le nombre d'octets restants à lire
-                ssize_t bytesRestant = file_size - offset - bytes_read;
+    size_t key_len;
+    if (overlay_key(path, strlen(path), key) == 0) {
+        key_len = 0;  // racine
+    } else {
+        const index_entry_t *dir = overlay_resolve(ov, path, 1, key, &index);
+        if (dir == NULL || dir->type != DIRTYPE) {
+            return 0;
+        }
+        key_len = strlen(key);
+    }
 
-                if(bytesRestant == 0){
-                    free(pathcpy);
-                    return 0;
+    struct name_set seen = {0};
+    uint64_t hash = overlay_hash(key, key_len);
+    int ret = 1;
+    for (size_t i = 0; i < ov->n_layers && ret == 1; i++) {
+        struct overlay_layer *layer = &ov->layers[i];
+        if (key_len == 0 || bloom_maybe(layer, hash)) {
+            index = overlay_index(layer);
+            const index_entry_t *dir = index != NULL && key_len > 0 ? index_lookup(index, key, key_len) : NULL;
+            if (dir != NULL && dir->type != DIRTYPE) {
+                break;  // un fichier de cette couche masque les répertoires des couches inférieures
+            }
+            size_t cursor = 0;
+            tar_dirent_t page[64];
+            ssize_t n;
+            while (index != NULL && (key_len == 0 || dir != NULL)
+                   && (n = list_next(index, key, &cursor, page, 64)) > 0) {
+                for (ssize_t j = 0; j < n; j++) {
+                    const char *child = page[j].path;
+                    size_t child_len = strlen(child);
+                    size_t name_len = child_len - (child[child_len - 1] == '/');
+                    size_t dir_len = parent_len(child, name_len);
+                    int whiteout = strncmp(child + dir_len, WHITEOUT_PREFIX, strlen(WHITEOUT_PREFIX)) == 0;
+                    if (whiteout) {
+                        continue;  // déjà pris en compte dans la liste des chemins masqués de la couche
+                    }
+                    int added = name_set_add(&seen, child, name_len);
+                    if (added == -1) {
+                        ret = -1;
+                        break;
+                    }
+                    if (added == 1 && *no_entries < max) {
+                        strncpy(entries[*no_entries], child, 100);
+                        (*no_entries)++;
+                    }
+                }
+            }
+            // Les whiteouts de la couche masquent les noms correspondants des couches inférieures
+            for (size_t j = 0; j < layer->n_hidden && ret == 1; j++) {
+                const char *hidden = layer->hidden[j];
+                if (parent_len(hidden, strlen(hidden)) == (key_len ? key_len + 1 : 0)
+                    && strncmp(hidden, key, key_len) == 0 && name_set_add(&seen, hidden, strlen(hidden)) == -1) {
+                    ret = -1;
                 }
+            }
+        }
+        if (overlay_hides(layer, key, key_len) || sorted_contains(layer->opaque, layer->n_opaque, key)) {
+            break;
+        }
+    }
+    free(seen.names);
+    free(seen.lens);
+    return ret == 1;
+}
+
+/*
+ * Table compacte des chemins.
+ *
+ * Les chemins sont triés, dédoublonnés et codés par préfixe commun dans une seule arène, par blocs de PATHS_BLOCK
+ * chemins : le premier chemin d'un bloc est complet (longueur puis octets), chacun des suivants est la longueur du
+ * préfixe qu'il partage avec le précédent, la longueur de son suffixe puis le suffixe. Les longueurs sont des entiers
+ * de taille variable (LEB128), un octet sous 128. Les métadonnées sont dans des tableaux à largeur fixe, dans l'ordre
+ * des chemins.
+ */
+#define PATHS_BLOCK 16
+
+struct tar_path_table {
+    uint8_t *arena;       // chemins codés par préfixe commun
+    size_t arena_len;
+    uint32_t *blocks;     // position dans l'arène du premier chemin de chaque bloc
+    size_t n_blocks;
+    uint64_t *data_offs;
+    uint64_t *sizes;
+    char *types;
+    size_t n;
+};
+
+static size_t varint_put(uint8_t *out, size_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static size_t varint_get(const uint8_t **pos) {
+    size_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *(*pos)++;
+        value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+/*
+ * Compare un chemin à une clé. En mode préfixe, seuls les len premiers octets du chemin sont comparés, de sorte que tous
+ * les chemins qui commencent par la clé lui sont égaux.
+ */
+static int paths_cmp(const char *path, size_t path_len, const char *key, size_t len, int prefix) {
+    if (prefix && path_len > len) {
+        path_len = len;
+    }
+    int cmp = memcmp(path, key, path_len < len ? path_len : len);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return path_len < len ? -1 : path_len > len;
+}
+
+/*
+ * Retourne le rang du premier chemin qui n'est pas avant la clé (upper nul) ou qui est après elle (upper non nul).
+ * La recherche dichotomique se fait sur les premiers chemins des blocs, stockés complets, puis le bloc précédent est
+ * décodé séquentiellement.
+ */
+static size_t paths_bound(const tar_path_table_t *table, const char *key, size_t len, int prefix, int upper) {
+    size_t lo = 0, hi = table->n_blocks;
+    // Premier bloc dont le premier chemin est au-delà de la borne
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const uint8_t *pos = table->arena + table->blocks[mid];
+        size_t head_len = varint_get(&pos);
+        int cmp = paths_cmp((const char *)pos, head_len, key, len, prefix);
+        if (upper ? cmp > 0 : cmp >= 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    if (lo == 0) {
+        return 0;
+    }
+
+    // La borne est dans le bloc lo - 1, après son premier chemin, ou au début du bloc lo
+    size_t block = lo - 1;
+    size_t first = block * PATHS_BLOCK;
+    size_t count = table->n - first < PATHS_BLOCK ? table->n - first : PATHS_BLOCK;
+    const uint8_t *pos = table->arena + table->blocks[block];
+    char path[HEADER_PATH_MAX];
+    size_t path_len = varint_get(&pos);
+    memcpy(path, pos, path_len);
+    pos += path_len;
+    for (size_t i = 1; i < count; i++) {
+        size_t shared = varint_get(&pos);
+        size_t suffix = varint_get(&pos);
+        memcpy(path + shared, pos, suffix);
+        pos += suffix;
+        path_len = shared + suffix;
+        int cmp = paths_cmp(path, path_len, key, len, prefix);
+        if (upper ? cmp > 0 : cmp >= 0) {
+            return first + i;
+        }
+    }
+    return first + count;
+}
+
+/* Clé de tri des chemins de la table : à chemin égal, l'ordre de l'archive est conservé */
+struct paths_key {
+    const char *path;     // fixé une fois tous les chemins copiés, l'arène pouvant être déplacée avant
+    size_t path_off;
+    size_t path_len;
+    uint64_t data_off;
+    uint64_t size;
+    char type;
+};
+
+static int paths_key_cmp(const void *a, const void *b) {
+    const struct paths_key *ka = a;
+    const struct paths_key *kb = b;
+    int cmp = paths_cmp(ka->path, ka->path_len, kb->path, kb->path_len, 0);
+    if (cmp == 0) {
+        cmp = ka->data_off < kb->data_off ? -1 : 1;
+    }
+    return cmp;
+}
 
-                free(pathcpy);
-                return bytesRestant;
+/* Code les chemins triés dans l'arène et remplit les tableaux de la table */
+static int paths_encode(tar_path_table_t *table, const struct paths_key *keys, size_t n) {
+    // Majoration de l'arène : chaque chemin complet et deux longueurs
+    size_t bound = 0;
+    for (size_t i = 0; i < n; i++) {
+        bound += keys[i].path_len + 2 * sizeof(size_t);
+    }
+    table->arena = malloc(bound ? bound : 1);
+    table->blocks = malloc((n / PATHS_BLOCK + 1) * sizeof(uint32_t));
+    table->data_offs = malloc((n ? n : 1) * sizeof(uint64_t));
+    table->sizes = malloc((n ? n : 1) * sizeof(uint64_t));
+    table->types = malloc(n ? n : 1);
+    if (table->arena == NULL || table->blocks == NULL || table->data_offs == NULL || table->sizes == NULL
+        || table->types == NULL) {
+        return -1;
+    }
 
-                   
+    const char *prev = NULL;
+    size_t prev_len = 0;
+    for (size_t i = 0; i < n; i++) {
+        // Seule la première occurrence d'un chemin est gardée, celle que retiennent les recherches de l'index
+        if (i > 0 && paths_cmp(keys[i].path, keys[i].path_len, keys[i - 1].path, keys[i - 1].path_len, 0) == 0) {
+            continue;
+        }
+        const char *path = keys[i].path;
+        size_t len = keys[i].path_len;
+        uint8_t *out = table->arena + table->arena_len;
+        if (table->n % PATHS_BLOCK == 0) {
+            if (table->arena_len > UINT32_MAX) {
+                return -1;
+            }
+            table->blocks[table->n_blocks++] = table->arena_len;
+            out += varint_put(out, len);
+            memcpy(out, path, len);
+            out += len;
+        } else {
+            size_t shared = 0;
+            while (shared < len && shared < prev_len && path[shared] == prev[shared]) {
+                shared++;
             }
+            out += varint_put(out, shared);
+            out += varint_put(out, len - shared);
+            memcpy(out, path + shared, len - shared);
+            out += len - shared;
+        }
+        table->arena_len = out - table->arena;
+        table->data_offs[table->n] = keys[i].data_off;
+        table->sizes[table->n] = keys[i].size;
+        table->types[table->n] = keys[i].type;
+        table->n++;
+        prev = path;
+        prev_len = len;
+    }
+
+    // Les tableaux sont ramenés à leur taille utile
+    uint8_t *arena = realloc(table->arena, table->arena_len ? table->arena_len : 1);
+    if (arena != NULL) {
+        table->arena = arena;
+    }
+    uint32_t *blocks = realloc(table->blocks, (table->n_blocks ? table->n_blocks : 1) * sizeof(uint32_t));
+    if (blocks != NULL) {
+        table->blocks = blocks;
+    }
+    return 0;
+}
 
+/**
+ * Builds a compact table of the paths of the archive in a single pass.
+ *
+ * Unlike an index, the table keeps no tree of the directories, no links and no hash table: it is meant to hold the
+ * catalog of very large archives in memory. Paths are sorted, deduplicated (the first entry of a path wins, as in the
+ * other lookups) and front-coded by blocks of 16 in a single arena, the type, size and data offset of each entry are
+ * kept in fixed-width arrays. Lookups are binary searches over the first paths of the blocks, stored in full.
+ *
+ * A table costs 17 bytes of fixed-width record per entry, 4 bytes per block of 16 entries, and for each path the
+ * bytes it does not share with the previous one plus two length bytes (one for the first path of a block), as long
+ * as paths and suffixes are shorter than 128 bytes. For a catalog of packages, where consecutive paths share most of
+ * their bytes, this stays under TAR_PATH_TABLE_BUDGET bytes per entry.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ *
+ * @return a newly allocated table to be released with tar_path_table_close(),
+ *         NULL if the archive could not be read or memory could not be allocated.
+ */
+tar_path_table_t *tar_path_table_open(int tar_fd) {
+    tar_path_table_t *table = calloc(1, sizeof(tar_path_table_t));
+    struct paths_key *keys = NULL;
+    char *strings = NULL;
+    size_t n = 0, cap = 0, strings_len = 0, strings_cap = 0;
+    tar_iter_t it;
+    tar_entry_t entry;
+    int ret = -1;
 
+    if (table == NULL || iter_init(&it, tar_fd, 0) == -1) {
+        free(table);
+        return NULL;
+    }
+    // Les chemins sont d'abord copiés tels quels, puis triés et codés
+    while ((ret = iter_next(&it, &entry)) == 1) {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            struct paths_key *grown = realloc(keys, cap * sizeof(struct paths_key));
+            if (grown == NULL) {
+                ret = -1;
+                break;
+            }
+            keys = grown;
+        }
+        if (strings_len + entry.path_len > strings_cap) {
+            strings_cap = strings_cap ? strings_cap * 2 : 64 * 1024;
+            while (strings_len + entry.path_len > strings_cap) {
+                strings_cap *= 2;
+            }
+            char *grown = realloc(strings, strings_cap);
+            if (grown == NULL) {
+                ret = -1;
+                break;
+            }
+            strings = grown;
         }
+        keys[n].path_off = strings_len;
+        keys[n].path_len = entry.path_len;
+        keys[n].data_off = entry.data_offset;
+        keys[n].size = entry.size;
+        keys[n].type = entry.type;
+        memcpy(strings + strings_len, entry.path, entry.path_len);
+        strings_len += entry.path_len;
+        n++;
+    }
+    iter_destroy(&it);
 
-        unsigned long file_size = strtol(header2.size, NULL, 8);
-        if (skip_file_data(tar_fd, file_size) == -1) {
-            perror("Erreur lors du saut des blocs de données");
-            free(pathcpy);
-            return -1;
+    if (ret == 0) {
+        for (size_t i = 0; i < n; i++) {
+            keys[i].path = strings + keys[i].path_off;
+        }
+        if (n > 0) {
+            qsort(keys, n, sizeof(struct paths_key), paths_key_cmp);
+        }
+        ret = paths_encode(table, keys, n);
+    }
+    free(keys);
+    free(strings);
+    if (ret != 0) {
+        tar_path_table_close(table);
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * Releases a table built by tar_path_table_open().
+ *
+ * @param table The table to release, may be NULL.
+ */
+void tar_path_table_close(tar_path_table_t *table) {
+    if (table == NULL) {
+        return;
+    }
+    free(table->arena);
+    free(table->blocks);
+    free(table->data_offs);
+    free(table->sizes);
+    free(table->types);
+    free(table);
+}
+
+/**
+ * Returns the number of distinct paths in the table.
+ *
+ * @param table A table built by tar_path_table_open().
+ *
+ * @return the number of paths, which are ranked from zero in byte order.
+ */
+size_t tar_path_table_count(const tar_path_table_t *table) {
+    return table->n;
+}
+
+/**
+ * Returns the memory held by the table, to be compared with TAR_PATH_TABLE_BUDGET times its number of paths.
+ *
+ * @param table A table built by tar_path_table_open().
+ *
+ * @return the number of bytes allocated for the table.
+ */
+size_t tar_path_table_memory(const tar_path_table_t *table) {
+    return sizeof(tar_path_table_t) + table->arena_len + table->n_blocks * sizeof(uint32_t)
+           + table->n * (2 * sizeof(uint64_t) + sizeof(char));
+}
+
+/**
+ * Looks up a path in the table. A directory is found with or without its trailing '/'.
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return the rank of the path in the table,
+ *         -1 if no entry at the given path exists in the archive.
+ */
+ssize_t tar_path_table_find(const tar_path_table_t *table, const char *path) {
+    size_t len = strlen(path);
+    size_t rank = paths_bound(table, path, len, 0, 0);
+    char path_buf[HEADER_PATH_MAX];
+    if (rank < table->n && rank + 1 == paths_bound(table, path, len, 0, 1)) {
+        return rank;
+    }
+    // Autre forme d'un répertoire, avec ou sans '/' final
+    if (len > 0 && path[len - 1] == '/') {
+        len--;
+    } else if (len + 1 < HEADER_PATH_MAX) {
+        memcpy(path_buf, path, len);
+        path_buf[len++] = '/';
+        path = path_buf;
+    } else {
+        return -1;
+    }
+    rank = paths_bound(table, path, len, 0, 0);
+    if (rank < table->n && rank + 1 == paths_bound(table, path, len, 0, 1) && table->types[rank] == DIRTYPE) {
+        return rank;
+    }
+    return -1;
+}
+
+/**
+ * Finds the range of paths that start with a given prefix. As the paths are sorted, they are consecutive.
+ *
+ * Example, to visit a subtree:
+ *  size_t first, end;
+ *  tar_path_table_prefix(table, "usr/share/", &first, &end);
+ *  for (size_t rank = first; rank < end; rank++) {
+ *      tar_path_table_get(table, rank, path, sizeof(path), &record);
+ *  }
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param prefix A prefix of paths, an empty string for all the paths.
+ * @param first An out argument, set to the rank of the first path starting with the prefix.
+ * @param end An out argument, set to the rank following the last path starting with the prefix.
+ *
+ * @return the number of paths starting with the prefix.
+ */
+size_t tar_path_table_prefix(const tar_path_table_t *table, const char *prefix, size_t *first, size_t *end) {
+    size_t len = strlen(prefix);
+    *first = paths_bound(table, prefix, len, 1, 0);
+    *end = paths_bound(table, prefix, len, 1, 1);
+    return *end - *first;
+}
+
+/**
+ * Decodes the path and the record at a given rank of the table.
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param rank The rank of the path, lower than tar_path_table_count().
+ * @param path A destination buffer for the path, NUL-terminated, may be NULL.
+ * @param path_size The size of path, the path is truncated to fit.
+ * @param record An out argument set to the type, size and data offset of the entry, may be NULL.
+ *
+ * @return the length of the path,
+ *         -1 if the rank is out of the table.
+ */
+ssize_t tar_path_table_get(const tar_path_table_t *table, size_t rank, char *path, size_t path_size,
+                           tar_path_record_t *record) {
+    if (rank >= table->n) {
+        return -1;
+    }
+    const uint8_t *pos = table->arena + table->blocks[rank / PATHS_BLOCK];
+    char decoded[HEADER_PATH_MAX];
+    size_t len = varint_get(&pos);
+    memcpy(decoded, pos, len);
+    pos += len;
+    for (size_t i = 0; i < rank % PATHS_BLOCK; i++) {
+        size_t shared = varint_get(&pos);
+        size_t suffix = varint_get(&pos);
+        memcpy(decoded + shared, pos, suffix);
+        pos += suffix;
+        len = shared + suffix;
+    }
+
+    if (path != NULL && path_size > 0) {
+        size_t copied = len < path_size - 1 ? len : path_size - 1;
+        memcpy(path, decoded, copied);
+        path[copied] = '\0';
+    }
+    if (record != NULL) {
+        record->type = table->types[rank];
+        record->size = table->sizes[rank];
+        record->data_offset = table->data_offs[rank];
+    }
+    return len;
+}
+
+/*
+ * Recherche d'entrées par motif.
+ *
+ * Un motif est un préfixe littéral ou un glob au sens de fnmatch(3), où '*' et '?' ne traversent pas les '/'. Le
+ * chemin comparé est celui de l'entrée sans son éventuel '/' final. Toutes les entrées qui correspondent commencent
+ * par la partie littérale du motif, jusqu'à son premier caractère spécial : l'index, trié par chemin, n'examine que
+ * l'intervalle de ces chemins.
+ */
+
+/* Longueur de la partie littérale d'un motif, que tout chemin correspondant a pour préfixe */
+static size_t find_literal_len(const char *pattern, int flags) {
+    if (flags & TAR_FIND_PREFIX) {
+        return strlen(pattern);
+    }
+    return strcspn(pattern, "*?[\\");
+}
+
+/* Le chemin, de len octets, correspond-il au motif ? */
+static int find_match(const char *pattern, size_t literal_len, int flags, const char *path, size_t len) {
+    char buf[HEADER_PATH_MAX];
+    if (len > 0 && path[len - 1] == '/') {
+        len--;
+    }
+    if (len < literal_len || len >= HEADER_PATH_MAX || memcmp(path, pattern, literal_len) != 0) {
+        return 0;
+    }
+    if (flags & TAR_FIND_PREFIX) {
+        // Sans récursion, seuls les chemins sans '/' après le préfixe correspondent
+        return (flags & TAR_FIND_RECURSIVE) || memchr(path + literal_len, '/', len - literal_len) == NULL;
+    }
+    memcpy(buf, path, len);
+    buf[len] = '\0';
+    if (fnmatch(pattern, buf, FNM_PATHNAME) == 0) {
+        return 1;
+    }
+    // En récursion, une entrée correspond aussi si l'un de ses répertoires parents correspond
+    for (size_t i = len; (flags & TAR_FIND_RECURSIVE) && i > literal_len; i--) {
+        if (buf[i - 1] == '/') {
+            buf[i - 1] = '\0';
+            if (fnmatch(pattern, buf, FNM_PATHNAME) == 0) {
+                return 1;
+            }
         }
     }
-    free(pathcpy);
+    return 0;
+}
+
+/**
+ * Finds the entries of an archive whose path matches a pattern, in a single pass over the archive.
+ *
+ * The pattern is a glob, as for fnmatch(3) where '*' and '?' do not match a '/', or with TAR_FIND_PREFIX a literal
+ * prefix. A directory is matched by its path without its trailing '/', e.g. the pattern "etc/conf*" matches the
+ * directory "etc/config/". Without TAR_FIND_RECURSIVE, a prefix only matches the paths that have no '/' after it; with it, a
+ * prefix matches every path starting with it and a glob also matches every entry below a matching directory.
+ *
+ * An entry stored several times in the archive is reported each time it is found.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param pattern The pattern to match the paths against.
+ * @param flags Zero, or a combination of TAR_FIND_PREFIX and TAR_FIND_RECURSIVE.
+ * @param callback The function called with each matching entry, in archive order. The path is valid until it returns.
+ *                 It returns zero to continue, any other value to stop the search.
+ * @param ctx An opaque pointer given back to the callback.
+ *
+ * @return the number of matching entries reported, including the one whose callback stopped the search,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_find(int tar_fd, const char *pattern, int flags, tar_find_callback_t callback, void *ctx) {
+    size_t literal_len = find_literal_len(pattern, flags);
+    tar_iter_t it;
+    tar_entry_t entry;
+    ssize_t count = 0;
+    int ret;
+
+    if (iter_init(&it, tar_fd, 0) == -1) {
+        return -1;
+    }
+    while ((ret = iter_next(&it, &entry)) == 1) {
+        if (find_match(pattern, literal_len, flags, entry.path, entry.path_len)) {
+            tar_path_record_t record = {.type = entry.type, .size = entry.size, .data_offset = entry.data_offset};
+            count++;
+            if (callback(entry.path, &record, ctx) != 0) {
+                break;
+            }
+        }
+    }
+    iter_destroy(&it);
+    return ret < 0 ? -1 : count;
+}
 
-    return -1;  
-}
\ No newline at end of file
+/* Indice de la première entrée de l'index dont le chemin n'est pas avant les len octets de key */
+static size_t index_lower_bound(const tar_index_t *index, const char *key, size_t len) {
+    size_t lo = 0, hi = index->n_entries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const index_entry_t *entry = &index->entries[mid];
+        if (paths_cmp(index->strings + entry->path_off, entry->path_len, key, len, 0) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Finds the entries of an indexed archive whose path matches a pattern, as tar_find().
+ *
+ * The entries of the index are sorted by path: a binary search finds the first path starting with the literal part of
+ * the pattern, up to its first special character, and only the following paths that start with it are examined. An
+ * entry stored several times in the archive is reported once, as its first occurrence, the one the other lookups of the
+ * index return.
+ *
+ * @param index An index built by tar_index_open().
+ * @param pattern The pattern to match the paths against.
+ * @param flags Zero, or a combination of TAR_FIND_PREFIX and TAR_FIND_RECURSIVE.
+ * @param callback The function called with each matching entry, in byte order of the paths. It returns zero to
+ *                 continue, any other value to stop the search.
+ * @param ctx An opaque pointer given back to the callback.
+ *
+ * @return the number of matching entries reported, including the one whose callback stopped the search.
+ */
+ssize_t tar_index_find(const tar_index_t *index, const char *pattern, int flags, tar_find_callback_t callback,
+                       void *ctx) {
+    size_t literal_len = find_literal_len(pattern, flags);
+    ssize_t count = 0;
+
+    for (size_t i = index_lower_bound(index, pattern, literal_len); i < index->n_entries; i++) {
+        const index_entry_t *entry = &index->entries[i];
+        const char *path = index->strings + entry->path_off;
+        if (entry->path_len < literal_len || memcmp(path, pattern, literal_len) != 0) {
+            break;  // fin de l'intervalle des chemins qui commencent par la partie littérale
+        }
+        // À chemin égal, les entrées sont dans l'ordre de l'archive : seule la première est retenue, comme par les
+        // recherches de l'index
+        if (i > 0 && index->entries[i - 1].path_len == entry->path_len
+            && memcmp(index->strings + index->entries[i - 1].path_off, path, entry->path_len) == 0) {
+            continue;
+        }
+        if (find_match(pattern, literal_len, flags, path, entry->path_len)) {
+            tar_path_record_t record = {.type = entry->type, .size = entry->size, .data_offset = entry->data_off};
+            count++;
+            if (callback(path, &record, ctx) != 0) {
+                break;
+            }
+        }
+    }
+    return count;
+}
@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/types.h>
 
 typedef struct posix_header
 {                              /* byte offset */
@@ -32,16 +34,63 @@ typedef struct posix_header
 #define TVERSION "00"           /* 00 and no null */
 #define TVERSLEN 2
 
+#define OLDGNU_MAGIC "ustar  "  /* 7 chars and a null, over the magic and version fields of GNU archives */
+
 /* Values used in typeflag field.  */
 #define REGTYPE  '0'            /* regular file */
 #define AREGTYPE '\0'           /* regular file */
 #define LNKTYPE  '1'            /* link */
 #define SYMTYPE  '2'            /* reserved */
 #define DIRTYPE  '5'            /* directory */
+#define XHDTYPE  'x'            /* pax extended header for the next entry */
+#define GNUTYPE_SPARSE 'S'      /* GNU sparse file */
+
+/* Kinds of sparse files, see tar_entry_t */
+#define TAR_SPARSE_NONE 0       /* not a sparse file */
+#define TAR_SPARSE_GNU  1       /* old GNU sparse file, typeflag GNUTYPE_SPARSE */
+#define TAR_SPARSE_PAX  2       /* regular file described as sparse by a pax 1.0 extended header */
 
 /* Converts an ASCII-encoded octal-based number into a regular integer */
 #define TAR_INT(char_ptr) strtol(char_ptr, NULL, 8)
 
+/* Implementations of the header checksum, see tar_chksum_select() */
+typedef enum {
+    TAR_CHKSUM_AUTO,
+    TAR_CHKSUM_SCALAR,
+    TAR_CHKSUM_SSE2,
+    TAR_CHKSUM_AVX2,
+    TAR_CHKSUM_AVX512,
+} tar_chksum_impl_t;
+
+/**
+ * Computes the checksum of a header, the chksum field being counted as if it was filled with spaces.
+ *
+ * The sum is computed with the fastest SIMD implementation supported by the CPU, chosen at the first call.
+ *
+ * @param hdr The header to compute the checksum of.
+ *
+ * @return the checksum of the header.
+ */
+unsigned int tar_header_chksum(const tar_header_t *hdr);
+
+/**
+ * Selects the implementation used by tar_header_chksum(). It may be called while other threads compute checksums:
+ * they switch to the new implementation from their next header on.
+ *
+ * @param impl The implementation to use, TAR_CHKSUM_AUTO picks the fastest one supported by the CPU.
+ *
+ * @return zero on success,
+ *         -1 if the implementation is not supported by the CPU, in which case the current one is kept.
+ */
+int tar_chksum_select(tar_chksum_impl_t impl);
+
+/**
+ * Gives the name of the implementation currently used by tar_header_chksum().
+ *
+ * @return "scalar", "sse2", "avx2" or "avx512".
+ */
+const char *tar_chksum_impl_name(void);
+
 /**
  * Checks whether the archive is valid.
  *
@@ -148,4 +197,1343 @@ int list(int tar_fd, char *path, char **entries, size_t *no_entries);
  */
 ssize_t read_file(int tar_fd, char *path, size_t offset, uint8_t *dest, size_t *len);
 
+/**
+ * Checks whether the archive is valid, using several threads.
+ *
+ * The calling thread follows the chain of headers while a pool of threads re-reads each header with pread() and
+ * validates its magic value, version and checksum. The result is the one of the first invalid header in archive order,
+ * exactly as for check_archive().
+ *
+ * @param tar_fd A file descriptor pointing to a file supposed to contain a tar archive. Its file offset is not used
+ *               nor modified.
+ * @param nthreads The number of validation threads, zero or a negative value uses one thread per online CPU.
+ *
+ * @return the same values as check_archive().
+ */
+int check_archive_parallel(int tar_fd, int nthreads);
+
+/*
+ * Reentrant variants.
+ *
+ * The functions below behave like their counterparts above but only access the archive through pread(): they
+ * neither use nor modify the file offset of tar_fd and keep all their state on the caller's stack. Several threads can
+ * therefore call them concurrently on the same file descriptor without any locking.
+ */
+
+/**
+ * Checks whether the archive is valid, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a file supposed to contain a tar archive.
+ *
+ * @return the same values as check_archive().
+ */
+int check_archive_r(int tar_fd);
+
+/**
+ * Checks whether an entry exists in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int exists_r(int tar_fd, const char *path);
+
+/**
+ * Checks whether an entry exists in the archive and is a directory, without using nor modifying the file offset of
+ * tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int is_dir_r(int tar_fd, const char *path);
+
+/**
+ * Checks whether an entry exists in the archive and is a file, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a file,
+ *         any other value otherwise.
+ */
+int is_file_r(int tar_fd, const char *path);
+
+/**
+ * Checks whether an entry exists in the archive and is a symlink, without using nor modifying the file offset of
+ * tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
+ *         any other value otherwise.
+ */
+int is_symlink_r(int tar_fd, const char *path);
+
+/**
+ * Lists the entries at a given path in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int list_r(int tar_fd, const char *path, char **entries, size_t *no_entries);
+
+/**
+ * Reads a file at a given path in the archive, without using nor modifying the file offset of tar_fd.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file.
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t read_file_r(int tar_fd, const char *path, size_t offset, uint8_t *dest, size_t *len);
+
+/* Default size of the reads issued by an iterator */
+#define TAR_ITER_DEFAULT_CHUNK (1024 * 1024)
+
+/**
+ * An entry of an archive, as decoded by tar_iter_next().
+ *
+ * A pax extended header is not an entry of its own: its path, size and sparse records are applied to the entry that
+ * follows it. The data of a sparse file is a map of its data segments followed by the segments, the holes between
+ * them are not stored in the archive and read as zeros.
+ *
+ * The numeric fields are decoded once, octal or GNU base-256, so that callers never parse the raw header again; the
+ * raw header is only kept for the fields that are rarely needed, such as the link name. The header is always the block
+ * before the data, and a pax extended header, when there is one, is pax_blocks blocks before the header both in the
+ * archive and in memory, so neither needs a field of its own: the record is 48 bytes.
+ */
+typedef struct {
+    const tar_header_t *header;   /* raw header of the entry, at data_offset - 512 in the archive */
+    const char *path;             /* full path of the entry, prefix included, or the path given by the pax header */
+    uint64_t size;                /* size of the data of the entry, holes included for a sparse file */
+    uint64_t data_offset;         /* offset of the data in the archive, or of the sparse map for a sparse file */
+    uint64_t mtime;               /* modification time, in seconds since the epoch */
+    uint16_t path_len;
+    uint16_t mode;                /* permission bits of the entry */
+    uint16_t pax_blocks;          /* distance in blocks from the pax extended header to header, zero if none */
+    char type;                    /* typeflag of the entry */
+    char sparse;                  /* TAR_SPARSE_NONE, TAR_SPARSE_GNU or TAR_SPARSE_PAX */
+} tar_entry_t;
+
+/**
+ * A cursor over the entries of an archive.
+ *
+ * The archive is read in large aligned chunks and entries are decoded from the buffer, so that walking over small
+ * members does not issue any system call until the end of the chunk is reached.
+ */
+typedef struct tar_iter tar_iter_t;
+
+/**
+ * Opens an iterator over the entries of an archive.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param chunk_size The size of the reads issued on the archive, zero selects TAR_ITER_DEFAULT_CHUNK.
+ *
+ * @return a newly allocated iterator to be released with tar_iter_close(),
+ *         NULL if memory could not be allocated.
+ */
+tar_iter_t *tar_iter_open(int tar_fd, size_t chunk_size);
+
+/**
+ * Advances the iterator to the next entry of the archive.
+ *
+ * @param it An iterator returned by tar_iter_open().
+ * @param entry An out argument, set to the decoded entry. Its pointers are valid until the next call.
+ *
+ * @return 1 if an entry was decoded,
+ *         zero at the end of the archive,
+ *         -1 if the archive could not be read.
+ */
+int tar_iter_next(tar_iter_t *it, tar_entry_t *entry);
+
+/**
+ * Releases an iterator opened by tar_iter_open().
+ *
+ * @param it The iterator to release, may be NULL.
+ */
+void tar_iter_close(tar_iter_t *it);
+
+/**
+ * An in-memory index of the entries of an archive.
+ *
+ * The index is built in a single pass over the archive by tar_index_open() and maps each entry path to its decoded
+ * type, size and data offset. Lookups through the index answer in constant time and do not perform any I/O.
+ */
+typedef struct tar_index tar_index_t;
+
+/**
+ * Builds an index of the archive in a single pass.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ *
+ * @return a newly allocated index to be released with tar_index_close(),
+ *         NULL if the archive could not be read or memory could not be allocated.
+ */
+tar_index_t *tar_index_open(int tar_fd);
+
+/**
+ * Releases an index built by tar_index_open().
+ *
+ * @param index The index to release, may be NULL.
+ */
+void tar_index_close(tar_index_t *index);
+
+/**
+ * Checks whether an entry exists in the indexed archive.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_index_exists(const tar_index_t *index, const char *path);
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a directory.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int tar_index_is_dir(const tar_index_t *index, const char *path);
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a file.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not a file,
+ *         any other value otherwise.
+ */
+int tar_index_is_file(const tar_index_t *index, const char *path);
+
+/**
+ * Checks whether an entry exists in the indexed archive and is a symlink.
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive or the entry is not symlink,
+ *         any other value otherwise.
+ */
+int tar_index_is_symlink(const tar_index_t *index, const char *path);
+
+/**
+ * Reads a file at a given path in the indexed archive, with the same semantics as read_file().
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_index_read_file(const tar_index_t *index, const char *path, size_t offset, uint8_t *dest, size_t *len);
+
+/* Default memory budget and extent size of the cache of an index */
+#define TAR_CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+#define TAR_CACHE_DEFAULT_EXTENT (64 * 1024)
+
+/**
+ * The counters of the cache of an index, see tar_index_cache_stats().
+ */
+typedef struct {
+    uint64_t hits;                /* extents found in the cache */
+    uint64_t misses;              /* extents read from the archive */
+    uint64_t evictions;           /* extents evicted to make room for others */
+    uint64_t cached_bytes;        /* memory used by the cached extents */
+} tar_cache_stats_t;
+
+/**
+ * Enables a cache of the data read by tar_index_read_file(), so that repeated reads of the same parts of the archive
+ * are served from memory without any system call. The cache holds fixed-size extents of the archive and evicts the
+ * least recently used ones (CLOCK approximation) once its budget is reached. It is split in shards with their own
+ * lock, so that concurrent readers rarely contend.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load(), with no read in progress.
+ * @param budget The maximum memory used by cached data, in bytes, zero selects TAR_CACHE_DEFAULT_BUDGET.
+ * @param extent_size The size of the cached extents, zero selects TAR_CACHE_DEFAULT_EXTENT.
+ *
+ * @return zero on success,
+ *         -1 if memory could not be allocated.
+ */
+int tar_index_cache_enable(tar_index_t *index, size_t budget, size_t extent_size);
+
+/**
+ * Disables and frees the cache of an index, see tar_index_cache_enable().
+ *
+ * @param index An index with no read in progress.
+ */
+void tar_index_cache_disable(tar_index_t *index);
+
+/**
+ * Gives the counters of the cache of an index.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param stats An out argument, set to the counters, or to zeros if the cache is not enabled.
+ */
+void tar_index_cache_stats(const tar_index_t *index, tar_cache_stats_t *stats);
+
+/**
+ * Saves an index next to its archive, so that later processes can load it with tar_index_load() instead of scanning
+ * the archive.
+ *
+ * The index file holds the entries sorted by path with their types, sizes, data offsets and link targets. It records
+ * the size, modification time and a hash of the headers of the archive, so that a stale index is detected.
+ *
+ * @param index An index built by tar_index_open() or tar_index_load().
+ * @param sidecar_path The path of the index file to write, e.g. "archive.tar.tidx". It is replaced atomically.
+ *
+ * @return zero on success,
+ *         -1 if the archive could not be read or the index file could not be written.
+ */
+int tar_index_save(const tar_index_t *index, const char *sidecar_path);
+
+/**
+ * Loads an index saved by tar_index_save(). The index file is mapped in memory and used as is: no scan of the archive
+ * is needed, lookups are served right away.
+ *
+ * @param sidecar_path The path of the index file.
+ * @param tar_fd A file descriptor pointing to the archive the index was saved for.
+ *
+ * @return a newly allocated index to be released with tar_index_close(),
+ *         NULL if the index file could not be read, is corrupted, or is stale because the archive changed since it
+ *         was saved (errno is then set to ESTALE).
+ */
+tar_index_t *tar_index_load(const char *sidecar_path, int tar_fd);
+
+/**
+ * An entry of a directory, as listed by list_next().
+ */
+typedef struct {
+    const char *path;             /* full path of the entry, valid as long as the index */
+    char type;                    /* typeflag of the entry */
+    uint64_t size;                /* size of the data of the entry */
+} tar_dirent_t;
+
+/**
+ * Lists the entries of a directory of the indexed archive, a page at a time.
+ *
+ * The index keeps the children of each directory, so listing a directory costs time proportional to its number of
+ * children only. As list(), list_next() does not recurse into the directories listed at the given path.
+ *
+ * Example:
+ *  size_t cursor = 0;
+ *  tar_dirent_t page[64];
+ *  ssize_t n;
+ *  while ((n = list_next(index, "dir/", &cursor, page, 64)) > 0) {
+ *      ...
+ *  }
+ *
+ * @param index An index built by tar_index_open().
+ * @param path A path to a directory in the archive, or an empty string for the root of the archive. If the entry is a
+ *             symlink, it is resolved to its linked-to entry.
+ * @param cursor An in-out argument. The caller set it to zero to start listing the directory, and then passes it back
+ *               unchanged to get the next pages.
+ * @param entries An array of max_entries entries to fill.
+ * @param max_entries The number of entries in `entries`.
+ *
+ * @return the number of entries listed, zero once the whole directory has been listed,
+ *         -1 if no directory at the given path exists in the archive.
+ */
+ssize_t list_next(const tar_index_t *index, const char *path, size_t *cursor, tar_dirent_t *entries,
+                  size_t max_entries);
+
+/**
+ * A read-only memory mapping of an archive.
+ *
+ * The archive is mapped once by tar_open_mmap() and indexed from the mapping, so that members can then be accessed
+ * without any read() nor copy.
+ */
+typedef struct tar_mmap tar_mmap_t;
+
+/**
+ * Maps an archive in memory and indexes its entries.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. It must stay open while the handle is used.
+ *
+ * @return a newly allocated handle to be released with tar_close_mmap(),
+ *         NULL if the archive could not be mapped or memory could not be allocated.
+ */
+tar_mmap_t *tar_open_mmap(int tar_fd);
+
+/**
+ * Unmaps an archive mapped by tar_open_mmap(). Pointers returned by tar_view() are no longer valid afterwards.
+ *
+ * @param handle The handle to release, may be NULL.
+ */
+void tar_close_mmap(tar_mmap_t *handle);
+
+/**
+ * Gives a direct view on the content of a file of the mapped archive, without copying it.
+ *
+ * @param handle A handle returned by tar_open_mmap().
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param ptr An out argument, set to the first byte of the file inside the mapping.
+ * @param len An out argument, set to the size of the file.
+ *
+ * @return zero on success,
+ *         -1 if no entry at the given path exists in the archive, the entry is not a file or is a sparse file, whose
+ *         holes are not stored in the archive.
+ */
+int tar_view(const tar_mmap_t *handle, const char *path, const uint8_t **ptr, size_t *len);
+
+/**
+ * Reads a file at a given path in the mapped archive, with the same semantics as read_file().
+ *
+ * @param handle A handle returned by tar_open_mmap().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return -1 if no entry at the given path exists in the archive or the entry is not a file,
+ *         -2 if the offset is outside the file total length,
+ *         zero if the file was read in its entirety into the destination buffer,
+ *         a positive value if the file was partially read, representing the remaining bytes left to be read to reach
+ *         the end of the file.
+ */
+ssize_t tar_mmap_read_file(const tar_mmap_t *handle, const char *path, size_t offset, uint8_t *dest, size_t *len);
+
+/**
+ * The decoded metadata of an entry, as filled by tar_stat_many().
+ */
+typedef struct {
+    int found;                    /* zero if no entry at the requested path exists in the archive */
+    char type;                    /* typeflag of the entry */
+    char sparse;                  /* TAR_SPARSE_NONE, TAR_SPARSE_GNU or TAR_SPARSE_PAX, see tar_entry_t */
+    uint64_t size;                /* size of the data of the entry */
+    uint64_t data_offset;         /* offset of the data in the archive */
+    char linkname[101];           /* target of the entry if it is a link, empty otherwise */
+} tar_stat_t;
+
+/**
+ * Looks up several paths in a single pass over the archive.
+ *
+ * The requested paths are put in a hash set and each entry of the archive is looked up in it, so the cost is linear in
+ * the number of entries plus the number of paths. Links are not resolved. If a path appears several times in the
+ * archive, the first entry is reported, as for exists().
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param paths The paths to look up, duplicates are allowed.
+ * @param n The number of paths.
+ * @param out An array of n results, out[i] is filled for paths[i].
+ *
+ * @return the number of paths found in the archive,
+ *         -1 if the archive could not be read or memory could not be allocated.
+ */
+ssize_t tar_stat_many(int tar_fd, const char **paths, size_t n, tar_stat_t *out);
+
+/**
+ * A request of read_files_v().
+ */
+typedef struct {
+    const char *path;             /* path of the file to read, links are resolved */
+    size_t offset;                /* offset in the file from which to start reading */
+    uint8_t *dest;                /* destination buffer */
+    size_t len;                   /* in: size of dest, out: number of bytes written to dest */
+    ssize_t result;               /* out: the value read_file() would return for this request */
+} tar_read_req_t;
+
+/**
+ * Reads several files of the archive at once, with the same semantics as read_file() for each of them.
+ *
+ * All the paths are resolved in a single pass over the archive, plus one pass per link hop shared by all the
+ * requests. The ranges to read are then sorted by offset in the archive, and neighbouring ranges are merged so that
+ * they are read with as few preadv() calls as possible.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param reqs An array of n requests. For each one, path, offset, dest and len are set by the caller, and len and
+ *             result are set by the callee as read_file() would set its len argument and return value.
+ * @param n The number of requests.
+ *
+ * @return the number of requests whose result is not negative,
+ *         -1 if the archive could not be read or memory could not be allocated.
+ */
+ssize_t read_files_v(int tar_fd, tar_read_req_t *reqs, size_t n);
+
+/**
+ * A regular file of an archive, opened for sequential or positioned reads.
+ *
+ * The path is resolved once by tar_fopen(), which remembers the offset and size of the file data: every read
+ * afterwards is a single pread() on the archive.
+ */
+typedef struct tar_file tar_file_t;
+
+/**
+ * Opens a file of the archive for reading.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. It must stay open while the file is used.
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ *
+ * @return a newly allocated file to be released with tar_fclose(),
+ *         NULL if no entry at the given path exists in the archive, the entry is not a file or memory could not be
+ *         allocated.
+ */
+tar_file_t *tar_fopen(int tar_fd, const char *path);
+
+/**
+ * Reads from the current position of a file and advances the position by the number of bytes read.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param buf A destination buffer.
+ * @param len The size of buf.
+ *
+ * @return the number of bytes read, zero at the end of the file,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_fread(tar_file_t *file, void *buf, size_t len);
+
+/**
+ * Moves the current position of a file, as lseek() does.
+ *
+ * SEEK_DATA and SEEK_HOLE move to the start of the next data segment or hole at or after offset, so that the holes
+ * of a sparse file can be recreated instead of written. A file that is not sparse has a single data segment, followed
+ * by the implicit hole at its end.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param offset The offset to move to, relative to whence.
+ * @param whence SEEK_SET, SEEK_CUR, SEEK_END, SEEK_DATA or SEEK_HOLE (the latter two need _GNU_SOURCE).
+ *
+ * @return the new position from the start of the file,
+ *         -1 if whence is invalid or the new position would be negative, or with SEEK_DATA and SEEK_HOLE if offset
+ *         is at or after the end of the file or no data follows it.
+ */
+off_t tar_fseek(tar_file_t *file, off_t offset, int whence);
+
+/**
+ * Reads from a given position of a file, without using nor modifying its current position.
+ *
+ * @param file A file opened by tar_fopen().
+ * @param buf A destination buffer.
+ * @param len The size of buf.
+ * @param offset The position in the file to read from.
+ *
+ * @return the number of bytes read, zero if offset is at or after the end of the file,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_pread(const tar_file_t *file, void *buf, size_t len, off_t offset);
+
+/**
+ * Gives the size of a file opened by tar_fopen().
+ *
+ * @param file A file opened by tar_fopen().
+ *
+ * @return the size of the file in bytes.
+ */
+uint64_t tar_fsize(const tar_file_t *file);
+
+/**
+ * Closes a file opened by tar_fopen().
+ *
+ * @param file The file to close, may be NULL.
+ */
+void tar_fclose(tar_file_t *file);
+
+/**
+ * The default distance in bytes of uncompressed data between two checkpoints of a compressed archive.
+ */
+#define TAR_GZ_DEFAULT_SPAN (4 * 1024 * 1024)
+
+/**
+ * A gzip-compressed archive opened for random access.
+ *
+ * tar_gz_open() decompresses the archive once, indexes its entries and records a checkpoint about every span bytes
+ * of uncompressed data, so that later reads only decompress from the closest checkpoint. A handle keeps a single
+ * decompression stream and must not be used by several threads at once.
+ */
+typedef struct tar_gz tar_gz_t;
+
+/**
+ * Opens a gzip-compressed archive and builds its checkpoint index.
+ *
+ * @param gz_fd A file descriptor pointing to a gzip-compressed tar archive. It must stay open while the handle is used.
+ * @param span The distance in bytes of uncompressed data between two checkpoints, zero selects TAR_GZ_DEFAULT_SPAN.
+ *
+ * @return a newly allocated handle to be released with tar_gz_close(),
+ *         NULL if the archive could not be read or decompressed or memory could not be allocated.
+ */
+tar_gz_t *tar_gz_open(int gz_fd, size_t span);
+
+/**
+ * Releases a handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @param gz The handle to release, may be NULL.
+ */
+void tar_gz_close(tar_gz_t *gz);
+
+/**
+ * Saves the checkpoint index of a compressed archive, so that later processes can load it with tar_gz_load() instead
+ * of decompressing the whole archive.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param checkpoint_path The path of the file to write, e.g. "archive.tar.gz.gzidx". It is replaced atomically.
+ *
+ * @return zero on success,
+ *         -1 if the archive could not be read or the file could not be written.
+ */
+int tar_gz_save(const tar_gz_t *gz, const char *checkpoint_path);
+
+/**
+ * Loads a checkpoint index saved by tar_gz_save(), without decompressing the archive.
+ *
+ * @param checkpoint_path The path of the checkpoint file.
+ * @param gz_fd A file descriptor pointing to the compressed archive the checkpoints were saved for.
+ *
+ * @return a newly allocated handle to be released with tar_gz_close(),
+ *         NULL if the file could not be read, is corrupted, or is stale because the archive changed since it was
+ *         saved (errno is then set to ESTALE).
+ */
+tar_gz_t *tar_gz_load(const char *checkpoint_path, int gz_fd);
+
+/**
+ * Checks whether the compressed archive is valid, see check_archive().
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @return the same values as check_archive().
+ */
+int tar_gz_check_archive(const tar_gz_t *gz);
+
+/**
+ * Gives the index of the entries of the compressed archive. It can be used with the tar_index_*() lookups and
+ * list_next(), but not to read files: use tar_gz_read_file() instead.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ *
+ * @return the index of the archive, valid as long as the handle.
+ */
+const tar_index_t *tar_gz_index(const tar_gz_t *gz);
+
+/**
+ * Checks whether an entry exists in the compressed archive.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive.
+ *
+ * @return zero if no entry at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_gz_exists(const tar_gz_t *gz, const char *path);
+
+/**
+ * Lists the entries at a given path in the compressed archive, see list().
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path exists in the archive,
+ *         any other value otherwise.
+ */
+int tar_gz_list(const tar_gz_t *gz, const char *path, char **entries, size_t *no_entries);
+
+/**
+ * Reads a file at a given path in the compressed archive, with the same semantics as read_file().
+ *
+ * Decompression starts from the closest checkpoint before the requested data, or continues from the previous read
+ * when it is closer.
+ *
+ * @param gz A handle opened by tar_gz_open() or tar_gz_load().
+ * @param path A path to an entry in the archive to read from.  If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_gz_read_file(tar_gz_t *gz, const char *path, size_t offset, uint8_t *dest, size_t *len);
+
+/**
+ * What tar_stream() should do with the data of an entry, as returned by on_entry.
+ */
+typedef enum {
+    TAR_STREAM_SKIP,   /* skip the data of the entry */
+    TAR_STREAM_DATA,   /* give the data of the entry to on_data */
+    TAR_STREAM_STOP,   /* stop the walk */
+} tar_stream_action_t;
+
+/**
+ * The callbacks of tar_stream().
+ *
+ * on_entry is called for each entry, the pointers in entry are valid until it returns.
+ * on_data is called with consecutive chunks of the data of an entry, offset being the position of data in the entry.
+ * It returns zero to continue, any other value to stop the walk.
+ */
+typedef struct {
+    tar_stream_action_t (*on_entry)(const tar_entry_t *entry, void *ctx);
+    int (*on_data)(const tar_entry_t *entry, const uint8_t *data, size_t len, uint64_t offset, void *ctx);
+} tar_stream_callbacks_t;
+
+/**
+ * Reads an archive in a single forward pass and calls the caller back for each entry, without seeking. This works on
+ * pipes, sockets and standard input as well as on regular files.
+ *
+ * Each header is validated as check_archive() does before on_entry is called, except that the GNU magic, "ustar  ",
+ * is accepted so that GNU archives and their sparse files can be streamed. The data of an entry is given to on_data
+ * if on_entry returns TAR_STREAM_DATA and skipped otherwise. For a sparse file, only its data segments are given, at
+ * their offset in the file: the holes between them are left to the caller.
+ *
+ * @param fd A file descriptor open for reading, positioned at the start of the archive. It is read up to the end of
+ *           the archive, or less if a callback stops the walk.
+ * @param callbacks The functions to call, either may be NULL. Without on_entry every entry is skipped, without on_data
+ *                  the data of every entry is skipped.
+ * @param ctx An opaque pointer given back to the callbacks.
+ *
+ * @return the number of entries visited, including the one whose callback stopped the walk,
+ *         -1 if an archive header contains an invalid magic value,
+ *         -2 if an archive header contains an invalid version value,
+ *         -3 if an archive header contains an invalid checksum value,
+ *         -4 if the archive could not be read or is truncated.
+ */
+ssize_t tar_stream(int fd, const tar_stream_callbacks_t *callbacks, void *ctx);
+
+/* Default maximum number of reads in flight of an asynchronous read engine */
+#define TAR_ASYNC_DEFAULT_DEPTH 256
+
+/* Flag of tar_async_open(): use the thread pool even if io_uring is available */
+#define TAR_ASYNC_FORCE_THREADS 1
+
+/**
+ * An asynchronous read engine on an indexed archive, see tar_async_open().
+ */
+typedef struct tar_async tar_async_t;
+
+/**
+ * A completed read, as returned by tar_async_poll() and tar_async_wait().
+ */
+typedef struct {
+    void *user_data;              /* the pointer given to tar_async_read() */
+    ssize_t result;               /* the value read_file() would return for this read */
+    size_t len;                   /* number of bytes written to the destination buffer */
+} tar_async_completion_t;
+
+/**
+ * Creates an asynchronous read engine on an indexed archive.
+ *
+ * io_uring is used when the kernel supports it, a pool of pread() threads otherwise. A handle is meant to be used by
+ * a single thread, which can keep up to depth reads in flight.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load(). It must stay open while the handle
+ *              is used.
+ * @param depth The maximum number of reads in flight, zero selects TAR_ASYNC_DEFAULT_DEPTH.
+ * @param flags Zero, or TAR_ASYNC_FORCE_THREADS to use the thread pool even if io_uring is available.
+ *
+ * @return a newly allocated handle to be released with tar_async_close(),
+ *         NULL if memory could not be allocated or the threads could not be started.
+ */
+tar_async_t *tar_async_open(const tar_index_t *index, unsigned depth, int flags);
+
+/**
+ * Gives the name of the backend used by an asynchronous read engine.
+ *
+ * @param a A handle returned by tar_async_open().
+ *
+ * @return "io_uring" or "threads".
+ */
+const char *tar_async_backend(const tar_async_t *a);
+
+/**
+ * Registers destination buffers, so that reads into them skip the mapping of user memory by the kernel. Only io_uring
+ * makes use of them, the call succeeds without effect with the thread pool.
+ *
+ * @param a A handle returned by tar_async_open(), with no read in flight.
+ * @param bufs The buffers to register. A read uses a registered buffer if its destination lies entirely inside it.
+ * @param n The number of buffers.
+ *
+ * @return zero on success,
+ *         -1 if reads are in flight, memory could not be allocated or the kernel refused the buffers.
+ */
+int tar_async_register_buffers(tar_async_t *a, const struct iovec *bufs, unsigned n);
+
+/**
+ * Submits an asynchronous read of a file of the archive, with the same semantics as read_file(). The path is
+ * resolved immediately in the index; the read itself completes later, see tar_async_poll() and tar_async_wait().
+ *
+ * Requests that need no read (no such file, offset after the end of the file) complete immediately, as do sparse
+ * files, which are read synchronously.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param path A path to an entry in the archive to read from. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer, which must stay valid until the read completes.
+ * @param len The size of dest.
+ * @param user_data An opaque pointer given back with the completion.
+ *
+ * @return zero if the request was accepted,
+ *         -1 if depth requests are already in flight (errno is then set to EAGAIN).
+ */
+int tar_async_read(tar_async_t *a, const char *path, size_t offset, uint8_t *dest, size_t len, void *user_data);
+
+/**
+ * Sends the submitted reads to the kernel if needed and collects the completed ones, without blocking.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param out An array of max completions.
+ * @param max The size of out.
+ *
+ * @return the number of completions written to out,
+ *         -1 if the reads could not be submitted.
+ */
+ssize_t tar_async_poll(tar_async_t *a, tar_async_completion_t *out, size_t max);
+
+/**
+ * Collects completed reads, blocking until at least min_complete of them are available or no read is left in flight.
+ *
+ * @param a A handle returned by tar_async_open().
+ * @param out An array of max completions.
+ * @param max The size of out.
+ * @param min_complete The number of completions to wait for, at most max.
+ *
+ * @return the number of completions written to out,
+ *         -1 if the reads could not be submitted.
+ */
+ssize_t tar_async_wait(tar_async_t *a, tar_async_completion_t *out, size_t max, size_t min_complete);
+
+/**
+ * Releases an asynchronous read engine, after waiting for the reads in flight. Their completions are discarded.
+ *
+ * @param a The handle to release, may be NULL.
+ */
+void tar_async_close(tar_async_t *a);
+
+/* Flag of tar_extract_options_t: remove subtree_prefix from the paths of the extracted entries */
+#define TAR_EXTRACT_STRIP_PREFIX 1
+
+/**
+ * The options of tar_extract().
+ */
+typedef struct {
+    int nthreads;                 /* number of writer threads, zero or a negative value uses one per online CPU */
+    int flags;                    /* zero or TAR_EXTRACT_STRIP_PREFIX */
+} tar_extract_options_t;
+
+/**
+ * Extracts an archive, or a subtree of it, to a directory.
+ *
+ * Directories are created first, then regular files are written by a pool of threads, their data being copied from
+ * the archive by the kernel (copy_file_range(), or sendfile()) without going through user space. Large files are
+ * preallocated and sparse files are written with their holes. Links are created last, and the modes and modification
+ * times of the headers are applied. Entries whose path contains a ".." component are skipped, leading '/' are
+ * removed, and devices and FIFOs are not extracted. Existing files are replaced, but existing symlinks are never
+ * followed: one in place of a directory is replaced by that directory, and one in place of a parent directory of an
+ * entry makes the extraction fail, so that nothing is written outside dest_dir. Unlike check_archive(), the GNU
+ * magic, "ustar  ", is accepted, so that GNU archives and their sparse files can be extracted.
+ *
+ * Outside the subtree, only the headers are looked at: the data of the skipped entries is jumped over.
+ *
+ * @param tar_fd A file descriptor pointing to a tar archive file. Its file offset is not used nor modified.
+ * @param subtree_prefix The entry to extract with its content, e.g. "dir/" or "dir", NULL or "" for the whole archive.
+ * @param dest_dir The directory to extract to, which must exist.
+ * @param options The number of threads and TAR_EXTRACT_* flags, NULL for the defaults.
+ *
+ * @return the number of entries extracted,
+ *         -1 if an archive header contains an invalid magic value,
+ *         -2 if an archive header contains an invalid version value,
+ *         -3 if an archive header contains an invalid checksum value,
+ *         -4 if the archive could not be read or an entry could not be created (errno is then set).
+ *         Nothing is undone on error.
+ */
+ssize_t tar_extract(int tar_fd, const char *subtree_prefix, const char *dest_dir,
+                    const tar_extract_options_t *options);
+
+/**
+ * A writer producing a tar archive, see tar_writer_open().
+ */
+typedef struct tar_writer tar_writer_t;
+
+/**
+ * Creates a writer producing a tar archive, in the format accepted by check_archive().
+ *
+ * @param out_fd A file descriptor open for writing, a regular file, a pipe or a socket. The archive is written from
+ *               its current position; it is not closed by tar_writer_close().
+ *
+ * @return a newly allocated writer to be released with tar_writer_close(),
+ *         NULL if memory could not be allocated.
+ */
+tar_writer_t *tar_writer_open(int out_fd);
+
+/**
+ * Adds a file of the file system to the archive: a regular file with its content, a directory, or a symlink, which is
+ * stored as such and not followed. The mode, owner and modification time of the file are kept.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param src_path The path of the file to add.
+ * @param archive_path The path of the entry in the archive.
+ *
+ * @return zero on success,
+ *         -1 if the file could not be read, is of another type, its archive path is longer than 256 bytes or, for a
+ *         symlink, its target longer than 100 bytes (ENAMETOOLONG, the longest this library reads back), or the
+ *         archive could not be written (errno is then set). After a write error the archive is unusable and every
+ *         later call fails.
+ */
+int tar_add_file(tar_writer_t *w, const char *src_path, const char *archive_path);
+
+/**
+ * Adds several files of the file system to the archive, as tar_add_file() would one after the other. The files are
+ * opened and stat'ed by a pool of threads ahead of the writing, which follows the order of the arrays so that the
+ * archive does not depend on the scheduling.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param src_paths The paths of the files to add.
+ * @param archive_paths The paths of the entries in the archive, in the same order.
+ * @param n The number of files.
+ * @param nthreads The number of threads opening files, zero or a negative value uses one per online CPU.
+ *
+ * @return zero on success,
+ *         -1 on the first file that could not be added, see tar_add_file(). The files before it are in the archive.
+ */
+int tar_add_files(tar_writer_t *w, const char *const *src_paths, const char *const *archive_paths, size_t n,
+                  int nthreads);
+
+/**
+ * Adds a directory entry to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the directory in the archive, a '/' is appended if it has none.
+ * @param mode The permission bits of the directory.
+ *
+ * @return zero on success,
+ *         -1 if the path, '/' included, is longer than 256 bytes (errno is then set to ENAMETOOLONG) or the archive
+ *         could not be written (errno is then set).
+ */
+int tar_add_dir(tar_writer_t *w, const char *archive_path, mode_t mode);
+
+/**
+ * Adds a symlink entry to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the symlink in the archive.
+ * @param target The path the symlink points to.
+ *
+ * @return zero on success,
+ *         -1 if the path is longer than 256 bytes or the target longer than 100 bytes (errno is then set to
+ *         ENAMETOOLONG) or the archive could not be written (errno is then set).
+ */
+int tar_add_symlink(tar_writer_t *w, const char *archive_path, const char *target);
+
+/**
+ * Adds a regular file with the given content to the archive, owned by root and dated from the opening of the writer.
+ *
+ * @param w A writer returned by tar_writer_open().
+ * @param archive_path The path of the file in the archive.
+ * @param data The content of the file, which can be reused as soon as the call returns.
+ * @param len The size of data.
+ * @param mode The permission bits of the file.
+ *
+ * @return zero on success,
+ *         -1 if the path is longer than 256 bytes (errno is then set to ENAMETOOLONG) or the archive could not be
+ *         written (errno is then set).
+ */
+int tar_add_buffer(tar_writer_t *w, const char *archive_path, const void *data, size_t len, mode_t mode);
+
+/**
+ * Writes the end of the archive and releases a writer.
+ *
+ * @param w The writer to release, may be NULL.
+ *
+ * @return zero if the whole archive was written,
+ *         -1 if an earlier call failed to write or the end of the archive could not be written (errno is then set).
+ */
+int tar_writer_close(tar_writer_t *w);
+
+/**
+ * The functions whose calls are counted and timed, see tar_stats_t.
+ */
+typedef enum {
+    TAR_FN_CHECK_ARCHIVE,         /* check_archive() and check_archive_r() */
+    TAR_FN_EXISTS,                /* exists() and exists_r() */
+    TAR_FN_IS_DIR,                /* is_dir() and is_dir_r() */
+    TAR_FN_IS_FILE,               /* is_file() and is_file_r() */
+    TAR_FN_IS_SYMLINK,            /* is_symlink() and is_symlink_r() */
+    TAR_FN_LIST,                  /* list() and list_r() */
+    TAR_FN_READ_FILE,             /* read_file() and read_file_r() */
+    TAR_FN_INDEX_READ_FILE,       /* tar_index_read_file() */
+    TAR_FN_COUNT,
+} tar_fn_t;
+
+/**
+ * The input/output activity of the library.
+ */
+typedef struct {
+    uint64_t read_calls;          /* read(), pread() and preadv() calls on archives */
+    uint64_t bytes_read;          /* bytes returned by those reads */
+    uint64_t headers_decoded;     /* header blocks decoded, pax and GNU extension blocks included */
+    uint64_t checksums;           /* header checksums computed */
+} tar_io_stats_t;
+
+/**
+ * The counters of a thread, see tar_stats_snapshot(), or of an index, see tar_index_stats().
+ */
+typedef struct {
+    tar_io_stats_t io;
+    uint64_t calls[TAR_FN_COUNT];     /* number of calls to each instrumented function */
+    uint64_t wall_ns[TAR_FN_COUNT];   /* time spent in each instrumented function, in nanoseconds */
+} tar_stats_t;
+
+/**
+ * A hook called at the end of each call to an instrumented function, see tar_stats_set_trace().
+ *
+ * @param fn The function that returns.
+ * @param path The path given to the function, NULL for check_archive().
+ * @param io The input/output activity of the call.
+ * @param wall_ns The duration of the call, in nanoseconds.
+ * @param ctx The pointer given to tar_stats_set_trace().
+ */
+typedef void (*tar_trace_hook_t)(tar_fn_t fn, const char *path, const tar_io_stats_t *io, uint64_t wall_ns, void *ctx);
+
+/**
+ * Copies the counters of the calling thread: the system calls it made on archives and the work it did since it
+ * started or since its last tar_stats_reset(), and the number and duration of its calls to the instrumented
+ * functions. Work done by the threads the library starts itself (parallel validation, extraction, asynchronous reads)
+ * is counted in those threads and not reported.
+ *
+ * @param out An out argument, set to the counters of the calling thread.
+ */
+void tar_stats_snapshot(tar_stats_t *out);
+
+/**
+ * Sets the counters of the calling thread to zero.
+ */
+void tar_stats_reset(void);
+
+/**
+ * Gives the name of an instrumented function, e.g. "exists" for TAR_FN_EXISTS.
+ *
+ * @param fn A function of tar_fn_t.
+ *
+ * @return the name of the function, or NULL if fn is out of range.
+ */
+const char *tar_stats_fn_name(tar_fn_t fn);
+
+/**
+ * Installs a hook called at the end of every call to an instrumented function, in the calling thread, with the
+ * activity of that call. It is meant to export the counters to a metrics pipeline and must be fast: it runs on the
+ * lookup path. The hook and its context are replaced together: a call that ends in another thread meanwhile is
+ * traced either by the old pair or by the new one.
+ *
+ * @param hook The function to call, or NULL to remove the hook.
+ * @param ctx An opaque pointer given back to the hook.
+ */
+void tar_stats_set_trace(tar_trace_hook_t hook, void *ctx);
+
+/**
+ * Copies the counters of an index: the activity of all the calls made on it, by any thread.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ * @param out An out argument, set to the counters of the index.
+ */
+void tar_index_stats(const tar_index_t *index, tar_stats_t *out);
+
+/**
+ * Sets the counters of an index to zero.
+ *
+ * @param index An index built by tar_index_open() or loaded by tar_index_load().
+ */
+void tar_index_stats_reset(tar_index_t *index);
+
+/*
+ * Overlay of several archives, as the layers of a container image.
+ */
+typedef struct tar_overlay tar_overlay_t;
+
+/**
+ * Opens an overlay of several archives, as the layers of a container image: a path is looked up from the topmost
+ * layer down and the first layer holding it wins. Whiteout entries (".wh.<name>" hides <name> from the lower layers,
+ * ".wh..wh..opq" hides the whole content of its directory) are honoured, and are themselves invisible. As in an index,
+ * a symlink met as a directory of a path is followed, from layer to layer, by every function.
+ *
+ * The headers of each layer are read once to build a Bloom filter of its paths, so that a lookup skips, without any
+ * read, the layers that do not hold the path. The index of a layer is built the first time a lookup needs it.
+ *
+ * @param fds File descriptors pointing to valid tar archive files, from the topmost layer to the lowest. They must
+ *            stay open while the overlay is used.
+ * @param n The number of layers.
+ *
+ * @return a newly allocated overlay to be released with tar_overlay_close(),
+ *         NULL if a layer could not be read or memory could not be allocated.
+ */
+tar_overlay_t *tar_overlay_open(const int *fds, size_t n);
+
+/**
+ * Releases an overlay opened by tar_overlay_open(). The file descriptors of the layers are not closed.
+ *
+ * @param ov The overlay to release, may be NULL.
+ */
+void tar_overlay_close(tar_overlay_t *ov);
+
+/**
+ * Checks whether an entry exists in the overlay.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay,
+ *         any other value otherwise.
+ */
+int tar_overlay_exists(const tar_overlay_t *ov, const char *path);
+
+/**
+ * Checks whether an entry exists in the overlay and is a directory.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a directory,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_dir(const tar_overlay_t *ov, const char *path);
+
+/**
+ * Checks whether an entry exists in the overlay and is a file.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a file,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_file(const tar_overlay_t *ov, const char *path);
+
+/**
+ * Checks whether an entry exists in the overlay and is a symlink.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry.
+ *
+ * @return zero if no entry at the given path is visible in the overlay or the entry is not a symlink,
+ *         any other value otherwise.
+ */
+int tar_overlay_is_symlink(const tar_overlay_t *ov, const char *path);
+
+/**
+ * Reads a file of the overlay, from the topmost layer that holds it. Symlinks are followed from layer to layer.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to an entry to read from. If the entry is a symlink, it is resolved to its linked-to entry.
+ * @param offset An offset in the file from which to start reading from, zero indicates the start of the file.
+ * @param dest A destination buffer to read the given file into.
+ * @param len An in-out argument.
+ *            The caller set it to the size of dest.
+ *            The callee set it to the number of bytes written to dest.
+ *
+ * @return the same values as read_file().
+ */
+ssize_t tar_overlay_read_file(const tar_overlay_t *ov, const char *path, size_t offset, uint8_t *dest, size_t *len);
+
+/**
+ * Lists the entries of a directory of the overlay, merged across the layers: an entry of an upper layer hides the
+ * entry of the same name in the lower ones, and whited-out entries are not listed. As list(), it does not recurse into the
+ * directories listed at the given path.
+ *
+ * @param ov An overlay opened by tar_overlay_open().
+ * @param path A path to a directory, or an empty string for the root. If the entry is a symlink, it is resolved to its
+ *             linked-to entry.
+ * @param entries An array of char arrays, each one is long enough to contain a tar entry path.
+ * @param no_entries An in-out argument.
+ *                   The caller set it to the number of entries in `entries`.
+ *                   The callee set it to the number of entries listed.
+ *
+ * @return zero if no directory at the given path is visible in the overlay,
+ *         any other value otherwise.
+ */
+int tar_overlay_list(const tar_overlay_t *ov, const char *path, char **entries, size_t *no_entries);
+
+/*
+ * Compact table of the paths of very large archives.
+ */
+typedef struct tar_path_table tar_path_table_t;
+
+/* Bytes per entry a path table stays under for a catalog of packages, see tar_path_table_open() */
+#define TAR_PATH_TABLE_BUDGET 32
+
+/**
+ * The record of a path in a path table, as decoded by tar_path_table_get().
+ */
+typedef struct {
+    char type;                    /* typeflag of the entry */
+    uint64_t size;                /* size of the data of the entry, holes included for a sparse file */
+    uint64_t data_offset;         /* offset of the data in the archive, or of the sparse map for a sparse file */
+} tar_path_record_t;
+
+/**
+ * Builds a compact table of the paths of the archive in a single pass.
+ *
+ * Unlike an index, the table keeps no tree of the directories, no links and no hash table: it is meant to hold the
+ * catalog of very large archives in memory. Paths are sorted, deduplicated (the first entry of a path wins, as in the
+ * other lookups) and front-coded by blocks of 16 in a single arena, the type, size and data offset of each entry are
+ * kept in fixed-width arrays. Lookups are binary searches over the first paths of the blocks, stored in full.
+ *
+ * A table costs 17 bytes of fixed-width record per entry, 4 bytes per block of 16 entries, and for each path the
+ * bytes it does not share with the previous one plus two length bytes (one for the first path of a block), as long
+ * as paths and suffixes are shorter than 128 bytes. For a catalog of packages, where consecutive paths share most of
+ * their bytes, this stays under TAR_PATH_TABLE_BUDGET bytes per entry.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ *
+ * @return a newly allocated table to be released with tar_path_table_close(),
+ *         NULL if the archive could not be read or memory could not be allocated.
+ */
+tar_path_table_t *tar_path_table_open(int tar_fd);
+
+/**
+ * Releases a table built by tar_path_table_open().
+ *
+ * @param table The table to release, may be NULL.
+ */
+void tar_path_table_close(tar_path_table_t *table);
+
+/**
+ * Returns the number of distinct paths in the table.
+ *
+ * @param table A table built by tar_path_table_open().
+ *
+ * @return the number of paths, which are ranked from zero in byte order.
+ */
+size_t tar_path_table_count(const tar_path_table_t *table);
+
+/**
+ * Returns the memory held by the table, to be compared with TAR_PATH_TABLE_BUDGET times its number of paths.
+ *
+ * @param table A table built by tar_path_table_open().
+ *
+ * @return the number of bytes allocated for the table.
+ */
+size_t tar_path_table_memory(const tar_path_table_t *table);
+
+/**
+ * Looks up a path in the table. A directory is found with or without its trailing '/'.
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param path A path to an entry in the archive.
+ *
+ * @return the rank of the path in the table,
+ *         -1 if no entry at the given path exists in the archive.
+ */
+ssize_t tar_path_table_find(const tar_path_table_t *table, const char *path);
+
+/**
+ * Finds the range of paths that start with a given prefix. As the paths are sorted, they are consecutive.
+ *
+ * Example, to visit a subtree:
+ *  size_t first, end;
+ *  tar_path_table_prefix(table, "usr/share/", &first, &end);
+ *  for (size_t rank = first; rank < end; rank++) {
+ *      tar_path_table_get(table, rank, path, sizeof(path), &record);
+ *  }
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param prefix A prefix of paths, an empty string for all the paths.
+ * @param first An out argument, set to the rank of the first path starting with the prefix.
+ * @param end An out argument, set to the rank following the last path starting with the prefix.
+ *
+ * @return the number of paths starting with the prefix.
+ */
+size_t tar_path_table_prefix(const tar_path_table_t *table, const char *prefix, size_t *first, size_t *end);
+
+/**
+ * Decodes the path and the record at a given rank of the table.
+ *
+ * @param table A table built by tar_path_table_open().
+ * @param rank The rank of the path, lower than tar_path_table_count().
+ * @param path A destination buffer for the path, NUL-terminated, may be NULL.
+ * @param path_size The size of path, the path is truncated to fit.
+ * @param record An out argument set to the type, size and data offset of the entry, may be NULL.
+ *
+ * @return the length of the path,
+ *         -1 if the rank is out of the table.
+ */
+ssize_t tar_path_table_get(const tar_path_table_t *table, size_t rank, char *path, size_t path_size,
+                           tar_path_record_t *record);
+
+/*
+ * Search of the entries by pattern.
+ */
+
+/* Flag of tar_find(): the pattern is a literal prefix rather than a glob */
+#define TAR_FIND_PREFIX 1
+/* Flag of tar_find(): also match the entries below a matching directory, or every path starting with the prefix */
+#define TAR_FIND_RECURSIVE 2
+
+/**
+ * The function called by tar_find() with each matching entry and its type, size and data offset.
+ *
+ * It returns zero to continue, any other value to stop the search.
+ */
+typedef int (*tar_find_callback_t)(const char *path, const tar_path_record_t *record, void *ctx);
+
+/**
+ * Finds the entries of an archive whose path matches a pattern, in a single pass over the archive.
+ *
+ * The pattern is a glob, as for fnmatch(3) where '*' and '?' do not match a '/', or with TAR_FIND_PREFIX a literal
+ * prefix. A directory is matched by its path without its trailing '/', e.g. the pattern "etc/conf*" matches the
+ * directory "etc/config/". Without TAR_FIND_RECURSIVE, a prefix only matches the paths that have no '/' after it; with it, a
+ * prefix matches every path starting with it and a glob also matches every entry below a matching directory.
+ *
+ * An entry stored several times in the archive is reported each time it is found.
+ *
+ * @param tar_fd A file descriptor pointing to a valid tar archive file. Its file offset is not used nor modified.
+ * @param pattern The pattern to match the paths against.
+ * @param flags Zero, or a combination of TAR_FIND_PREFIX and TAR_FIND_RECURSIVE.
+ * @param callback The function called with each matching entry, in archive order. The path is valid until it returns.
+ *                 It returns zero to continue, any other value to stop the search.
+ * @param ctx An opaque pointer given back to the callback.
+ *
+ * @return the number of matching entries reported, including the one whose callback stopped the search,
+ *         -1 if the archive could not be read.
+ */
+ssize_t tar_find(int tar_fd, const char *pattern, int flags, tar_find_callback_t callback, void *ctx);
+
+/**
+ * Finds the entries of an indexed archive whose path matches a pattern, as tar_find().
+ *
+ * The entries of the index are sorted by path: a binary search finds the first path starting with the literal part of
+ * the pattern, up to its first special character, and only the following paths that start with it are examined. An
+ * entry stored several times in the archive is reported once, as its first occurrence, the one the other lookups of the
+ * index return.
+ *
+ * @param index An index built by tar_index_open().
+ * @param pattern The pattern to match the paths against.
+ * @param flags Zero, or a combination of TAR_FIND_PREFIX and TAR_FIND_RECURSIVE.
+ * @param callback The function called with each matching entry, in byte order of the paths. It returns zero to
+ *                 continue, any other value to stop the search.
+ * @param ctx An opaque pointer given back to the callback.
+ *
+ * @return the number of matching entries reported, including the one whose callback stopped the search.
+ */
+ssize_t tar_index_find(const tar_index_t *index, const char *pattern, int flags, tar_find_callback_t callback,
+                       void *ctx);
+
 #endif
@@ -1,7 +1,12 @@
+#define _GNU_SOURCE  // pour SEEK_DATA et SEEK_HOLE
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
 
 #include "lib_tar.h"
 
@@ -111,6 +116,1408 @@ void test_read_file(int fd, const char *path, size_t offset, size_t buffer_size)
     }
 }
 
+void test_index(tar_index_t *index, const char *path) {
+    printf("Index '%s' : exists=%d is_dir=%d is_file=%d is_symlink=%d\n", path,
+           tar_index_exists(index, path), tar_index_is_dir(index, path),
+           tar_index_is_file(index, path), tar_index_is_symlink(index, path));
+}
+
+void test_mmap(tar_mmap_t *handle, const char *path, size_t offset, size_t buffer_size) {
+    const uint8_t *data;
+    size_t size;
+    if (tar_view(handle, path, &data, &size) == 0) {
+        printf("Vue sur '%s' : %zu octets\n", path, size);
+    } else {
+        printf("Pas de vue possible sur '%s'\n", path);
+    }
+
+    uint8_t buffer[buffer_size];
+    size_t len = buffer_size;
+    ssize_t result = tar_mmap_read_file(handle, path, offset, buffer, &len);
+    printf("tar_mmap_read_file('%s', %zu) a retourné %zd, octets lus : %zu\n", path, offset, result, len);
+}
+
+struct concurrent_args {
+    int fd;
+    int errors;
+};
+
+void *concurrent_worker(void *arg) {
+    struct concurrent_args *args = arg;
+    uint8_t buffer[64];
+    for (int i = 0; i < 200; i++) {
+        size_t len = sizeof(buffer);
+        if (read_file_r(args->fd, "file1.txt", i, buffer, &len) <= 0 || len != sizeof(buffer)
+            || !exists_r(args->fd, "dir/c/d") || is_dir_r(args->fd, "file1.txt")) {
+            args->errors++;
+        }
+    }
+    return NULL;
+}
+
+void test_concurrent(int fd, int nthreads) {
+    pthread_t threads[nthreads];
+    struct concurrent_args args[nthreads];
+    int errors = 0;
+
+    for (int i = 0; i < nthreads; i++) {
+        args[i].fd = fd;
+        args[i].errors = 0;
+        pthread_create(&threads[i], NULL, concurrent_worker, &args[i]);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+    printf("%d threads sur le même descripteur : %d erreurs\n", nthreads, errors);
+}
+
+void test_chksum(int fd) {
+    tar_header_t header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        printf("Erreur lors de la lecture du premier en-tête\n");
+        return;
+    }
+    unsigned int stored = TAR_INT(header.chksum);
+    tar_chksum_impl_t impls[] = {TAR_CHKSUM_SCALAR, TAR_CHKSUM_SSE2, TAR_CHKSUM_AVX2, TAR_CHKSUM_AVX512};
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (tar_chksum_select(impls[i]) == 0) {
+            unsigned int computed = tar_header_chksum(&header);
+            printf("Somme de contrôle %s : %s\n", tar_chksum_impl_name(), computed == stored ? "correcte" : "INCORRECTE");
+        }
+    }
+    tar_chksum_select(TAR_CHKSUM_AUTO);
+}
+
+/* Compare check_archive_parallel() à check_archive() sur une copie de l'archive dont un octet est modifié */
+/* Remplace l'octet field de l'en-tête de la n-ième entrée (aucune si n < 0) et compare les deux validations */
+void test_check_parallel(int fd, int n, size_t field, char value, int expected) {
+    off_t corrupt_at = -1;
+    if (n >= 0) {
+        tar_iter_t *it = tar_iter_open(fd, 0);
+        tar_entry_t entry;
+        for (int i = 0; i <= n && tar_iter_next(it, &entry) == 1; i++) {
+            corrupt_at = entry.data_offset - 512;
+        }
+        tar_iter_close(it);
+        corrupt_at += field;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    uint8_t *content = malloc(st.st_size);
+    pread(fd, content, st.st_size, 0);
+    if (corrupt_at >= 0) {
+        content[corrupt_at] = value;
+    }
+
+    FILE *copy = tmpfile();
+    fwrite(content, 1, st.st_size, copy);
+    fflush(copy);
+    int copy_fd = fileno(copy);
+
+    int serial = check_archive_r(copy_fd);
+    int parallel = check_archive_parallel(copy_fd, 4);
+    printf("Octet %lld modifié : check_archive=%d check_archive_parallel=%d %s, %s\n", (long long)corrupt_at,
+           serial, parallel, serial == parallel ? "(identiques)" : "(DIFFÉRENTS)",
+           expected == 0 ? (serial > 0 ? "archive valide" : "ARCHIVE REFUSÉE")
+                         : (serial == expected ? "code attendu" : "CODE INATTENDU"));
+
+    fclose(copy);
+    free(content);
+}
+
+void test_iter(int fd, size_t chunk_size) {
+    tar_iter_t *it = tar_iter_open(fd, chunk_size);
+    tar_entry_t entry;
+    int ret, count = 0;
+    while ((ret = tar_iter_next(it, &entry)) == 1) {
+        printf("  %c %8llu @%-6llu %s\n", entry.type ? entry.type : '0', (unsigned long long)entry.size,
+               (unsigned long long)entry.data_offset, entry.path);
+        count++;
+    }
+    printf("Itérateur (morceaux de %zu octets) : %d entrées, retour final %d\n", chunk_size, count, ret);
+    tar_iter_close(it);
+}
+
+void test_stat_many(int fd) {
+    const char *paths[] = {"file1.txt", "dir/", "nonexistent", "link_to_file", "dir/c/d", "file1.txt"};
+    size_t n = sizeof(paths) / sizeof(paths[0]);
+    tar_stat_t stats[n];
+
+    ssize_t found = tar_stat_many(fd, paths, n, stats);
+    printf("tar_stat_many a trouvé %zd chemins sur %zu\n", found, n);
+    for (size_t i = 0; i < n; i++) {
+        if (stats[i].found) {
+            printf("  %s : type '%c', %llu octets @%llu, lien '%s'\n", paths[i], stats[i].type,
+                   (unsigned long long)stats[i].size, (unsigned long long)stats[i].data_offset, stats[i].linkname);
+        } else {
+            printf("  %s : absent\n", paths[i]);
+        }
+    }
+}
+
+void test_read_files_v(int fd) {
+    const char *paths[] = {"links/chain1", "file1.txt", "dir/", "nonexistent", "link_to_file", "file1.txt",
+                           "links/to_dir/a", "file1.txt", "links/loop_a"};
+    size_t offsets[] = {0, 0, 0, 0, 0, 9800, 0, 20000, 0};
+    size_t n = sizeof(paths) / sizeof(paths[0]);
+    static uint8_t buffers[9][4096], expected[4096];
+    tar_read_req_t reqs[n];
+
+    for (size_t i = 0; i < n; i++) {
+        reqs[i] = (tar_read_req_t){paths[i], offsets[i], buffers[i], sizeof(buffers[i]), 0};
+    }
+    ssize_t served = read_files_v(fd, reqs, n);
+    printf("read_files_v a servi %zd requêtes sur %zu\n", served, n);
+    for (size_t i = 0; i < n; i++) {
+        // Chaque requête doit donner le même résultat que read_file()
+        size_t len = sizeof(expected);
+        ssize_t ret = read_file(fd, (char *)paths[i], offsets[i], expected, &len);
+        int same = ret == reqs[i].result && len == reqs[i].len && memcmp(expected, buffers[i], len) == 0;
+        printf("  %s @%zu : %zd, %zu octets, %s\n", paths[i], offsets[i], reqs[i].result, reqs[i].len,
+               same ? "comme read_file" : "DIFFÉRENT DE read_file");
+    }
+    printf("read_files_v sans requête : %zd, sur un descripteur invalide : %zd\n", read_files_v(fd, reqs, 0),
+           read_files_v(-1, reqs, n));
+
+    // Les chemins absents sont confirmés dès le premier parcours, et les liens d'un même saut partagent le suivant
+    const char *missing[] = {"nonexistent", "dir/nonexistent", "file1.txt", "link_to_file", "links/to_dir/a"};
+    size_t n_missing = sizeof(missing) / sizeof(missing[0]);
+    tar_stats_t before, after;
+    tar_stats_snapshot(&before);
+    const char *one[] = {"nonexistent"};
+    tar_stat_t st;
+    tar_stat_many(fd, one, 1, &st);
+    tar_stats_snapshot(&after);
+    uint64_t per_scan = after.io.headers_decoded - before.io.headers_decoded;
+    for (size_t i = 0; i < n_missing; i++) {
+        reqs[i] = (tar_read_req_t){missing[i], 0, buffers[i], sizeof(buffers[i]), 0};
+    }
+    served = read_files_v(fd, reqs, n_missing);
+    tar_stats_snapshot(&before);
+    printf("read_files_v sur des chemins absents et des liens : %zd requêtes servies en %llu parcours\n", served,
+           (unsigned long long)((before.io.headers_decoded - after.io.headers_decoded) / per_scan));
+}
+
+void test_list_next(tar_index_t *index, const char *path, size_t page_size) {
+    tar_dirent_t page[page_size];
+    size_t cursor = 0;
+    ssize_t n;
+    int pages = 0;
+
+    printf("Listing paginé de '%s' par pages de %zu :\n", path, page_size);
+    while ((n = list_next(index, path, &cursor, page, page_size)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            printf("  [page %d] %s ('%c', %llu octets)\n", pages, page[i].path, page[i].type ? page[i].type : '0',
+                   (unsigned long long)page[i].size);
+        }
+        pages++;
+    }
+    if (n == -1) {
+        printf("  '%s' n'est pas un répertoire\n", path);
+    }
+}
+
+/* Lit un fichier par morceaux avec tar_fread() et compare au résultat de read_file() */
+void test_fread(int fd, const char *path, size_t chunk) {
+    tar_file_t *file = tar_fopen(fd, path);
+    if (file == NULL) {
+        printf("tar_fopen('%s') a échoué\n", path);
+        return;
+    }
+
+    uint64_t size = tar_fsize(file);
+    uint8_t *expected = malloc(size);
+    uint8_t *content = malloc(size);
+    uint8_t buffer[chunk];
+    size_t len = size;
+    read_file(fd, (char *)path, 0, expected, &len);
+
+    size_t total = 0;
+    ssize_t n;
+    int chunks = 0;
+    while ((n = tar_fread(file, buffer, chunk)) > 0) {
+        memcpy(content + total, buffer, n);
+        total += n;
+        chunks++;
+    }
+    printf("tar_fread('%s') : %zu octets en %d morceaux, contenu %s\n", path, total, chunks,
+           total == size && memcmp(content, expected, size) == 0 ? "identique" : "DIFFÉRENT");
+
+    tar_fseek(file, -10, SEEK_END);
+    n = tar_fread(file, buffer, chunk);
+    printf("  après tar_fseek(-10, SEEK_END) : %zd octets lus, tar_pread au-delà de la fin : %zd\n", n,
+           tar_pread(file, buffer, chunk, size + 1));
+
+    free(expected);
+    free(content);
+    tar_fclose(file);
+}
+
+void test_sidecar(int fd, tar_index_t *index, const char *sidecar_path) {
+    if (tar_index_save(index, sidecar_path) == -1) {
+        perror("tar_index_save");
+        return;
+    }
+    tar_index_t *loaded = tar_index_load(sidecar_path, fd);
+    if (loaded == NULL) {
+        perror("tar_index_load");
+        return;
+    }
+    printf("Index rechargé depuis '%s' :\n", sidecar_path);
+    test_index(loaded, "dir/c/d");
+    test_index(loaded, "nonexistent");
+    test_list_next(loaded, "link_to_dir", 10);
+
+    uint8_t buffer[16];
+    size_t len = sizeof(buffer);
+    ssize_t result = tar_index_read_file(loaded, "links/chain1", 9820, buffer, &len);
+    printf("tar_index_read_file('links/chain1', 9820) a retourné %zd, octets lus : %zu\n", result, len);
+    tar_index_close(loaded);
+
+    // Un index corrompu doit être refusé : offset de chaîne hors de l'arène, nombre d'entrées dont la taille déborde,
+    // fichier tronqué. Les champs de l'en-tête sont à des positions fixes : n_entries à 48, entries_off à 72.
+    const struct {
+        const char *label;
+        off_t offset;             // -1 pour tronquer le fichier
+        uint64_t value;
+        int relative;             // offset relatif au tableau des entrées, la valeur est alors sur 32 bits
+    } corruptions[] = {
+        {"chemin hors de l'arène", 16, 0xffffff00, 1},
+        {"enfant hors du tableau", 32, 0x7fffffff, 1},
+        {"nombre d'entrées démesuré", 48, 1ULL << 61, 0},
+        {"fichier tronqué", -1, 0, 0},
+    };
+    for (size_t i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); i++) {
+        tar_index_save(index, sidecar_path);
+        int sidecar = open(sidecar_path, O_RDWR);
+        uint64_t entries_off = 0;
+        pread(sidecar, &entries_off, sizeof(entries_off), 72);
+        if (corruptions[i].offset == -1) {
+            struct stat st;
+            fstat(sidecar, &st);
+            ftruncate(sidecar, st.st_size / 2);
+        } else if (corruptions[i].relative) {
+            uint32_t value = corruptions[i].value;
+            pwrite(sidecar, &value, sizeof(value), entries_off + corruptions[i].offset);
+        } else {
+            pwrite(sidecar, &corruptions[i].value, sizeof(uint64_t), corruptions[i].offset);
+        }
+        close(sidecar);
+        loaded = tar_index_load(sidecar_path, fd);
+        printf("Index corrompu (%s) : %s\n", corruptions[i].label,
+               loaded == NULL && errno == EINVAL ? "refusé" : "ACCEPTÉ");
+        tar_index_close(loaded);
+    }
+
+    // Un index dont l'archive a changé doit être refusé
+    tar_index_save(index, sidecar_path);
+    int other = open(sidecar_path, O_RDONLY);
+    loaded = tar_index_load(sidecar_path, other);
+    printf("Index chargé pour une autre archive : %s\n", loaded == NULL && errno == ESTALE ? "refusé" : "ACCEPTÉ");
+    tar_index_close(loaded);
+    close(other);
+    unlink(sidecar_path);
+}
+
+struct trace_ctx {
+    int calls;
+    uint64_t bytes_read;
+    char last_path[64];
+    tar_fn_t last_fn;
+};
+
+void trace_hook(tar_fn_t fn, const char *path, const tar_io_stats_t *io, uint64_t wall_ns, void *ctx) {
+    struct trace_ctx *trace = ctx;
+    trace->calls++;
+    trace->bytes_read += io->bytes_read;
+    trace->last_fn = fn;
+    snprintf(trace->last_path, sizeof(trace->last_path), "%s", path != NULL ? path : "(null)");
+}
+
+void test_stats(int fd, tar_index_t *index) {
+    tar_stats_t stats;
+    uint8_t buffer[1024];
+    size_t len = sizeof(buffer);
+
+    tar_stats_reset();
+    int headers = check_archive(fd);
+    tar_stats_snapshot(&stats);
+    printf("check_archive : %llu appel(s), %s lecture(s), sommes de contrôle %s, en-têtes décodés %s\n",
+           (unsigned long long)stats.calls[TAR_FN_CHECK_ARCHIVE], stats.io.read_calls > 0 ? "des" : "AUCUNE",
+           stats.io.checksums == (uint64_t)headers ? "une par en-tête" : "EN NOMBRE INATTENDU",
+           stats.io.headers_decoded == (uint64_t)headers ? "un par en-tête" : "EN NOMBRE INATTENDU");
+
+    tar_stats_reset();
+    exists(fd, "nonexistent");
+    read_file(fd, "file1.txt", 0, buffer, &len);
+    tar_stats_snapshot(&stats);
+    printf("exists + read_file : %llu + %llu appel(s), %llu octets lus au moins, aucune somme de contrôle : %s, "
+           "durées %s\n",
+           (unsigned long long)stats.calls[TAR_FN_EXISTS], (unsigned long long)stats.calls[TAR_FN_READ_FILE],
+           stats.io.bytes_read >= sizeof(buffer) ? (unsigned long long)sizeof(buffer) : 0ULL,
+           stats.io.checksums == 0 ? "oui" : "NON",
+           stats.wall_ns[TAR_FN_EXISTS] > 0 && stats.wall_ns[TAR_FN_READ_FILE] > 0 ? "mesurées" : "NULLES");
+
+    // Le crochet reçoit chaque appel avec son chemin et son activité
+    struct trace_ctx trace = {0};
+    tar_stats_set_trace(trace_hook, &trace);
+    is_dir(fd, "dir/");
+    len = sizeof(buffer);
+    read_file(fd, "dir/a", 0, buffer, &len);
+    tar_stats_set_trace(NULL, NULL);
+    is_file(fd, "file1.txt");
+    printf("Trace : %d appel(s), dernier %s('%s'), octets lus %s\n", trace.calls, tar_stats_fn_name(trace.last_fn),
+           trace.last_path, trace.bytes_read >= len ? "comptés" : "MANQUANTS");
+
+    // Compteurs propres à l'index
+    tar_index_stats_reset(index);
+    len = sizeof(buffer);
+    tar_index_read_file(index, "file1.txt", 0, buffer, &len);
+    len = sizeof(buffer);
+    tar_index_read_file(index, "file1.txt", 1024, buffer, &len);
+    tar_index_stats(index, &stats);
+    printf("Index : %llu appel(s), %llu lecture(s), %llu octets\n",
+           (unsigned long long)stats.calls[TAR_FN_INDEX_READ_FILE], (unsigned long long)stats.io.read_calls,
+           (unsigned long long)stats.io.bytes_read);
+}
+
+/* Relit chaque fichier de l'archive à travers le cache de l'index et compare avec une lecture directe */
+int compare_cache(int fd, tar_index_t *index) {
+    tar_iter_t *it = tar_iter_open(fd, 0);
+    tar_entry_t entry;
+    static uint8_t expected[16384], actual[16384];
+    int errors = 0;
+
+    if (it == NULL) {
+        return -1;
+    }
+    while (tar_iter_next(it, &entry) == 1) {
+        if (!is_file(fd, (char *)entry.path)) {
+            continue;
+        }
+        for (size_t offset = 0; offset < 4000; offset += 1000) {
+            size_t len_expected = sizeof(expected), len_actual = sizeof(actual);
+            ssize_t ret_expected = read_file(fd, (char *)entry.path, offset, expected, &len_expected);
+            ssize_t ret_actual = tar_index_read_file(index, entry.path, offset, actual, &len_actual);
+            if (ret_expected != ret_actual || len_expected != len_actual
+                || memcmp(expected, actual, len_actual) != 0) {
+                printf("  différence sur '%s' à l'offset %zu\n", entry.path, offset);
+                errors++;
+            }
+        }
+    }
+    tar_iter_close(it);
+    return errors;
+}
+
+void test_cache(int fd, tar_index_t *index) {
+    tar_cache_stats_t stats;
+
+    // Budget confortable : après une première passe, tout est servi depuis le cache
+    if (tar_index_cache_enable(index, 0, 0) == -1) {
+        printf("Erreur lors de l'activation du cache\n");
+        return;
+    }
+    int errors = compare_cache(fd, index);
+    tar_index_cache_stats(index, &stats);
+    uint64_t misses = stats.misses;
+    errors += compare_cache(fd, index);
+    tar_index_cache_stats(index, &stats);
+    printf("Cache large : %d différence(s), %s lecture dans l'archive à la deuxième passe\n", errors,
+           stats.misses == misses && stats.hits > 0 ? "aucune" : "ENCORE UNE");
+
+    // Budget de deux extents de 4 Kio : les lectures doivent évincer des extents et rester correctes
+    if (tar_index_cache_enable(index, 8192, 4096) == -1) {
+        printf("Erreur lors de l'activation du cache\n");
+        return;
+    }
+    errors = compare_cache(fd, index);
+    tar_index_cache_stats(index, &stats);
+    printf("Cache réduit : %d différence(s), évictions : %s, mémoire : %llu octets\n", errors,
+           stats.evictions > 0 ? "oui" : "NON", (unsigned long long)stats.cached_bytes);
+    tar_index_cache_disable(index);
+}
+
+/* Compare chaque fichier lu dans l'archive compressée avec sa lecture dans l'archive d'origine */
+int compare_gz(int fd, tar_gz_t *gz) {
+    tar_iter_t *it = tar_iter_open(fd, 0);
+    tar_entry_t entry;
+    static uint8_t expected[16384], actual[16384];
+    int files = 0, errors = 0;
+
+    if (it == NULL) {
+        return -1;
+    }
+    while (tar_iter_next(it, &entry) == 1) {
+        if (!is_file(fd, (char *)entry.path)) {
+            continue;
+        }
+        // Lectures en reculant dans le fichier pour forcer les reprises depuis un point de contrôle
+        for (size_t offset = 3000; offset != (size_t)-1000; offset -= 1000) {
+            size_t len_expected = sizeof(expected), len_actual = sizeof(actual);
+            ssize_t ret_expected = read_file(fd, (char *)entry.path, offset, expected, &len_expected);
+            ssize_t ret_actual = tar_gz_read_file(gz, entry.path, offset, actual, &len_actual);
+            if (ret_expected != ret_actual || len_expected != len_actual
+                || memcmp(expected, actual, len_actual) != 0) {
+                printf("  différence sur '%s' à l'offset %zu\n", entry.path, offset);
+                errors++;
+            }
+        }
+        files++;
+    }
+    tar_iter_close(it);
+    printf("  %d fichiers comparés, %d différences\n", files, errors);
+    return errors;
+}
+
+void test_gz(int fd, const char *gz_path) {
+    static uint8_t archive[1 << 20];
+    ssize_t size = pread(fd, archive, sizeof(archive), 0);
+    if (size <= 0) {
+        perror("pread");
+        return;
+    }
+
+    // Deux membres gzip concaténés, avec des blocs deflate courts pour avoir plusieurs points de contrôle
+    for (int member = 0; member < 2; member++) {
+        gzFile out = gzopen(gz_path, member == 0 ? "wb" : "ab");
+        ssize_t from = member == 0 ? 0 : size / 2, to = member == 0 ? size / 2 : size;
+        for (ssize_t off = from; off < to; off += 2048) {
+            gzwrite(out, archive + off, to - off < 2048 ? to - off : 2048);
+            gzflush(out, Z_FULL_FLUSH);
+        }
+        gzclose(out);
+    }
+
+    int gz_fd = open(gz_path, O_RDONLY);
+    tar_gz_t *gz = tar_gz_open(gz_fd, 4096);
+    if (gz == NULL) {
+        perror("tar_gz_open");
+        close(gz_fd);
+        return;
+    }
+    printf("tar_gz_check_archive a retourné %d (check_archive : %d)\n", tar_gz_check_archive(gz), check_archive(fd));
+    printf("tar_gz_exists('dir/c/d') : %d, tar_gz_exists('nonexistent') : %d\n", tar_gz_exists(gz, "dir/c/d"),
+           tar_gz_exists(gz, "nonexistent"));
+
+    char storage[10][100];
+    char *entries[10];
+    for (int i = 0; i < 10; i++) {
+        entries[i] = storage[i];
+    }
+    size_t no_entries = 10;
+    int ret = tar_gz_list(gz, "link_to_dir", entries, &no_entries);
+    printf("tar_gz_list('link_to_dir') a retourné %d avec %zu entrées :\n", ret, no_entries);
+    for (size_t i = 0; i < no_entries; i++) {
+        printf("  %s\n", entries[i]);
+    }
+    compare_gz(fd, gz);
+
+    char checkpoint_path[256];
+    snprintf(checkpoint_path, sizeof(checkpoint_path), "%s.gzidx", gz_path);
+    if (tar_gz_save(gz, checkpoint_path) == -1) {
+        perror("tar_gz_save");
+    }
+    tar_gz_close(gz);
+
+    gz = tar_gz_load(checkpoint_path, gz_fd);
+    if (gz == NULL) {
+        perror("tar_gz_load");
+    } else {
+        printf("Points de contrôle rechargés depuis '%s' :\n", checkpoint_path);
+        compare_gz(fd, gz);
+        tar_gz_close(gz);
+    }
+
+    // Un fichier de points corrompu doit être refusé. L'en-tête fait 88 octets, n_points est à 56 et points_off à 64 ;
+    // les points de 24 octets suivent (out, in, bits à 16, window à 20).
+    const struct {
+        const char *label;
+        off_t offset;
+        uint64_t value;
+        size_t size;
+    } corruptions[] = {
+        {"nombre de points dont la taille déborde", 56, 1ULL << 49, 8},
+        {"points mal alignés", 64, 89, 8},
+        {"fenêtre hors du fichier", 88 + 24 + 20, 0x7fffffff, 4},
+        {"plus de 7 bits", 88 + 16, 9, 4},
+        {"points non croissants", 88 + 24, 0, 8},
+    };
+    struct stat checkpoint_st;
+    stat(checkpoint_path, &checkpoint_st);
+    uint8_t *checkpoint = malloc(checkpoint_st.st_size);
+    int checkpoint_fd = open(checkpoint_path, O_RDONLY);
+    pread(checkpoint_fd, checkpoint, checkpoint_st.st_size, 0);
+    close(checkpoint_fd);
+    for (size_t i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); i++) {
+        checkpoint_fd = open(checkpoint_path, O_WRONLY | O_TRUNC);
+        pwrite(checkpoint_fd, checkpoint, checkpoint_st.st_size, 0);
+        pwrite(checkpoint_fd, &corruptions[i].value, corruptions[i].size, corruptions[i].offset);
+        close(checkpoint_fd);
+        gz = tar_gz_load(checkpoint_path, gz_fd);
+        printf("Points de contrôle corrompus (%s) : %s\n", corruptions[i].label,
+               gz == NULL && errno == EINVAL ? "refusés" : "ACCEPTÉS");
+        if (gz != NULL) {
+            tar_gz_close(gz);
+        }
+    }
+    free(checkpoint);
+    close(gz_fd);
+    unlink(checkpoint_path);
+    unlink(gz_path);
+}
+
+struct stream_ctx {
+    int entries;
+    int files;
+    uint64_t bytes;
+    uint8_t *file1;       // données de file1.txt reçues par on_data
+    size_t file1_len;
+};
+
+tar_stream_action_t stream_on_entry(const tar_entry_t *entry, void *ctx) {
+    struct stream_ctx *c = ctx;
+    c->entries++;
+    if (entry->type == REGTYPE || entry->type == AREGTYPE) {
+        c->files++;
+        return strcmp(entry->path, "file1.txt") == 0 ? TAR_STREAM_DATA : TAR_STREAM_SKIP;
+    }
+    return TAR_STREAM_SKIP;
+}
+
+int stream_on_data(const tar_entry_t *entry, const uint8_t *data, size_t len, uint64_t offset, void *ctx) {
+    struct stream_ctx *c = ctx;
+    if (offset != c->file1_len || offset + len > entry->size) {
+        return 1;
+    }
+    memcpy(c->file1 + offset, data, len);
+    c->file1_len += len;
+    c->bytes += len;
+    return 0;
+}
+
+struct pipe_writer {
+    int fd;
+    const uint8_t *data;
+    size_t len;
+};
+
+void *pipe_writer(void *arg) {
+    struct pipe_writer *w = arg;
+    size_t done = 0;
+    // Écritures irrégulières pour que les en-têtes arrivent en plusieurs morceaux
+    while (done < w->len) {
+        size_t n = w->len - done < 777 ? w->len - done : 777;
+        ssize_t written = write(w->fd, w->data + done, n);
+        if (written <= 0) {
+            break;
+        }
+        done += written;
+    }
+    close(w->fd);
+    return NULL;
+}
+
+void test_stream(int fd, const char *tar_path) {
+    static uint8_t archive[1 << 20];
+    static uint8_t expected[1 << 16], received[1 << 16];
+    ssize_t size = pread(fd, archive, sizeof(archive), 0);
+    size_t expected_len = sizeof(expected);
+    read_file(fd, "file1.txt", 0, expected, &expected_len);
+    tar_stream_callbacks_t callbacks = {stream_on_entry, stream_on_data};
+
+    // Depuis un tube, comme une archive téléchargée
+    int fds[2];
+    if (size <= 0 || pipe(fds) == -1) {
+        perror("pipe");
+        return;
+    }
+    struct pipe_writer writer = {fds[1], archive, size};
+    pthread_t thread;
+    pthread_create(&thread, NULL, pipe_writer, &writer);
+    struct stream_ctx ctx = {0, 0, 0, received, 0};
+    ssize_t ret = tar_stream(fds[0], &callbacks, &ctx);
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    printf("tar_stream(tube) a retourné %zd (check_archive : %d), %d entrées, %d fichiers, %lu octets reçus, "
+           "file1.txt %s\n", ret, check_archive(fd), ctx.entries, ctx.files, (unsigned long)ctx.bytes,
+           ctx.file1_len == expected_len && memcmp(received, expected, expected_len) == 0 ? "identique" : "DIFFÉRENT");
+
+    // Depuis un fichier ordinaire, où splice() n'est pas possible
+    int file_fd = open(tar_path, O_RDONLY);
+    struct stream_ctx file_ctx = {0, 0, 0, received, 0};
+    ret = tar_stream(file_fd, &callbacks, &file_ctx);
+    close(file_fd);
+    printf("tar_stream(fichier) a retourné %zd, %d entrées, file1.txt %s\n", ret, file_ctx.entries,
+           file_ctx.file1_len == expected_len && memcmp(received, expected, expected_len) == 0 ? "identique" : "DIFFÉRENT");
+
+    // Archive tronquée au milieu des données d'une entrée
+    if (pipe(fds) == -1) {
+        return;
+    }
+    writer = (struct pipe_writer){fds[1], archive, 3 * 512 + 100};
+    pthread_create(&thread, NULL, pipe_writer, &writer);
+    ret = tar_stream(fds[0], NULL, NULL);
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    printf("tar_stream(archive tronquée) a retourné %zd\n", ret);
+}
+
+#define SPARSE_DIR "/tmp/lib_tar_sparse"
+#define SPARSE_SIZE (3 * 1024 * 1024)
+
+/* Contenu attendu des fichiers creux : des segments de données séparés par des trous */
+void sparse_content(const char *name, uint8_t *content) {
+    memset(content, 0, SPARSE_SIZE);
+    if (strcmp(name, "holes") == 0) {
+        memset(content, 'A', 4096);
+        memset(content + 1024 * 1024 + 100, 'B', 5000);
+        memset(content + SPARSE_SIZE - 10, 'C', 10);
+    } else {
+        // Assez de segments pour que la carte GNU déborde dans des blocs d'extension
+        for (int i = 0; i < 30; i++) {
+            memset(content + i * 65536 + 4096, 'a' + i % 26, 1000 + i);
+        }
+    }
+}
+
+int make_sparse_file(const char *name) {
+    static uint8_t content[SPARSE_SIZE];
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", SPARSE_DIR, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    sparse_content(name, content);
+    // On n'écrit que les blocs non nuls pour que le fichier soit réellement creux
+    for (size_t off = 0; off < SPARSE_SIZE; off += 4096) {
+        size_t i = 0;
+        while (i < 4096 && content[off + i] == 0) {
+            i++;
+        }
+        if (i < 4096 && pwrite(fd, content + off, 4096, off) != 4096) {
+            close(fd);
+            return -1;
+        }
+    }
+    int ret = ftruncate(fd, SPARSE_SIZE);
+    close(fd);
+    return ret;
+}
+
+struct sparse_stream_ctx {
+    const char *name;
+    uint8_t *content;
+    int chunks;
+};
+
+tar_stream_action_t sparse_on_entry(const tar_entry_t *entry, void *ctx) {
+    struct sparse_stream_ctx *c = ctx;
+    return strcmp(entry->path, c->name) == 0 ? TAR_STREAM_DATA : TAR_STREAM_SKIP;
+}
+
+int sparse_on_data(const tar_entry_t *entry, const uint8_t *data, size_t len, uint64_t offset, void *ctx) {
+    struct sparse_stream_ctx *c = ctx;
+    if (offset + len > entry->size) {
+        return 1;
+    }
+    memcpy(c->content + offset, data, len);
+    c->chunks++;
+    return 0;
+}
+
+void test_sparse_archive(const char *tar_path, const char *name) {
+    static uint8_t expected[SPARSE_SIZE], actual[SPARSE_SIZE];
+    int fd = open(tar_path, O_RDONLY);
+    char path[64];
+    snprintf(path, sizeof(path), "%s", name);
+    sparse_content(name, expected);
+
+    printf("'%s' : check_archive %d, is_file %d", name, check_archive(fd), is_file(fd, path));
+    size_t len = sizeof(actual);
+    ssize_t ret = read_file(fd, path, 0, actual, &len);
+    printf(", read_file %zd (%zu octets, %s)", ret, len,
+           len == SPARSE_SIZE && memcmp(actual, expected, len) == 0 ? "identique" : "DIFFÉRENT");
+    len = 4000;
+    ret = read_file(fd, path, 1024 * 1024, actual, &len);
+    printf(", à 1 Mio : %s\n", len == 4000 && memcmp(actual, expected + 1024 * 1024, len) == 0 ? "identique" : "DIFFÉRENT");
+
+    tar_index_t *index = tar_index_open(fd);
+    len = sizeof(actual);
+    tar_index_read_file(index, path, 0, actual, &len);
+    printf("  tar_index_read_file : %s", len == SPARSE_SIZE && memcmp(actual, expected, len) == 0 ? "identique" : "DIFFÉRENT");
+    tar_index_close(index);
+
+    tar_mmap_t *handle = tar_open_mmap(fd);
+    len = sizeof(actual);
+    tar_mmap_read_file(handle, path, 0, actual, &len);
+    const uint8_t *view;
+    size_t view_len;
+    printf(", tar_mmap_read_file : %s, tar_view %d\n",
+           len == SPARSE_SIZE && memcmp(actual, expected, len) == 0 ? "identique" : "DIFFÉRENT",
+           tar_view(handle, path, &view, &view_len));
+    tar_close_mmap(handle);
+
+    // Segments de données et trous, tels qu'un extracteur les recréerait
+    tar_file_t *file = tar_fopen(fd, path);
+    if (file == NULL) {
+        printf("  tar_fopen a échoué\n");
+        close(fd);
+        return;
+    }
+    printf("  segments :");
+    off_t data = 0;
+    int segments = 0;
+    while ((data = tar_fseek(file, data, SEEK_DATA)) != -1) {
+        off_t hole = tar_fseek(file, data, SEEK_HOLE);
+        if (segments++ < 3) {
+            printf(" [%ld, %ld)", (long)data, (long)hole);
+        }
+        data = hole;
+    }
+    printf(" ... %d segments\n", segments);
+    tar_fclose(file);
+    close(fd);
+
+    // En flux, seuls les segments sont transmis, les trous restent à zéro
+    memset(actual, 0, sizeof(actual));
+    struct sparse_stream_ctx ctx = {name, actual, 0};
+    tar_stream_callbacks_t callbacks = {sparse_on_entry, sparse_on_data};
+    fd = open(tar_path, O_RDONLY);
+    ret = tar_stream(fd, &callbacks, &ctx);
+    close(fd);
+    printf("  tar_stream a retourné %zd, contenu %s\n", ret,
+           ret < 0 ? "non lu" : memcmp(actual, expected, SPARSE_SIZE) == 0 ? "identique" : "DIFFÉRENT");
+}
+
+void test_sparse(void) {
+    mkdir(SPARSE_DIR, 0755);
+    if (make_sparse_file("holes") == -1 || make_sparse_file("many") == -1) {
+        perror("make_sparse_file");
+        return;
+    }
+    // Les archives sont produites par GNU tar, aux deux formats de fichiers creux
+    if (system("tar -C " SPARSE_DIR " --format=gnu --sparse -cf " SPARSE_DIR "/gnu.tar holes many") != 0
+        || system("tar -C " SPARSE_DIR " --format=posix --sparse --sparse-version=1.0 -cf " SPARSE_DIR
+                  "/pax.tar holes many") != 0) {
+        printf("GNU tar n'a pas pu créer les archives de test\n");
+        return;
+    }
+    printf("Format GNU (magic refusé par check_archive, -1 attendu, accepté en flux) :\n");
+    test_sparse_archive(SPARSE_DIR "/gnu.tar", "holes");
+    test_sparse_archive(SPARSE_DIR "/gnu.tar", "many");
+    printf("Format pax 1.0 :\n");
+    test_sparse_archive(SPARSE_DIR "/pax.tar", "holes");
+    test_sparse_archive(SPARSE_DIR "/pax.tar", "many");
+
+    // L'extraction doit recréer les trous, aux deux formats
+    static uint8_t expected[SPARSE_SIZE], actual[SPARSE_SIZE];
+    const char *formats[] = {"pax", "gnu"};
+    sparse_content("holes", expected);
+    for (int i = 0; i < 2; i++) {
+        char tar_path[64];
+        snprintf(tar_path, sizeof(tar_path), SPARSE_DIR "/%s.tar", formats[i]);
+        int fd = open(tar_path, O_RDONLY);
+        system("rm -rf " SPARSE_DIR "/out");
+        mkdir(SPARSE_DIR "/out", 0755);
+        ssize_t ret = tar_extract(fd, "holes", SPARSE_DIR "/out", NULL);
+        close(fd);
+        int out = open(SPARSE_DIR "/out/holes", O_RDONLY);
+        struct stat st;
+        fstat(out, &st);
+        printf("Extraction (%s) : tar_extract a retourné %zd, contenu %s, %s\n", formats[i], ret,
+               read(out, actual, sizeof(actual)) == SPARSE_SIZE && memcmp(actual, expected, SPARSE_SIZE) == 0
+               ? "identique" : "DIFFÉRENT",
+               st.st_blocks * 512 < SPARSE_SIZE ? "creux" : "PLEIN");
+        close(out);
+    }
+    system("rm -rf " SPARSE_DIR);
+}
+
+#define EXTRACT_DIR "/tmp/lib_tar_extract"
+
+/* Compare les fichiers et liens extraits avec l'archive, retourne le nombre de différences */
+int compare_extracted(int fd, const char *dest, const char *prefix, size_t strip) {
+    tar_iter_t *it = tar_iter_open(fd, 0);
+    tar_entry_t entry;
+    static uint8_t expected[16384], actual[16384];
+    int errors = 0;
+
+    if (it == NULL) {
+        return -1;
+    }
+    while (tar_iter_next(it, &entry) == 1) {
+        if (strncmp(entry.path, prefix, strlen(prefix)) != 0 || entry.path_len == strip) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dest, entry.path + strip);
+        struct stat st;
+        if (lstat(path, &st) == -1) {
+            printf("  '%s' absent\n", path);
+            errors++;
+            continue;
+        }
+        if (entry.type == SYMTYPE) {
+            char target[256] = {0};
+            readlink(path, target, sizeof(target) - 1);
+            if (!S_ISLNK(st.st_mode) || strncmp(target, entry.header->linkname, sizeof(target)) != 0) {
+                printf("  lien '%s' différent\n", path);
+                errors++;
+            }
+        } else if (entry.type == REGTYPE) {
+            size_t len = sizeof(expected);
+            read_file(fd, (char *)entry.path, 0, expected, &len);
+            int out = open(path, O_RDONLY);
+            ssize_t n = read(out, actual, sizeof(actual));
+            close(out);
+            if (n != (ssize_t)len || memcmp(expected, actual, len) != 0
+                || (st.st_mode & 07777) != entry.mode) {
+                printf("  fichier '%s' différent\n", path);
+                errors++;
+            }
+        }
+    }
+    tar_iter_close(it);
+    return errors;
+}
+
+void test_extract(int fd) {
+    system("rm -rf " EXTRACT_DIR);
+    mkdir(EXTRACT_DIR, 0755);
+
+    tar_extract_options_t options = {.nthreads = 4};
+    ssize_t ret = tar_extract(fd, NULL, EXTRACT_DIR, &options);
+    printf("Archive entière : tar_extract a retourné %zd, %d différence(s)\n", ret,
+           compare_extracted(fd, EXTRACT_DIR, "", 0));
+
+    // Sous-arbre, sans son préfixe : rien d'autre ne doit être créé
+    mkdir(EXTRACT_DIR "/sub", 0755);
+    options.flags = TAR_EXTRACT_STRIP_PREFIX;
+    ret = tar_extract(fd, "dir/", EXTRACT_DIR "/sub", &options);
+    struct stat st;
+    printf("Sous-arbre 'dir/' : tar_extract a retourné %zd, %d différence(s), file1.txt %s\n", ret,
+           compare_extracted(fd, EXTRACT_DIR "/sub", "dir/", strlen("dir/")),
+           stat(EXTRACT_DIR "/sub/file1.txt", &st) == -1 ? "absent" : "PRÉSENT");
+
+    // Liens physiques, produits par GNU tar
+    if (system("mkdir -p " EXTRACT_DIR "/src && echo contenu > " EXTRACT_DIR "/src/f && ln " EXTRACT_DIR
+               "/src/f " EXTRACT_DIR "/src/hl && tar -C " EXTRACT_DIR "/src --format=ustar -cf " EXTRACT_DIR "/hl.tar f hl") != 0) {
+        printf("GNU tar n'a pas pu créer l'archive de test\n");
+        return;
+    }
+    int hl_fd = open(EXTRACT_DIR "/hl.tar", O_RDONLY);
+    mkdir(EXTRACT_DIR "/hl", 0755);
+    ret = tar_extract(hl_fd, NULL, EXTRACT_DIR "/hl", NULL);
+    printf("Liens physiques : tar_extract a retourné %zd, liens vers 'f' : %ld\n", ret,
+           stat(EXTRACT_DIR "/hl/f", &st) == 0 ? (long)st.st_nlink : -1L);
+    close(hl_fd);
+
+    printf("Destination inexistante : tar_extract a retourné %zd\n",
+           tar_extract(fd, NULL, EXTRACT_DIR "/nonexistent", NULL));
+
+    // Des liens laissés par une extraction précédente ne doivent pas faire écrire hors de la destination
+    mkdir(EXTRACT_DIR "/outside", 0755);
+    mkdir(EXTRACT_DIR "/dest", 0755);
+    symlink("../outside", EXTRACT_DIR "/dest/a");
+    symlink("../outside", EXTRACT_DIR "/dest/d");
+    int out = open(EXTRACT_DIR "/links.tar", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    tar_add_dir(w, "d", 0700);
+    tar_writer_close(w);
+    close(out);
+    int links_fd = open(EXTRACT_DIR "/links.tar", O_RDONLY);
+    ret = tar_extract(links_fd, NULL, EXTRACT_DIR "/dest", NULL);
+    close(links_fd);
+    stat(EXTRACT_DIR "/outside", &st);
+    struct stat d_st;
+    lstat(EXTRACT_DIR "/dest/d", &d_st);
+    printf("Répertoire à la place d'un lien : tar_extract a retourné %zd, lien %s, mode extérieur %s\n", ret,
+           S_ISDIR(d_st.st_mode) ? "remplacé" : "GARDÉ", (st.st_mode & 0777) == 0755 ? "intact" : "MODIFIÉ");
+    out = open(EXTRACT_DIR "/links.tar", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w = tar_writer_open(out);
+    tar_add_buffer(w, "a/passwd", "x", 1, 0644);
+    tar_writer_close(w);
+    close(out);
+    links_fd = open(EXTRACT_DIR "/links.tar", O_RDONLY);
+    ret = tar_extract(links_fd, NULL, EXTRACT_DIR "/dest", NULL);
+    close(links_fd);
+    printf("Fichier sous un lien : tar_extract a retourné %zd, fichier hors destination %s\n", ret,
+           stat(EXTRACT_DIR "/outside/passwd", &st) == -1 ? "absent" : "ÉCRIT");
+    system("rm -rf " EXTRACT_DIR);
+}
+
+#define WRITER_DIR "/tmp/lib_tar_writer"
+
+/* Compare une entrée de l'archive écrite avec le contenu attendu */
+int check_written(int fd, const char *path, const uint8_t *expected, size_t expected_len) {
+    static uint8_t actual[256 * 1024];
+    size_t len = sizeof(actual);
+    ssize_t ret = read_file(fd, (char *)path, 0, actual, &len);
+    if (ret != 0 || len != expected_len || memcmp(actual, expected, len) != 0) {
+        printf("  '%s' : read_file a retourné %zd, %zu octets, contenu %s\n", path, ret, len,
+               len == expected_len && memcmp(actual, expected, len) == 0 ? "identique" : "DIFFÉRENT");
+        return 1;
+    }
+    return 0;
+}
+
+void test_writer(void) {
+    static uint8_t big[200 * 1024];
+    char long_path[257], too_long_path[300], link_name[101], link_path[110], too_long_target[102];
+    int errors = 0;
+
+    for (size_t i = 0; i < sizeof(big); i++) {
+        big[i] = i * 7 + i / 1000;
+    }
+    system("rm -rf " WRITER_DIR);
+    if (system("mkdir -p " WRITER_DIR "/src/sub && echo petit > " WRITER_DIR "/src/small && ln -s small "
+               WRITER_DIR "/src/link") != 0) {
+        printf("Impossible de préparer les fichiers sources\n");
+        return;
+    }
+    int src = open(WRITER_DIR "/src/big", O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    write(src, big, sizeof(big));
+    close(src);
+
+    int out = open(WRITER_DIR "/out.tar", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    if (w == NULL) {
+        printf("Erreur lors de l'ouverture de l'écrivain\n");
+        close(out);
+        return;
+    }
+    // Chemin découpé entre prefix et name, puis chemin trop long pour ustar, donné par un en-tête pax, et chemins ou
+    // cibles trop longs pour être relus, refusés
+    memset(long_path, 'a', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    memcpy(long_path + 120, "/", 1);
+    char split_path[200];
+    snprintf(split_path, sizeof(split_path), "%.120s/split.txt", long_path);
+    memset(too_long_path, 'a', sizeof(too_long_path) - 1);
+    too_long_path[sizeof(too_long_path) - 1] = '\0';
+    memset(link_name, 'c', sizeof(link_name) - 1);
+    link_name[sizeof(link_name) - 1] = '\0';
+    snprintf(link_path, sizeof(link_path), "mem/%s", link_name);
+    snprintf(too_long_target, sizeof(too_long_target), "%s.", link_name);
+
+    const char *src_paths[] = {WRITER_DIR "/src/sub", WRITER_DIR "/src/small", WRITER_DIR "/src/big",
+                               WRITER_DIR "/src/link"};
+    const char *archive_paths[] = {"files", "files/small", "files/big", "files/link"};
+    int ret = tar_add_dir(w, "mem", 0755);
+    ret |= tar_add_buffer(w, "mem/hello", "bonjour\n", 8, 0644);
+    ret |= tar_add_buffer(w, "mem/big", big, sizeof(big), 0600);
+    ret |= tar_add_buffer(w, "mem/empty", "", 0, 0644);
+    ret |= tar_add_symlink(w, "mem/link", "hello");
+    ret |= tar_add_buffer(w, split_path, "découpé", strlen("découpé"), 0644);
+    ret |= tar_add_buffer(w, long_path, "long", 4, 0644);
+    ret |= tar_add_buffer(w, link_path, "cible", 5, 0644);
+    ret |= tar_add_symlink(w, "mem/long_link", link_name);
+    int too_long = tar_add_buffer(w, too_long_path, "x", 1, 0644) == -1 && errno == ENAMETOOLONG;
+    too_long += tar_add_symlink(w, "mem/too_long_link", too_long_target) == -1 && errno == ENAMETOOLONG;
+    ret |= tar_add_files(w, src_paths, archive_paths, 4, 4);
+    ret |= tar_add_file(w, WRITER_DIR "/src/small", "again");
+    int missing = tar_add_file(w, WRITER_DIR "/nonexistent", "nonexistent");
+    ret |= tar_writer_close(w);
+    close(out);
+    printf("Écriture : %s, fichier absent refusé : %s\n", ret == 0 ? "réussie" : "ÉCHEC", missing == -1 ? "oui" : "NON");
+    printf("Chemin de 299 octets et cible de 101 octets refusés : %s\n", too_long == 2 ? "oui" : "NON");
+
+    int fd = open(WRITER_DIR "/out.tar", O_RDONLY);
+    printf("check_archive de l'archive écrite a retourné %d\n", check_archive(fd));
+    errors += check_written(fd, "mem/hello", (const uint8_t *)"bonjour\n", 8);
+    errors += check_written(fd, "mem/big", big, sizeof(big));
+    errors += !is_file(fd, "mem/empty");
+    errors += check_written(fd, "mem/link", (const uint8_t *)"bonjour\n", 8);
+    errors += check_written(fd, split_path, (const uint8_t *)"découpé", strlen("découpé"));
+    errors += check_written(fd, long_path, (const uint8_t *)"long", 4);
+    errors += check_written(fd, "mem/long_link", (const uint8_t *)"cible", 5);
+    errors += exists(fd, too_long_path) + exists(fd, "mem/too_long_link");
+    errors += check_written(fd, "files/small", (const uint8_t *)"petit\n", 6);
+    errors += check_written(fd, "files/big", big, sizeof(big));
+    errors += check_written(fd, "files/link", (const uint8_t *)"petit\n", 6);
+    errors += check_written(fd, "again", (const uint8_t *)"petit\n", 6);
+    printf("Relecture : %d différence(s), is_dir('files/') %d, is_symlink('files/link') %d\n", errors,
+           is_dir(fd, "files/"), is_symlink(fd, "files/link"));
+    close(fd);
+
+    // GNU tar doit lire l'archive, y compris le chemin long
+    printf("Lecture par GNU tar : %s\n",
+           system("tar -tf " WRITER_DIR "/out.tar | grep -q 'aaa/aaaa*$'") == 0 ? "réussie" : "ÉCHEC");
+    system("rm -rf " WRITER_DIR);
+}
+
+#define OVERLAY_DIR "/tmp/lib_tar_overlay"
+
+/* Écrit une couche à partir d'une liste de (chemin, contenu), un contenu NULL pour un répertoire, "->cible" pour un lien */
+int write_layer(const char *tar_path, const char **items, size_t n) {
+    int out = open(tar_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    int ret = w == NULL ? -1 : 0;
+    for (size_t i = 0; i < n && w != NULL; i += 2) {
+        if (items[i + 1] == NULL) {
+            ret |= tar_add_dir(w, items[i], 0755);
+        } else if (strncmp(items[i + 1], "->", 2) == 0) {
+            ret |= tar_add_symlink(w, items[i], items[i + 1] + 2);
+        } else {
+            ret |= tar_add_buffer(w, items[i], items[i + 1], strlen(items[i + 1]), 0644);
+        }
+    }
+    ret |= tar_writer_close(w);
+    close(out);
+    return ret;
+}
+
+void test_overlay_read(const tar_overlay_t *ov, const char *path) {
+    uint8_t buffer[64];
+    size_t len = sizeof(buffer) - 1;
+    ssize_t ret = tar_overlay_read_file(ov, path, 0, buffer, &len);
+    buffer[len] = '\0';
+    printf("tar_overlay_read_file('%s') a retourné %zd, contenu '%s'\n", path, ret, (char *)buffer);
+}
+
+void test_overlay_list(const tar_overlay_t *ov, const char *path) {
+    char storage[16][100];
+    char *entries[16];
+    size_t n = 16;
+    for (size_t i = 0; i < n; i++) {
+        entries[i] = storage[i];
+    }
+    int ret = tar_overlay_list(ov, path, entries, &n);
+    printf("tar_overlay_list('%s') a retourné %d, %zu entrée(s) :", path, ret, n);
+    for (size_t i = 0; i < n; i++) {
+        printf(" %s", entries[i]);
+    }
+    printf("\n");
+}
+
+void test_overlay(int fd) {
+    const char *base[] = {"etc", NULL, "etc/passwd", "base", "etc/hosts", "hosts", "etc/old", "old", "opt", NULL,
+                          "opt/a", "a", "opt/b", "b", "lib", NULL, "lib/x", "x", "shared", "base"};
+    const char *mid[] = {"etc", NULL, "etc/passwd", "mid", "etc/.wh.old", "", "opt", NULL, "opt/.wh..wh..opq", "",
+                         "opt/c", "c", ".wh.lib", "", "link", "->etc/hosts"};
+    const char *top[] = {"etc", NULL, "etc/motd", "motd", "shared", "top", "etc_link", "->etc"};
+
+    system("rm -rf " OVERLAY_DIR);
+    mkdir(OVERLAY_DIR, 0755);
+    // Couches de la plus haute à la plus basse
+    int ret = write_layer(OVERLAY_DIR "/top.tar", top, sizeof(top) / sizeof(char *));
+    ret |= write_layer(OVERLAY_DIR "/mid.tar", mid, sizeof(mid) / sizeof(char *));
+    ret |= write_layer(OVERLAY_DIR "/base.tar", base, sizeof(base) / sizeof(char *));
+    int fds[] = {open(OVERLAY_DIR "/top.tar", O_RDONLY), open(OVERLAY_DIR "/mid.tar", O_RDONLY),
+                 open(OVERLAY_DIR "/base.tar", O_RDONLY)};
+    tar_overlay_t *ov = ret == 0 ? tar_overlay_open(fds, 3) : NULL;
+    if (ov == NULL) {
+        printf("Erreur lors de l'ouverture de la superposition\n");
+    } else {
+        test_overlay_read(ov, "shared");
+        test_overlay_read(ov, "etc/passwd");
+        test_overlay_read(ov, "etc/hosts");
+        test_overlay_read(ov, "etc/old");
+        test_overlay_read(ov, "link");
+        test_overlay_read(ov, "opt/a");
+        test_overlay_read(ov, "opt/c");
+        printf("exists('lib/x') %d, is_dir('lib') %d, exists('etc/.wh.old') %d, exists('nonexistent') %d\n",
+               tar_overlay_exists(ov, "lib/x"), tar_overlay_is_dir(ov, "lib"), tar_overlay_exists(ov, "etc/.wh.old"),
+               tar_overlay_exists(ov, "nonexistent"));
+        printf("is_dir('etc/') %d, is_file('etc/motd') %d, is_symlink('link') %d, is_file('link') %d\n",
+               tar_overlay_is_dir(ov, "etc/"), tar_overlay_is_file(ov, "etc/motd"), tar_overlay_is_symlink(ov, "link"),
+               tar_overlay_is_file(ov, "link"));
+        test_overlay_list(ov, "etc/");
+        test_overlay_list(ov, "opt");
+        test_overlay_list(ov, "");
+        test_overlay_list(ov, "lib/");
+        // Répertoire intermédiaire qui est un lien d'une couche vers une autre
+        test_overlay_read(ov, "etc_link/hosts");
+        test_overlay_list(ov, "etc_link/");
+        printf("is_file('etc_link/passwd') %d, exists('etc_link/old') %d\n", tar_overlay_is_file(ov, "etc_link/passwd"),
+               tar_overlay_exists(ov, "etc_link/old"));
+        tar_overlay_close(ov);
+    }
+    for (int i = 0; i < 3; i++) {
+        close(fds[i]);
+    }
+
+    // Une superposition d'une seule couche répond comme l'index de l'archive
+    ov = tar_overlay_open(&fd, 1);
+    tar_index_t *index = tar_index_open(fd);
+    if (ov != NULL && index != NULL) {
+        const char *paths[] = {"links/to_dir/a", "link_to_dir/dir2/testfile.txt", "links/up", "link_to_dir/c/"};
+        for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+            uint8_t buffer[64], expected[64];
+            size_t len = sizeof(buffer), expected_len = sizeof(expected);
+            ssize_t ret = tar_overlay_read_file(ov, paths[i], 0, buffer, &len);
+            ssize_t expected_ret = tar_index_read_file(index, paths[i], 0, expected, &expected_len);
+            printf("Une couche, '%s' : tar_overlay_read_file %zd (%zu octets), tar_index_read_file %zd (%zu octets), "
+                   "is_dir %d\n", paths[i], ret, len, expected_ret, expected_len, tar_overlay_is_dir(ov, paths[i]));
+        }
+    }
+    tar_index_close(index);
+    tar_overlay_close(ov);
+    system("rm -rf " OVERLAY_DIR);
+}
+
+#define PATHS_DIR "/tmp/lib_tar_paths"
+
+void test_path_table_find(const tar_path_table_t *table, const char *path) {
+    char found[256] = "";
+    tar_path_record_t record = {0};
+    ssize_t rank = tar_path_table_find(table, path);
+    if (rank >= 0) {
+        tar_path_table_get(table, rank, found, sizeof(found), &record);
+    }
+    printf("tar_path_table_find('%s') a retourné %zd : '%s', type '%c', %lu octets\n", path, rank, found,
+           record.type ? record.type : ' ', (unsigned long)record.size);
+}
+
+void test_path_table(int fd) {
+    tar_path_table_t *table = tar_path_table_open(fd);
+    if (table == NULL) {
+        printf("Erreur lors de la construction de la table des chemins\n");
+        return;
+    }
+    size_t first, end;
+    printf("%zu chemins, %zu sous 'dir/'\n", tar_path_table_count(table), tar_path_table_prefix(table, "dir/", &first, &end));
+    test_path_table_find(table, "file1.txt");
+    test_path_table_find(table, "dir");
+    test_path_table_find(table, "dir/c/d");
+    test_path_table_find(table, "nonexistent");
+    tar_path_table_close(table);
+
+    // Catalogue de paquets : 100 paquets de 200 fichiers, dont un fichier réécrit plus loin dans l'archive, dont la
+    // première occurrence doit être retenue
+    system("rm -rf " PATHS_DIR);
+    mkdir(PATHS_DIR, 0755);
+    int out = open(PATHS_DIR "/catalog.tar", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    char path[128];
+    int ret = w == NULL ? -1 : 0;
+    for (int pkg = 0; pkg < 100 && w != NULL; pkg++) {
+        snprintf(path, sizeof(path), "usr/share/doc/pkg%04d", pkg);
+        ret |= tar_add_dir(w, path, 0755);
+        for (int file = 0; file < 200; file++) {
+            snprintf(path, sizeof(path), "usr/share/doc/pkg%04d/file%03d.txt", pkg, file);
+            ret |= tar_add_buffer(w, path, "x", 1, 0644);
+        }
+    }
+    ret |= tar_add_buffer(w, "usr/share/doc/pkg0042/file007.txt", "plus long", 9, 0644);
+    ret |= tar_writer_close(w);
+    close(out);
+
+    int catalog = open(PATHS_DIR "/catalog.tar", O_RDONLY);
+    table = ret == 0 ? tar_path_table_open(catalog) : NULL;
+    if (table == NULL) {
+        printf("Erreur lors de la construction de la table du catalogue\n");
+    } else {
+        size_t n = tar_path_table_count(table);
+        size_t per_entry = tar_path_table_memory(table) / n;
+        printf("Catalogue : %zu chemins, %zu octets par entrée, budget de %d respecté : %s\n", n, per_entry,
+               TAR_PATH_TABLE_BUDGET, per_entry <= TAR_PATH_TABLE_BUDGET ? "oui" : "NON");
+        test_path_table_find(table, "usr/share/doc/pkg0042/file007.txt");
+        test_path_table_find(table, "usr/share/doc/pkg0099/");
+        test_path_table_find(table, "usr/share/doc/pkg0100/file000.txt");
+        printf("Préfixes : %zu sous 'usr/share/doc/pkg0042/', %zu sous 'usr/share/doc/pkg001', %zu sous 'var/'\n",
+               tar_path_table_prefix(table, "usr/share/doc/pkg0042/", &first, &end),
+               tar_path_table_prefix(table, "usr/share/doc/pkg001", &first, &end),
+               tar_path_table_prefix(table, "var/", &first, &end));
+
+        // Chaque rang se décode en un chemin retrouvé au même rang, dans l'ordre des octets
+        char prev[128] = "";
+        int errors = 0;
+        for (size_t rank = 0; rank < n; rank++) {
+            tar_path_table_get(table, rank, path, sizeof(path), NULL);
+            errors += tar_path_table_find(table, path) != (ssize_t)rank || strcmp(prev, path) >= 0;
+            strcpy(prev, path);
+        }
+        printf("Parcours des rangs : %d erreur(s)\n", errors);
+        tar_path_table_close(table);
+    }
+    close(catalog);
+    system("rm -rf " PATHS_DIR);
+}
+
+#define FIELDS_TAR "/tmp/lib_tar_fields.tar"
+
+/* Réécrit le champ size du premier en-tête de l'archive et sa somme de contrôle, puis relit l'entrée */
+void test_size_field(const char *label, const char *field) {
+    tar_header_t header;
+    int fd = open(FIELDS_TAR, O_RDWR);
+    pread(fd, &header, sizeof(header), 0);
+    memcpy(header.size, field, sizeof(header.size));
+    memset(header.chksum, ' ', sizeof(header.chksum));
+    snprintf(header.chksum, sizeof(header.chksum), "%06o", tar_header_chksum(&header));
+    header.chksum[7] = ' ';
+    pwrite(fd, &header, sizeof(header), 0);
+
+    tar_iter_t *it = tar_iter_open(fd, 0);
+    tar_entry_t entry = {0};
+    tar_iter_next(it, &entry);
+    uint8_t buffer[2048];
+    size_t len = sizeof(buffer);
+    ssize_t ret = read_file(fd, "nombres", 0, buffer, &len);
+    printf("Taille %s : %lu, mode %o, mtime %s, check_archive %d, read_file %zd (%zu octets)\n", label,
+           (unsigned long)entry.size, entry.mode, entry.mtime > 0 ? "décodé" : "NUL", check_archive(fd), ret, len);
+    tar_iter_close(it);
+    close(fd);
+}
+
+void test_field_numbers(void) {
+    static uint8_t content[1000];
+    int out = open(FIELDS_TAR, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    if (w == NULL || tar_add_buffer(w, "nombres", content, sizeof(content), 0640) != 0 || tar_writer_close(w) != 0) {
+        printf("Erreur lors de l'écriture de l'archive\n");
+        close(out);
+        return;
+    }
+    close(out);
+    printf("sizeof(tar_entry_t) : %zu octets\n", sizeof(tar_entry_t));
+    test_size_field("octale", "00000001750\0");
+    test_size_field("octale précédée d'espaces", "     1750 \0\0");
+    test_size_field("en base 256", "\x80\0\0\0\0\0\0\0\0\0\x03\xe8");
+    unlink(FIELDS_TAR);
+}
+
+struct find_result {
+    char paths[512];
+    size_t stop_after;    // zéro pour ne jamais arrêter la recherche
+    size_t count;
+};
+
+int find_callback(const char *path, const tar_path_record_t *record, void *ctx) {
+    struct find_result *result = ctx;
+    size_t used = strlen(result->paths);
+    snprintf(result->paths + used, sizeof(result->paths) - used, " %s(%c,%lu)", path, record->type,
+             (unsigned long)record->size);
+    return ++result->count == result->stop_after;
+}
+
+/* Compare la recherche en un parcours de l'archive et la recherche dans l'index, qui peuvent différer par l'ordre */
+void test_find(int fd, tar_index_t *index, const char *pattern, int flags, size_t stop_after) {
+    struct find_result scan = {.stop_after = stop_after};
+    struct find_result indexed = {.stop_after = stop_after};
+    ssize_t ret = tar_find(fd, pattern, flags, find_callback, &scan);
+    ssize_t index_ret = tar_index_find(index, pattern, flags, find_callback, &indexed);
+    printf("tar_find('%s', %d) a retourné %zd :%s\n", pattern, flags, ret, scan.paths);
+    printf("tar_index_find('%s', %d) a retourné %zd :%s\n", pattern, flags, index_ret, indexed.paths);
+}
+
+#define DUPLICATES_TAR "/tmp/lib_tar_duplicates.tar"
+
+/* Un chemin présent deux fois : tar_index_find() doit donner l'entrée que lisent read_file() et l'index */
+void test_find_duplicates(void) {
+    int out = open(DUPLICATES_TAR, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    int ret = w == NULL ? -1 : tar_add_buffer(w, "f", "court\n", 6, 0644);
+    ret |= tar_add_buffer(w, "f", "nettement long", 14, 0644);
+    ret |= tar_writer_close(w);
+    close(out);
+
+    int fd = open(DUPLICATES_TAR, O_RDONLY);
+    tar_index_t *index = ret == 0 ? tar_index_open(fd) : NULL;
+    if (index == NULL) {
+        printf("Erreur lors de la construction de l'index des doublons\n");
+    } else {
+        struct find_result result = {0};
+        uint8_t buffer[32];
+        size_t len = sizeof(buffer);
+        tar_index_read_file(index, "f", 0, buffer, &len);
+        ssize_t n = tar_index_find(index, "f", 0, find_callback, &result);
+        printf("Doublons : tar_index_find a retourné %zd :%s, tar_index_read_file lit %zu octets\n", n, result.paths,
+               len);
+        tar_index_close(index);
+    }
+    close(fd);
+    unlink(DUPLICATES_TAR);
+}
+
+#define CHAIN_TAR "/tmp/lib_tar_chain.tar"
+#define CHAIN_LEN 40
+
+/* Une chaîne de liens plus longue que la limite : un lien proche de la cible se résout, quel que soit l'ordre */
+void test_long_chain(void) {
+    int out = open(CHAIN_TAR, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    tar_writer_t *w = tar_writer_open(out);
+    int ret = w == NULL ? -1 : tar_add_buffer(w, "f", "fin\n", 4, 0644);
+    for (int i = 0; i < CHAIN_LEN; i++) {
+        char path[16], target[16];
+        snprintf(path, sizeof(path), "l%02d", i);
+        snprintf(target, sizeof(target), i + 1 < CHAIN_LEN ? "l%02d" : "f", i + 1);
+        ret |= tar_add_symlink(w, path, target);
+    }
+    ret |= tar_writer_close(w);
+    close(out);
+
+    int fd = open(CHAIN_TAR, O_RDONLY);
+    tar_index_t *index = ret == 0 ? tar_index_open(fd) : NULL;
+    if (index == NULL) {
+        printf("Erreur lors de la construction de l'index de la chaîne\n");
+    } else {
+        uint8_t buffer[8];
+        size_t head_len = sizeof(buffer), near_len = sizeof(buffer);
+        ssize_t head = tar_index_read_file(index, "l00", 0, buffer, &head_len);
+        ssize_t near = tar_index_read_file(index, "l20", 0, buffer, &near_len);
+        printf("Chaîne de %d liens : 'l00' %zd (trop long), puis 'l20' %zd, %zu octets\n", CHAIN_LEN, head, near,
+               near_len);
+        tar_index_close(index);
+    }
+    close(fd);
+    unlink(CHAIN_TAR);
+}
+
+void test_async(int fd, tar_index_t *index, int flags) {
+    const char *paths[] = {"file1.txt", "links/chain1", "dir/", "nonexistent", "link_to_file", "dir/c/d",
+                           "links/to_dir/a"};
+    size_t n_paths = sizeof(paths) / sizeof(paths[0]);
+    enum { N_READS = 500 };
+    static uint8_t buffers[N_READS][1024];
+    static uint8_t expected[1024];
+    tar_async_completion_t completions[32];
+    size_t offsets[N_READS];
+    int done = 0, errors = 0, busy = 0;
+
+    tar_async_t *a = tar_async_open(index, 64, flags);
+    if (a == NULL) {
+        perror("tar_async_open");
+        return;
+    }
+    // Les lectures dans les tampons enregistrés passent par IORING_OP_READ_FIXED
+    struct iovec registered = {buffers, sizeof(buffers) / 2};
+    if (tar_async_register_buffers(a, &registered, 1) == -1) {
+        perror("tar_async_register_buffers");
+    }
+
+    size_t submitted = 0;
+    while (done < N_READS) {
+        while (submitted < N_READS) {
+            offsets[submitted] = submitted % 3 == 0 ? 0 : submitted * 37 % 10000;
+            if (tar_async_read(a, paths[submitted % n_paths], offsets[submitted], buffers[submitted],
+                               sizeof(buffers[submitted]), (void *)submitted) == -1) {
+                busy++;
+                break;
+            }
+            submitted++;
+        }
+        ssize_t n = tar_async_wait(a, completions, 32, 1);
+        for (ssize_t i = 0; i < n; i++) {
+            // Chaque lecture doit donner le même résultat que read_file()
+            size_t r = (size_t)completions[i].user_data;
+            size_t len = sizeof(expected);
+            ssize_t ret = read_file(fd, (char *)paths[r % n_paths], offsets[r], expected, &len);
+            if (ret != completions[i].result || len != completions[i].len || memcmp(expected, buffers[r], len) != 0) {
+                errors++;
+            }
+            done++;
+        }
+    }
+    printf("tar_async (%s) : %d lectures, %d différences avec read_file, file pleine %s\n", tar_async_backend(a), done,
+           errors, busy > 0 ? "rencontrée" : "jamais atteinte");
+    tar_async_close(a);
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
         printf("Usage: %s tar_file\n", argv[0]);
@@ -126,6 +1533,8 @@ int main(int argc, char **argv) {
     int ret = check_archive(fd);
     printf("check_archive returned %d\n", ret);
 
+    test_chksum(fd);
+
     // Tester la fonction `exists`
     printf("Test de la fonction exists :\n");
     test_exists(fd, "file1.txt");    
@@ -166,6 +1575,120 @@ int main(int argc, char **argv) {
     test_read_file(fd, "nonexistent", 0, 512);     
     test_read_file(fd, "dir/", 0, 512);             
 
+    // Résolution des liens : cibles relatives, chaînes, boucles et répertoires intermédiaires
+    printf("\nTest de la résolution des liens :\n");
+    test_read_file(fd, "link_to_file", 0, 512);
+    test_read_file(fd, "links/up", 0, 512);
+    test_read_file(fd, "links/chain1", 100, 512);
+    test_read_file(fd, "links/loop_a", 0, 512);
+    test_read_file(fd, "links/to_dir/c/d", 0, 512);
+    test_read_file(fd, "link_to_dir/dir2/testfile.txt", 0, 512);
+    test_list(fd, "links/to_dir/c");
+
+    // Tester l'itérateur
+    printf("\nTest de l'itérateur :\n");
+    test_iter(fd, 0);
+    test_iter(fd, 4096);
+
+    // Tester la lecture séquentielle
+    printf("\nTest de tar_fopen :\n");
+    test_fread(fd, "file1.txt", 1000);
+    test_fread(fd, "links/chain1", 4096);
+    printf("tar_fopen('dir/') : %s\n", tar_fopen(fd, "dir/") == NULL ? "NULL" : "non NULL");
+
+    // Tester la recherche groupée
+    printf("\nTest de tar_stat_many :\n");
+    test_stat_many(fd);
+    test_read_files_v(fd);
+
+    // Tester la validation parallèle sur l'archive et sur des copies corrompues
+    printf("\nTest de check_archive_parallel :\n");
+    test_check_parallel(fd, -1, 0, 0, 0);
+    test_check_parallel(fd, 2, offsetof(tar_header_t, magic), 'x', -1);
+    test_check_parallel(fd, 4, offsetof(tar_header_t, version), '1', -2);
+    test_check_parallel(fd, 1, offsetof(tar_header_t, name), 'z', -3);   // somme de contrôle fausse
+
+    // Tester les variantes réentrantes depuis plusieurs threads
+    printf("\nTest des fonctions _r :\n");
+    test_concurrent(fd, 8);
+
+    // Tester l'index en mémoire
+    printf("\nTest de l'index :\n");
+    tar_index_t *index = tar_index_open(fd);
+    if (index == NULL) {
+        printf("Erreur lors de la construction de l'index\n");
+    } else {
+        test_index(index, "file1.txt");
+        test_index(index, "dir/");
+        test_index(index, "dir/c/d");
+        test_index(index, "link_to_file");
+        test_index(index, "nonexistent");
+        test_list_next(index, "dir/", 3);
+        test_list_next(index, "", 10);
+        test_list_next(index, "dir/a", 10);
+        test_list_next(index, "link_to_dir", 10);
+        test_list_next(index, "links/to_dir/c/", 10);
+        test_list_next(index, "links/loop_a", 10);
+        test_sidecar(fd, index, "/tmp/lib_tar_tests.tidx");
+        test_async(fd, index, 0);
+        test_async(fd, index, TAR_ASYNC_FORCE_THREADS);
+        test_cache(fd, index);
+        test_stats(fd, index);
+        test_find(fd, index, "dir/*", 0, 0);
+        test_find(fd, index, "*/*/*.txt", 0, 0);
+        test_find(fd, index, "dir/?", TAR_FIND_RECURSIVE, 0);
+        test_find(fd, index, "link", TAR_FIND_PREFIX, 0);
+        test_find(fd, index, "links/", TAR_FIND_PREFIX | TAR_FIND_RECURSIVE, 2);
+        test_find(fd, index, "links/loop_[ab]", 0, 0);
+        test_find(fd, index, "nonexistent*", TAR_FIND_RECURSIVE, 0);
+        test_find_duplicates();
+        test_long_chain();
+        tar_index_close(index);
+    }
+
+    printf("\nTest de l'archive compressée :\n");
+    test_gz(fd, "/tmp/lib_tar_tests.tar.gz");
+
+    printf("\nTest de la lecture en flux :\n");
+    test_stream(fd, argv[1]);
+
+    printf("\nTest de l'extraction :\n");
+    test_extract(fd);
+
+    printf("\nTest de l'écriture :\n");
+    test_writer();
+
+    printf("\nTest de la superposition d'archives :\n");
+    test_overlay(fd);
+
+    printf("\nTest de la table des chemins :\n");
+    test_path_table(fd);
+
+    printf("\nTest du décodage des champs numériques :\n");
+    test_field_numbers();
+
+    printf("\nTest des fichiers creux :\n");
+    test_sparse();
+
+    // Tester l'accès par mmap
+    printf("\nTest du mmap :\n");
+    tar_mmap_t *handle = tar_open_mmap(fd);
+    if (handle == NULL) {
+        printf("Erreur lors du mapping de l'archive\n");
+    } else {
+        test_mmap(handle, "file1.txt", 0, 512);
+        test_mmap(handle, "file1.txt", 9800, 512);
+        test_mmap(handle, "file1.txt", 10000, 512);
+        test_mmap(handle, "link_to_file", 0, 512);
+        test_mmap(handle, "links/chain1", 0, 512);
+        test_mmap(handle, "links/chain1", 0, 512);
+        test_mmap(handle, "links/loop_b", 0, 512);
+        test_mmap(handle, "links/to_dir/dir2/../a", 0, 512);
+        test_mmap(handle, "dir/", 0, 512);
+        test_mmap(handle, "nonexistent", 0, 512);
+        tar_close_mmap(handle);
+    }
+
     // Fermer le descripteur de fichier
     close(fd);
     return 0;